@@ -0,0 +1,136 @@
+/* GB/s of the sum, mean, minmax and count builtins against the awk
+ * programs they replace, on a generated file of one number per line
+ * (integers and decimals of mixed lengths). The builtins run both on a
+ * `<` file, which they map and split across threads, and at the end of a
+ * `cat FILE |` pipe; awk reads the file. Each row also shows the result.
+ * Build: gcc -O2 aggregate_benchmark.c -o aggregate_benchmark
+ * Usage: aggregate_benchmark [-m MiB] [-r ROUNDS] [-f FILE] <oshell>
+ *        -f reuses FILE instead of generating one in /tmp
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+static long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static uint64_t rng = 0x2545F4914F6CDD1DULL;
+
+static uint64_t next_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+int write_numbers(char *path, long long bytes) {
+    int fd = mkstemp(path);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, "w");
+    if (!fp) return 0;
+    for (long long n = 0; n < bytes; ) {
+        uint64_t r = next_rand();
+        switch (r % 4) {
+            case 0: n += fprintf(fp, "%llu\n", (unsigned long long)(r >> 40)); break;
+            case 1: n += fprintf(fp, "-%llu\n", (unsigned long long)(r >> 52)); break;
+            case 2: n += fprintf(fp, "%llu.%02llu\n", (unsigned long long)(r >> 48), (unsigned long long)(r >> 8) % 100); break;
+            default: n += fprintf(fp, "%llu.%06llu\n", (unsigned long long)(r >> 54), (unsigned long long)(r >> 8) % 1000000); break;
+        }
+    }
+    return fclose(fp) == 0;
+}
+
+/* Best wall time over rounds; the last run's first output line goes to out */
+long best_run(char **argv, int rounds, char *out, size_t outlen) {
+    long best = -1;
+    for (int r = 0; r < rounds; r++) {
+        posix_spawn_file_actions_t fa;
+        int pfd[2], status = 0;
+        pid_t pid;
+        if (pipe(pfd) < 0) return -1;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_adddup2(&fa, pfd[1], 1);
+        posix_spawn_file_actions_addclose(&fa, pfd[0]);
+        long t0 = now_ns();
+        int rc = posix_spawnp(&pid, argv[0], &fa, NULL, argv, environ);
+        close(pfd[1]);
+        ssize_t n = 0, k;
+        while (rc == 0 && (k = read(pfd[0], out + n, outlen - 1 - n)) > 0) n += k;
+        if (rc == 0) waitpid(pid, &status, 0);
+        long t = now_ns() - t0;
+        close(pfd[0]);
+        posix_spawn_file_actions_destroy(&fa);
+        out[n] = '\0';
+        out[strcspn(out, "\n")] = '\0';
+        if (rc != 0 || !WIFEXITED(status)) return -1;
+        if (best < 0 || t < best) best = t;
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    long long mib = 1024;
+    int rounds = 3, opt;
+    char *file = NULL;
+    while ((opt = getopt(argc, argv, "m:r:f:")) != -1) {
+        switch (opt) {
+            case 'm': mib = atoll(optarg); break;
+            case 'r': rounds = atoi(optarg); break;
+            case 'f': file = optarg; break;
+            default: goto usage;
+        }
+    }
+    if (optind >= argc || mib < 1 || rounds < 1) {
+usage:
+        fprintf(stderr, "Usage: %s [-m MiB] [-r ROUNDS] [-f FILE] <oshell>\n"
+                "Example: %s -m 4096 ./oshell\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    char *oshell = argv[optind], path[] = "/tmp/oshell_agg_XXXXXX";
+    if (!file) {
+        if (!write_numbers(path, mib << 20)) { perror("numbers"); return EXIT_FAILURE; }
+        file = path;
+    }
+    struct stat st;
+    if (stat(file, &st) < 0) { perror(file); return EXIT_FAILURE; }
+    double gb = st.st_size / 1e9;
+    printf("%s: %.2f GB\n\n%-8s %-12s %10s %8s  %s\n", file, gb, "op", "runner", "ms", "GB/s", "result");
+
+    struct { const char *op, *awk; } ops[] = {
+        { "sum", "{ s += $1 } END { printf \"%.17g\\n\", s }" },
+        { "mean", "{ s += $1; n++ } END { printf \"%.17g\\n\", s / n }" },
+        { "minmax", "NR == 1 { lo = hi = $1 + 0 } { v = $1 + 0; if (v < lo) lo = v; if (v > hi) hi = v }"
+                    " END { print lo, hi }" },
+        { "count", "/[0-9]/ { n++ } END { print n }" },
+    };
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        char redirect[512], piped[512], result[256];
+        snprintf(redirect, sizeof(redirect), "%s < %s", ops[i].op, file);
+        snprintf(piped, sizeof(piped), "cat %s | %s", file, ops[i].op);
+        struct { const char *name; char *argv[6]; } runs[] = {
+            { "oshell <", { oshell, "-c", redirect, NULL } },
+            { "oshell |", { oshell, "-c", piped, NULL } },
+            { "awk", { "awk", (char *)ops[i].awk, file, NULL } },
+        };
+        for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+            long ns = best_run(runs[r].argv, rounds, result, sizeof(result));
+            if (ns < 0) printf("%-8s %-12s %10s %8s\n", ops[i].op, runs[r].name, "failed", "-");
+            else printf("%-8s %-12s %10.1f %8.2f  %s\n", ops[i].op, runs[r].name, ns / 1e6, gb / (ns / 1e9), result);
+            fflush(stdout);
+        }
+    }
+    if (file == path) unlink(path);
+    return 0;
+}
@@ -5,11 +5,13 @@
 #include <ctype.h>
 #include <math.h>
 #include <stdarg.h>
+#include <unistd.h>
 
-#define SHELL_MATH_CMD_FMT "%s -b %d '%s' > /dev/null"
+#define SHELL_MATH_CMD_FMT "%s -c 'for i in 1..%d; do %s; done' > /dev/null"
 #define BASH_MATH_CMD_FMT  "bash -c 'for ((i=0;i<%d;i++)); do echo $((%s)); done' > /dev/null"
 #define SHELL_CMD_OVERHEAD_FMT "%s -e '1+1' > /dev/null"  
 #define BASH_CMD_OVERHEAD_FMT "bash -c 'true' > /dev/null" 
+#define SHELL_SPAWN_FMT "OSHELL_SPAWN=%s %s < %s > /dev/null"
 
 #define VERIFY_CMD_FMT "%s -e '%s' 2>&1"
 
@@ -78,6 +80,32 @@ void run_test(const char *desc, const char *cmd_fmt, int iterations, ...) {
     printf("%-25s: %f s\n", desc, diff_nsec(t1, t2) / 1e9);
 }
 
+/* Per-spawn latency: one OShell session runs the same external command
+ * `iterations` times under each spawn engine */
+void run_spawn_tests(const char *oshell, int iterations) {
+    static const char *engines[] = { "fork", "vfork", "clone", "posix_spawn" };
+    char script[] = "/tmp/oshell_spawn_XXXXXX";
+    char cmd[512];
+    struct timespec t1, t2;
+    int fd = mkstemp(script);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, "w");
+    if (!fp) { perror("spawn script"); return; }
+    for (int i = 0; i < iterations; i++) fputs("/bin/true\n", fp);
+    fputs("exit\n", fp);
+    fclose(fp);
+
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+        snprintf(cmd, sizeof(cmd), SHELL_SPAWN_FMT, engines[e], oshell, script);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        int ret = system(cmd);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        (void)ret;
+        printf("oShell spawn %-12s: %8.2f us/spawn\n", engines[e],
+               diff_nsec(t1, t2) / 1e3 / iterations);
+    }
+    unlink(script);
+}
+
 void convert_to_bash_expr(char *dest, const char *src, size_t max_len) {
     size_t src_len = strlen(src);
     size_t dest_idx = 0;
@@ -120,6 +148,7 @@ int main(int argc, char **argv) {
     run_test("Bash math", BASH_MATH_CMD_FMT, math_iters, math_iters, bash_expr);
     run_test("oShell command overhead", SHELL_CMD_OVERHEAD_FMT, cmd_iters, oshell);
     run_test("Bash command overhead", BASH_CMD_OVERHEAD_FMT, cmd_iters);
+    run_spawn_tests(oshell, cmd_iters);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+/* Exact 2^N and 3^N through big_pow(), single-threaded against the
+ * threaded Karatsuba squaring, for results from ten thousand to a few
+ * million bits. 2^N is a shift; 3^N exercises the multiplier. The last
+ * column is big_to_string() of the result, which is what `oshell -e`
+ * spends its time on once the power is a shift.
+ * Build: gcc -O2 bigpow_benchmark.c -o bigpow_benchmark -pthread
+ * Usage: bigpow_benchmark [threads] [max_bits]
+ */
+#define OSHELL_NO_MAIN
+#include "project.c"
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+/* Best of a few runs, in ms; 0 if the power could not be computed */
+double time_pow(uint64_t base, uint64_t e, int threads) {
+    bigint b = { &base, 1, 0 }, r;
+    struct timespec t1, t2;
+    double best = 0;
+    for (int rep = 0; rep < 3; rep++) {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (!big_pow(&r, &b, e, threads)) return 0;
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        big_free(&r);
+        double ms = diff_nsec(t1, t2) / 1e6;
+        if (rep == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+/* One decimal conversion of base^e, in ms; 0 if it could not be made */
+double time_dec(uint64_t base, uint64_t e, int threads) {
+    bigint b = { &base, 1, 0 }, r;
+    struct timespec t1, t2;
+    if (!big_pow(&r, &b, e, threads)) return 0;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    char *s = big_to_string(&r, threads);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    big_free(&r);
+    free(s);
+    return s ? diff_nsec(t1, t2) / 1e6 : 0;
+}
+
+int main(int argc, char **argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : default_threads();
+    long max_bits = argc > 2 ? atol(argv[2]) : 4000000;
+    if (threads < 1) threads = 1;
+
+    printf("Karatsuba below %d limbs is schoolbook; products split across threads from %d limbs\n\n",
+           BIG_KARATSUBA_LIMBS, EXP_THREAD_THRESHOLD);
+    char label[32];
+    snprintf(label, sizeof(label), "%d threads ms", threads);
+    printf("%-6s %10s %14s %14s %9s %12s\n", "power", "bits", "1 thread ms", label, "speedup", "decimal ms");
+    for (long bits = 10000; bits <= max_bits; bits *= 10) {
+        for (int k = 0; k < 2 && bits * (k ? 4 : 1) <= max_bits; k++) {
+            long n = bits * (k ? 4 : 1);
+            for (uint64_t base = 2; base <= 3; base++) {
+                uint64_t e = base == 2 ? (uint64_t)n : (uint64_t)(n / 1.584962500721156);
+                double single = time_pow(base, e, 1);
+                double multi = time_pow(base, e, threads);
+                printf("%llu^N  %10ld %14.3f %14.3f %8.2fx %12.3f\n", (unsigned long long)base, n,
+                       single, multi, multi > 0 ? single / multi : 0, time_dec(base, e, threads));
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CALLS 1000
+#define SESSION_CMD_FMT "%s < %s > /dev/null"
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+/* Times one OShell session that runs `line` `calls` times */
+double run_session(const char *oshell, const char *line, int calls) {
+    char script[] = "/tmp/oshell_builtin_XXXXXX";
+    char cmd[512];
+    struct timespec t1, t2;
+    int fd = mkstemp(script);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, "w");
+    if (!fp) { perror("script"); return -1; }
+    for (int i = 0; i < calls; i++) fprintf(fp, "%s\n", line);
+    fputs("exit\n", fp);
+    fclose(fp);
+
+    snprintf(cmd, sizeof(cmd), SESSION_CMD_FMT, oshell, script);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    int ret = system(cmd);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    (void)ret;
+    unlink(script);
+    return diff_nsec(t1, t2) / 1e3 / calls;
+}
+
+int main(int argc, char **argv) {
+    static const char *pairs[][2] = {
+        { "true", "/bin/true" },
+        { "echo hello", "/bin/echo hello" },
+        { "pwd", "/bin/pwd" },
+        { "printf %d 42", "/usr/bin/printf %d 42" },
+    };
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <oshell> [calls]\nExample: %s ./oshell 1000\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    int calls = argc > 2 ? atoi(argv[2]) : CALLS;
+    printf("%d calls per command, one OShell session each\n\n", calls);
+    printf("%-16s %14s %14s %9s\n", "command", "builtin us", "forked us", "speedup");
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        double b = run_session(argv[1], pairs[i][0], calls);
+        double f = run_session(argv[1], pairs[i][1], calls);
+        printf("%-16s %14.2f %14.2f %8.1fx\n", pairs[i][0], b, f, f / b);
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+/* Column evaluation benchmark: values/s for the scalar eval_expr() path,
+ * the compiled scalar evaluator and each SIMD kernel set behind -v.
+ * Build: gcc -O2 column_benchmark.c -o column_benchmark -pthread
+ */
+#define OSHELL_NO_MAIN
+#include "project.c"
+
+#define VALUES 4000000
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+void report(const char *desc, long ns, long values) {
+    printf("%-26s: %10.3f ms  %8.2f Mvalues/s\n", desc, ns / 1e6, values / (ns / 1e3));
+}
+
+/* Substitutes the value for every standalone x, as a caller of -e would */
+void substitute(char *dst, size_t cap, const char *expr, double v) {
+    size_t n = 0;
+    for (const char *p = expr; *p && n + 32 < cap; p++) {
+        if (*p == 'x' && !isalnum((unsigned char)p[1]) && (p == expr || !isalnum((unsigned char)p[-1])))
+            n += snprintf(dst + n, cap - n, "(%.17g)", v);
+        else
+            dst[n++] = *p;
+    }
+    dst[n] = '\0';
+}
+
+void bench_kernels(const char *desc, const vec_kernels *vk, const expr_prog *prog,
+                   const double *x, double *out, long n) {
+    struct timespec t1, t2;
+    double *ws = malloc((size_t)(prog->max_depth + 1) * VEC_BLOCK * sizeof(double));
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (long i = 0; i < n; i += VEC_BLOCK)
+        run_expr_block(vk, prog, x + i, out + i, n - i < VEC_BLOCK ? (int)(n - i) : VEC_BLOCK, ws);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    report(desc, diff_nsec(t1, t2), n);
+    free(ws);
+}
+
+int main(int argc, char **argv) {
+    static const char *const names[] = { "x" };
+    const char *expr = argc > 1 ? argv[1] : "x^3 + 2*x";
+    long n = argc > 2 ? atol(argv[2]) : VALUES;
+    struct timespec t1, t2;
+    char text[512];
+    expr_prog prog;
+
+    if (!compile_expr_vars(expr, &prog, names, 1)) {
+        fprintf(stderr, "Invalid expression: %s\n", expr);
+        return EXIT_FAILURE;
+    }
+    double *x = malloc(n * sizeof(double)), *ref = malloc(n * sizeof(double)),
+           *out = malloc(n * sizeof(double));
+    srand(1);
+    for (long i = 0; i < n; i++) x[i] = (rand() / (double)RAND_MAX) * 4 - 2;
+    printf("Benchmarking '%s' over %ld values\n\n", expr, n);
+
+    /* Parsing per value is slow, so time a slice of the column and scale */
+    long slice = n < 200000 ? n : 200000;
+    double v;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (long i = 0; i < slice; i++) {
+        substitute(text, sizeof(text), expr, x[i]);
+        eval_expr(text, &v);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    report("eval_expr per value", diff_nsec(t1, t2), slice);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (long i = 0; i < n; i++) {
+        prog.vars = &x[i];
+        run_expr(&prog, &ref[i]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    report("compiled scalar run_expr", diff_nsec(t1, t2), n);
+
+    bench_kernels("column, scalar kernels", &scalar_kernels, &prog, x, out, n);
+#if defined(__x86_64__) || defined(__i386__)
+    bench_kernels("column, sse2 kernels", &sse2_kernels, &prog, x, out, n);
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        bench_kernels("column, avx2 kernels", &avx2_kernels, &prog, x, out, n);
+#endif
+    if (memcmp(ref, out, n * sizeof(double)) != 0)
+        fprintf(stderr, "WARNING: column results differ from run_expr\n");
+
+    free(x); free(ref); free(out);
+    free_expr(&prog);
+    return 0;
+}
@@ -0,0 +1,93 @@
+/* Micro-benchmark: parse-per-iteration vs memoized vs compile-once
+ * expression evaluation. Negative powers are checked first against
+ * strtod's correctly rounded 2^-n and 10^-n, down to the subnormals.
+ * Build: gcc -O2 expr_benchmark.c -o expr_benchmark -pthread
+ */
+#define OSHELL_NO_MAIN
+#include "project.c"
+
+#define ITERATIONS 1000000
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+/* The old single-operator path, kept here as the baseline */
+int legacy_eval(const char *expr, double *out) {
+    double x, y; char op;
+    if (sscanf(expr, "%lf %c %lf", &x, &op, &y) != 3) return 0;
+    switch (op) {
+        case '+': *out = x + y; break;
+        case '-': *out = x - y; break;
+        case '*': *out = x * y; break;
+        case '/': if (y == 0) return -1; *out = x / y; break;
+        case '^': *out = parallel_pow(x, (int)y); break;
+        default: return -1;
+    }
+    return 1;
+}
+
+/* Mismatches of pow_int(base, -n) against strtod of the same value */
+int check_negative_powers(void) {
+    char text[32];
+    int bad = 0;
+    for (int n = 1; n <= 1080; n++) {
+        snprintf(text, sizeof(text), "0x1p-%d", n);
+        if (pow_int(2, -n) != strtod(text, NULL)) { printf("  2^-%d is %.17g\n", n, pow_int(2, -n)); bad++; }
+    }
+    for (int n = 1; n <= 330; n++) {
+        snprintf(text, sizeof(text), "1e-%d", n);
+        if (pow_int(10, -n) != strtod(text, NULL)) { printf("  10^-%d is %.17g\n", n, pow_int(10, -n)); bad++; }
+    }
+    return bad;
+}
+
+void report(const char *desc, long ns, int iterations) {
+    printf("%-28s: %10.3f ms  (%7.1f ns/eval)\n", desc, ns / 1e6, (double)ns / iterations);
+}
+
+int main(int argc, char **argv) {
+    const char *expr = argc > 1 ? argv[1] : "2^30";
+    int iterations = argc > 2 ? atoi(argv[2]) : ITERATIONS;
+    struct timespec t1, t2;
+    volatile double sink = 0;
+    double v;
+    expr_prog prog;
+
+    if (!compile_expr(expr, &prog)) {
+        fprintf(stderr, "Invalid expression: %s\n", expr);
+        return EXIT_FAILURE;
+    }
+    int bad = check_negative_powers();
+    printf("Negative powers of 2 and 10: %d mismatches\n", bad);
+    printf("Benchmarking '%s' (%d iterations, %d instructions after folding)\n\n",
+           expr, iterations, prog.len);
+
+    if (legacy_eval(expr, &v) == 1) {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < iterations; i++) { legacy_eval(expr, &v); sink += v; }
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        report("sscanf parse per iteration", diff_nsec(t1, t2), iterations);
+    } else {
+        printf("%-28s: n/a (needs a single binary operator)\n", "sscanf parse per iteration");
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int i = 0; i < iterations; i++) { eval_expr(expr, &v); sink += v; }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    report("compile per iteration", diff_nsec(t1, t2), iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int i = 0; i < iterations; i++) { eval_cached(expr, &v, NULL); sink += v; }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    report("memo lookup per iteration", diff_nsec(t1, t2), iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int i = 0; i < iterations; i++) { run_expr(&prog, &v); sink += v; }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    report("compile once, run N times", diff_nsec(t1, t2), iterations);
+
+    free_expr(&prog);
+    (void)sink;
+    return bad ? EXIT_FAILURE : 0;
+}
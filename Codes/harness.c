@@ -0,0 +1,243 @@
+/* Benchmark harness: spawns every target directly with posix_spawn (no
+ * /bin/sh -c in between), runs warmup rounds, then times N samples and
+ * reports min/median/p90/p99/stddev per scenario. The counters of
+ * project.c's perf layer add per-sample means of cycles, instructions,
+ * cache/branch misses, page faults (and how many came after the exec)
+ * and context switches, or "-" where the kernel does not provide them.
+ * Build: gcc -O2 harness.c -o harness -lm -pthread
+ * Usage: harness [-n SAMPLES] [-w WARMUP] [-c CPU] [-f text|csv|json]
+ *                [-i MATH_ITERS] [-d PIPE_DEPTH] <oshell> [scenario...]
+ * Scenarios: math, command, pipe (default: all three)
+ */
+#define OSHELL_NO_MAIN
+#include "project.c"
+#include <math.h>
+
+extern char **environ;
+
+#define MAX_ARGV 8
+
+typedef struct {
+    const char *scenario;
+    const char *target;
+    char *argv[MAX_ARGV];
+    const char *input;          /* file fed to stdin, NULL for /dev/null */
+} bench_case;
+
+typedef struct {
+    long min, median, p90, p99;
+    double mean, stddev;
+    double counters[PC_COUNT];  /* mean per sample, -1 if unavailable */
+} bench_stats;
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+/* One sample: spawn the target with stdout/stderr on /dev/null and wait
+ * for it. Returns the wall time in ns, or -1 if it could not be run. */
+long run_once(const bench_case *bc, int devnull) {
+    posix_spawn_file_actions_t fa;
+    struct timespec t1, t2;
+    pid_t pid;
+    int status, rc;
+
+    posix_spawn_file_actions_init(&fa);
+    if (bc->input) posix_spawn_file_actions_addopen(&fa, 0, bc->input, O_RDONLY, 0);
+    else posix_spawn_file_actions_adddup2(&fa, devnull, 0);
+    posix_spawn_file_actions_adddup2(&fa, devnull, 1);
+    posix_spawn_file_actions_adddup2(&fa, devnull, 2);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    rc = posix_spawnp(&pid, bc->argv[0], &fa, NULL, bc->argv, environ);
+    if (rc == 0) waitpid(pid, &status, 0);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    posix_spawn_file_actions_destroy(&fa);
+
+    if (rc != 0 || !WIFEXITED(status) || WEXITSTATUS(status) == 127) return -1;
+    return diff_nsec(t1, t2);
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted sample array */
+static long percentile(const long *v, int n, double p) {
+    int rank = (int)ceil(p / 100.0 * n);
+    return v[rank < 1 ? 0 : rank > n ? n - 1 : rank - 1];
+}
+
+void compute_stats(long *v, int n, bench_stats *st) {
+    double sum = 0, sq = 0;
+    qsort(v, n, sizeof(long), cmp_long);
+    for (int i = 0; i < n; i++) sum += v[i];
+    st->mean = sum / n;
+    for (int i = 0; i < n; i++) sq += (v[i] - st->mean) * (v[i] - st->mean);
+    st->stddev = n > 1 ? sqrt(sq / (n - 1)) : 0;
+    st->min = v[0];
+    st->median = percentile(v, n, 50);
+    st->p90 = percentile(v, n, 90);
+    st->p99 = percentile(v, n, 99);
+}
+
+void print_header(const char *format) {
+    if (strcmp(format, "csv") == 0) {
+        printf("scenario,target,samples,min_ns,median_ns,p90_ns,p99_ns,mean_ns,stddev_ns");
+        for (int i = 0; i < PC_COUNT; i++) printf(",%s", perf_events[i].name);
+        printf("\n");
+    } else if (strcmp(format, "json") == 0) {
+        printf("[\n");
+    } else {
+        printf("%-8s %-8s %10s %10s %10s %10s %10s", "scenario", "target",
+               "min us", "median us", "p90 us", "p99 us", "stddev us");
+        for (int i = 0; i < PC_COUNT; i++) printf(" %s", perf_events[i].name);
+        printf("\n");
+    }
+}
+
+void print_result(const char *format, const bench_case *bc, int n, const bench_stats *st, int first) {
+    const double *c = st->counters;
+    if (strcmp(format, "csv") == 0) {
+        printf("%s,%s,%d,%ld,%ld,%ld,%ld,%.0f,%.0f", bc->scenario, bc->target, n,
+               st->min, st->median, st->p90, st->p99, st->mean, st->stddev);
+        for (int i = 0; i < PC_COUNT; i++) {
+            if (c[i] < 0) printf(",");
+            else printf(",%.1f", c[i]);
+        }
+        printf("\n");
+    } else if (strcmp(format, "json") == 0) {
+        printf("%s  {\"scenario\": \"%s\", \"target\": \"%s\", \"samples\": %d, "
+               "\"min_ns\": %ld, \"median_ns\": %ld, \"p90_ns\": %ld, \"p99_ns\": %ld, "
+               "\"mean_ns\": %.0f, \"stddev_ns\": %.0f",
+               first ? "" : ",\n", bc->scenario, bc->target, n,
+               st->min, st->median, st->p90, st->p99, st->mean, st->stddev);
+        for (int i = 0; i < PC_COUNT; i++) {
+            if (c[i] < 0) printf(", \"%s\": null", perf_events[i].name);
+            else printf(", \"%s\": %.1f", perf_events[i].name, c[i]);
+        }
+        printf("}");
+    } else {
+        printf("%-8s %-8s %10.1f %10.1f %10.1f %10.1f %10.1f", bc->scenario, bc->target,
+               st->min / 1e3, st->median / 1e3, st->p90 / 1e3, st->p99 / 1e3, st->stddev / 1e3);
+        for (int i = 0; i < PC_COUNT; i++) {
+            int w = (int)strlen(perf_events[i].name);
+            if (c[i] < 0) printf(" %*s", w, "-");
+            else printf(" %*.0f", w, c[i]);
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+/* Writes `depth` chained `true` stages followed by exit, so one OShell
+ * session measures a single pipeline */
+int make_pipe_script(char *path, int depth) {
+    int fd = mkstemp(path);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, "w");
+    if (!fp) return 0;
+    fputs("true", fp);
+    for (int i = 1; i < depth; i++) fputs(" | true", fp);
+    fputs("\nexit\n", fp);
+    return fclose(fp) == 0;
+}
+
+int pin_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);    /* inherited by every spawned target */
+}
+
+static int wanted(char **scenarios, int n, const char *name) {
+    if (n == 0) return 1;
+    for (int i = 0; i < n; i++)
+        if (strcmp(scenarios[i], name) == 0) return 1;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int samples = 100, warmup = 10, cpu = -1, math_iters = 10000, depth = 4, opt;
+    const char *format = "text";
+
+    while ((opt = getopt(argc, argv, "n:w:c:f:i:d:")) != -1) {
+        switch (opt) {
+            case 'n': samples = atoi(optarg); break;
+            case 'w': warmup = atoi(optarg); break;
+            case 'c': cpu = atoi(optarg); break;
+            case 'f': format = optarg; break;
+            case 'i': math_iters = atoi(optarg); break;
+            case 'd': depth = atoi(optarg); break;
+            default: goto usage;
+        }
+    }
+    if (optind >= argc || samples < 1 || warmup < 0 || depth < 1) {
+usage:
+        fprintf(stderr, "Usage: %s [-n SAMPLES] [-w WARMUP] [-c CPU] [-f text|csv|json]\n"
+                "       [-i MATH_ITERS] [-d PIPE_DEPTH] <oshell> [math|command|pipe]...\n"
+                "Example: %s -n 200 -c 0 -f csv ./oshell math command\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *oshell = argv[optind];
+    char **scenarios = argv + optind + 1;
+    int nscenarios = argc - optind - 1;
+
+    if (cpu >= 0 && pin_cpu(cpu) < 0) { perror("sched_setaffinity"); return EXIT_FAILURE; }
+
+    char osh_loop[128], bash_loop[128], bash_pipe[256] = "true";
+    char script[] = "/tmp/oshell_harness_XXXXXX";
+    snprintf(osh_loop, sizeof(osh_loop), "for i in 1..%d; do 2^20; done", math_iters);
+    snprintf(bash_loop, sizeof(bash_loop), "for ((i=0;i<%d;i++)); do echo $((2**20)); done", math_iters);
+    for (int i = 1; i < depth && strlen(bash_pipe) + 8 < sizeof(bash_pipe); i++) strcat(bash_pipe, " | true");
+    if (!make_pipe_script(script, depth)) { perror("pipe script"); return EXIT_FAILURE; }
+
+    bench_case cases[] = {
+        { "math", "oshell", { (char *)oshell, "-c", osh_loop, NULL }, NULL },
+        { "math", "bash", { "bash", "-c", bash_loop, NULL }, NULL },
+        { "command", "oshell", { (char *)oshell, "-e", "1+1", NULL }, NULL },
+        { "command", "bash", { "bash", "-c", "true", NULL }, NULL },
+        { "pipe", "oshell", { (char *)oshell, NULL }, script },
+        { "pipe", "bash", { "bash", "-c", bash_pipe, NULL }, NULL },
+    };
+    int devnull = open("/dev/null", O_RDWR | O_CLOEXEC);
+    long *v = malloc(samples * sizeof(long));
+    int first = 1, rc = 0;
+    if (devnull < 0 || !v) { perror("harness"); return EXIT_FAILURE; }
+
+    print_header(format);
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const bench_case *bc = &cases[c];
+        bench_stats st;
+        if (!wanted(scenarios, nscenarios, bc->scenario)) continue;
+        for (int i = 0; i < warmup; i++) run_once(bc, devnull);
+        perf_counters pc;
+        long long sum[PC_COUNT] = { 0 };
+        int n = 0;
+        perf_open(&pc);
+        for (int i = 0; i < samples; i++) {
+            perf_start(&pc);
+            long ns = run_once(bc, devnull);
+            perf_stop(&pc);
+            if (ns < 0) continue;
+            v[n++] = ns;
+            for (int k = 0; k < PC_COUNT; k++) sum[k] = pc.v[k] < 0 || sum[k] < 0 ? -1 : sum[k] + pc.v[k];
+        }
+        perf_close(&pc);
+        if (n == 0) {
+            fprintf(stderr, "%s/%s: target failed to run\n", bc->scenario, bc->target);
+            rc = EXIT_FAILURE;
+            continue;
+        }
+        compute_stats(v, n, &st);
+        for (int k = 0; k < PC_COUNT; k++) st.counters[k] = sum[k] < 0 ? -1 : (double)sum[k] / n;
+        print_result(format, bc, n, &st, first);
+        first = 0;
+    }
+    if (strcmp(format, "json") == 0) printf("\n]\n");
+
+    unlink(script);
+    free(v);
+    close(devnull);
+    return rc;
+}
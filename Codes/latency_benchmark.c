@@ -0,0 +1,291 @@
+/* Pipe latency and throughput suite. Each shell runs on its own pty, so the
+ * numbers include its prompt and terminal I/O exactly as a user sees them.
+ *   startup   exec to the first prompt on the pty
+ *   pingpong  one byte written to `cat | ... | cat` (depth N) until it
+ *             comes back, with the pipeline already running
+ *   tput      payloads of several sizes streamed through the same pipeline
+ * OShell runs fused builtin cat, unfused builtin cat (OSHELL_FUSE=0) and
+ * /bin/cat; bash runs /bin/cat. Times are in ns.
+ * Build: gcc -O2 latency_benchmark.c -o latency_benchmark -lm
+ * Usage: latency_benchmark [-n SAMPLES] [-w WARMUP] [-d MAX_DEPTH] <oshell>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+
+#define PROMPT "OShell> "      /* bash is started with the same PS1 */
+#define TIMEOUT_MS 10000
+#define TPUT_BYTES (4L << 20)
+#define TPUT_ROUNDS 5
+
+typedef struct {
+    const char *name;
+    const char *cat;           /* stage command */
+    const char *fuse;          /* OSHELL_FUSE value, NULL for bash */
+} shell_kind;
+
+typedef struct {
+    pid_t pid;
+    int master;
+} session;
+
+static long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sorts v and prints min/median/p90/p99 with nearest-rank percentiles */
+void print_percentiles(const char *label, long *v, int n) {
+    qsort(v, n, sizeof(long), cmp_long);
+#define RANK(p) v[(int)ceil((p) / 100.0 * n) - 1]
+    printf("%-28s %10ld %10ld %10ld %10ld\n", label, v[0], RANK(50), RANK(90), RANK(99));
+#undef RANK
+    fflush(stdout);
+}
+
+/* Canonical mode while a command line is typed, raw mode for the payload.
+ * Echo and output processing stay off so bytes come back unchanged. */
+int set_mode(int master, int canonical) {
+    struct termios t;
+    if (tcgetattr(master, &t) < 0) return -1;
+    cfmakeraw(&t);
+    if (canonical) t.c_lflag |= ICANON;
+    t.c_cc[VMIN] = 1;
+    t.c_cc[VTIME] = 0;
+    return tcsetattr(master, TCSANOW, &t);
+}
+
+int session_start(session *s, const shell_kind *k, const char *oshell) {
+    s->master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (s->master < 0 || grantpt(s->master) < 0 || unlockpt(s->master) < 0) return -1;
+    const char *slave = ptsname(s->master);
+    if (!slave || set_mode(s->master, 1) < 0) return -1;
+
+    s->pid = fork();
+    if (s->pid < 0) return -1;
+    if (s->pid == 0) {
+        int fd;
+        setsid();
+        if ((fd = open(slave, O_RDWR)) < 0) _exit(127);
+        ioctl(fd, TIOCSCTTY, 0);
+        dup2(fd, 0); dup2(fd, 1); dup2(fd, 2);
+        if (fd > 2) close(fd);
+        if (k->fuse) {
+            setenv("OSHELL_FUSE", k->fuse, 1);
+            execl(oshell, oshell, (char *)NULL);
+        } else {
+            setenv("PS1", PROMPT, 1);
+            execlp("bash", "bash", "--norc", "--noprofile", "--noediting", "-i", (char *)NULL);
+        }
+        _exit(127);
+    }
+    fcntl(s->master, F_SETFL, O_NONBLOCK);
+    return 0;
+}
+
+/* Reads until `want` shows up in the output (or n raw bytes if want is NULL) */
+int session_expect(session *s, const char *want, long n) {
+    char buf[4096], tail[64] = "";
+    size_t wl = want ? strlen(want) : 0, tl = 0;
+    struct pollfd p = { s->master, POLLIN, 0 };
+    while (want || n > 0) {
+        ssize_t r = read(s->master, buf, want ? sizeof(buf) : (size_t)(n < (long)sizeof(buf) ? n : (long)sizeof(buf)));
+        if (r < 0 && errno == EAGAIN) {
+            if (poll(&p, 1, TIMEOUT_MS) <= 0) return -1;
+            continue;
+        }
+        if (r <= 0) return -1;
+        if (!want) { n -= r; continue; }
+        for (ssize_t i = 0; i < r; i++) {   /* sliding match over chunk boundaries */
+            if (tl == sizeof(tail) - 1) { memmove(tail, tail + 1, --tl); }
+            tail[tl++] = buf[i];
+            if (tl >= wl && memcmp(tail + tl - wl, want, wl) == 0) return 0;
+        }
+    }
+    return 0;
+}
+
+int session_send(session *s, const char *data, size_t len) {
+    struct pollfd p = { s->master, POLLOUT, 0 };
+    while (len > 0) {
+        ssize_t w = write(s->master, data, len);
+        if (w < 0 && errno == EAGAIN) {
+            if (poll(&p, 1, TIMEOUT_MS) <= 0) return -1;
+            continue;
+        }
+        if (w < 0) return -1;
+        data += w;
+        len -= w;
+    }
+    return 0;
+}
+
+void session_end(session *s) {
+    session_send(s, "exit\n", 5);
+    for (int i = 0; i < 100 && waitpid(s->pid, NULL, WNOHANG) == 0; i++) usleep(10000);
+    if (waitpid(s->pid, NULL, WNOHANG) == 0) { kill(s->pid, SIGKILL); waitpid(s->pid, NULL, 0); }
+    close(s->master);
+}
+
+/* Types `cat | ... | cat` and waits until a probe line has made it
+ * through, so the pipeline (not the shell) owns the terminal input */
+int pipeline_start(session *s, const shell_kind *k, int depth) {
+    char line[1024] = "";
+    for (int i = 0; i < depth; i++) {
+        if (i) strcat(line, " | ");
+        strcat(line, k->cat);
+    }
+    strcat(line, "\n");
+    if (session_send(s, line, strlen(line)) < 0) return -1;
+    if (session_send(s, "probe\n", 6) < 0 || session_expect(s, "probe\n", 0) < 0) return -1;
+    return set_mode(s->master, 0);
+}
+
+/* Back to canonical mode and send EOF so the pipeline ends and the shell
+ * prompts again. A read already blocked in raw mode finishes with raw
+ * semantics, so one newline goes through first to retire it. */
+int pipeline_stop(session *s) {
+    char eof = 4;
+    if (set_mode(s->master, 1) < 0 || session_send(s, "\n", 1) < 0 || session_expect(s, "\n", 0) < 0)
+        return -1;
+    if (session_send(s, &eof, 1) < 0) return -1;
+    return session_expect(s, PROMPT, 0);
+}
+
+void bench_startup(const shell_kind *k, const char *oshell, int samples, int warmup, long *v) {
+    int n = 0;
+    for (int i = 0; i < warmup + samples; i++) {
+        session s;
+        long t0 = now_ns();
+        if (session_start(&s, k, oshell) < 0) { perror("pty"); return; }
+        int ok = session_expect(&s, PROMPT, 0) == 0;
+        long t = now_ns() - t0;
+        session_end(&s);
+        if (ok && i >= warmup) v[n++] = t;
+    }
+    if (n) print_percentiles(k->name, v, n);
+}
+
+void bench_pingpong(const shell_kind *k, const char *oshell, int depth, int samples, int warmup, long *v) {
+    session s;
+    char label[64];
+    int n = 0;
+    if (session_start(&s, k, oshell) < 0 || session_expect(&s, PROMPT, 0) < 0 || pipeline_start(&s, k, depth) < 0) {
+        fprintf(stderr, "%s: pipeline did not start\n", k->name);
+        return;
+    }
+    for (int i = 0; i < warmup + samples; i++) {
+        long t0 = now_ns();
+        if (session_send(&s, "x", 1) < 0 || session_expect(&s, NULL, 1) < 0) break;
+        long t = now_ns() - t0;
+        if (i >= warmup) v[n++] = t;
+    }
+    pipeline_stop(&s);
+    session_end(&s);
+    snprintf(label, sizeof(label), "%s depth %d", k->name, depth);
+    if (n) print_percentiles(label, v, n);
+}
+
+/* TPUT_BYTES of payload-sized writes, read back concurrently; one sample per round */
+void bench_tput(const shell_kind *k, const char *oshell, int depth, int payload, long *v) {
+    session s;
+    char label[64], *buf = malloc(payload), sink[65536];
+    int n = 0;
+    if (!buf || session_start(&s, k, oshell) < 0 || session_expect(&s, PROMPT, 0) < 0 ||
+        pipeline_start(&s, k, depth) < 0) {
+        fprintf(stderr, "%s: pipeline did not start\n", k->name);
+        free(buf);
+        return;
+    }
+    memset(buf, 'a', payload);
+    for (int r = 0; r < TPUT_ROUNDS; r++) {
+        long sent = 0, got = 0, off = 0, t0 = now_ns();
+        while (got < TPUT_BYTES) {
+            struct pollfd p = { s.master, POLLIN | (sent < TPUT_BYTES ? POLLOUT : 0), 0 };
+            if (poll(&p, 1, TIMEOUT_MS) <= 0) goto out;
+            if ((p.revents & POLLOUT) && sent < TPUT_BYTES) {
+                ssize_t w = write(s.master, buf + off, payload - off);
+                if (w > 0) { sent += w; off = (off + w) % payload; }
+            }
+            if (p.revents & POLLIN) {
+                ssize_t rd = read(s.master, sink, sizeof(sink));
+                if (rd > 0) got += rd;
+                else if (rd == 0 || errno != EAGAIN) goto out;
+            }
+        }
+        v[n++] = (now_ns() - t0) / (TPUT_BYTES / payload);    /* ns per payload */
+    }
+out:
+    pipeline_stop(&s);
+    session_end(&s);
+    if (n) {
+        snprintf(label, sizeof(label), "%s depth %d %dB", k->name, depth, payload);
+        qsort(v, n, sizeof(long), cmp_long);
+        printf("%-28s %10ld %10ld %10.1f\n", label, v[0], v[n / 2], payload * 1e3 / v[n / 2]);
+    }
+    free(buf);
+}
+
+int main(int argc, char **argv) {
+    static const int payloads[] = { 64, 1024, 4096, 65536 };
+    int samples = 1000, warmup = 100, max_depth = 8, opt;
+    while ((opt = getopt(argc, argv, "n:w:d:")) != -1) {
+        switch (opt) {
+            case 'n': samples = atoi(optarg); break;
+            case 'w': warmup = atoi(optarg); break;
+            case 'd': max_depth = atoi(optarg); break;
+            default: optind = argc + 1;
+        }
+    }
+    if (optind != argc - 1 || samples < 1 || warmup < 0 || max_depth < 1) {
+        fprintf(stderr, "Usage: %s [-n SAMPLES] [-w WARMUP] [-d MAX_DEPTH] <oshell>\n"
+                "Example: %s -n 2000 -d 8 ./oshell\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *oshell = argv[optind];
+    const shell_kind kinds[] = {
+        { "oshell fused", "cat", "1" },
+        { "oshell unfused", "cat", "0" },
+        { "oshell /bin/cat", "/bin/cat", "1" },
+        { "bash /bin/cat", "/bin/cat", NULL },
+    };
+    const int nkinds = sizeof(kinds) / sizeof(kinds[0]);
+    long *v = malloc((samples + TPUT_ROUNDS) * sizeof(long));
+    if (!v) { perror("malloc"); return EXIT_FAILURE; }
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("=== Startup to first prompt (ns, %d samples) ===\n", samples / 10 + 1);
+    printf("%-28s %10s %10s %10s %10s\n", "", "min", "median", "p90", "p99");
+    bench_startup(&kinds[0], oshell, samples / 10 + 1, warmup / 10, v);
+    bench_startup(&kinds[3], oshell, samples / 10 + 1, warmup / 10, v);
+
+    printf("\n=== One-byte ping-pong round trip (ns, %d samples) ===\n", samples);
+    printf("%-28s %10s %10s %10s %10s\n", "", "min", "median", "p90", "p99");
+    for (int d = 1; d <= max_depth; d *= 2)
+        for (int k = 0; k < nkinds; k++) bench_pingpong(&kinds[k], oshell, d, samples, warmup, v);
+
+    printf("\n=== Throughput (%ld MiB per round, %d rounds) ===\n", TPUT_BYTES >> 20, TPUT_ROUNDS);
+    printf("%-28s %10s %10s %10s\n", "", "min ns/pl", "median", "MB/s");
+    for (int d = 1; d <= max_depth; d *= 2)
+        for (size_t p = 0; p < sizeof(payloads) / sizeof(payloads[0]); p++)
+            for (int k = 0; k < nkinds; k++) bench_tput(&kinds[k], oshell, d, payloads[p], v);
+
+    free(v);
+    return 0;
+}
@@ -0,0 +1,166 @@
+/* ns per number of num_parse() against strtod() and of num_format()
+ * against snprintf("%lf") / snprintf("%.17g"), over three inputs:
+ *   integers   whole numbers below 2^32, what most shell math prints
+ *   decimals   short decimals like 123.456
+ *   random     uniformly random finite bit patterns (17 significant digits)
+ * Every parsed value is checked against strtod and every formatted one
+ * is read back; mismatches are counted. num_pow5 is rebuilt with
+ * multi-limb arithmetic and compared first; -p prints the rebuilt table in
+ * the layout project.c includes it in.
+ * Build: gcc -O2 numio_benchmark.c -o numio_benchmark -pthread
+ * Usage: numio_benchmark [count | -p]
+ */
+#define OSHELL_NO_MAIN
+#include "project.c"
+
+#define COUNT 1000000
+#define NUM_POW5_LIMBS 29          /* 2^1792, the dividend for negative powers */
+#define NUM_POW5_COUNT (NUM_POW5_MAX - NUM_POW5_MIN + 1)
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static double sample(int kind) {
+    if (kind == 0) return (double)(uint32_t)next_rand();
+    if (kind == 1) return (double)(next_rand() % 10000000) / 1000;
+    for (;;) {
+        uint64_t b = next_rand();
+        double d;
+        memcpy(&d, &b, sizeof(d));
+        if (isfinite(d)) return d;
+    }
+}
+
+/* 64 bits of the little-endian number x[0..n) starting at bit pos */
+static uint64_t limb_word(const uint64_t *x, int n, long pos) {
+    long i = pos >> 6;
+    int s = pos & 63;
+    uint64_t lo = i >= 0 && i < n ? x[i] : 0, hi = i + 1 >= 0 && i + 1 < n ? x[i + 1] : 0;
+    return s ? lo >> s | hi << (64 - s) : lo;
+}
+
+static long limb_bits(const uint64_t *x, int n) {
+    while (n > 0 && x[n - 1] == 0) n--;
+    return n ? 64L * n - __builtin_clzll(x[n - 1]) : 0;
+}
+
+static void limb_top128(const uint64_t *x, int n, uint64_t out[2]) {
+    long len = limb_bits(x, n);
+    out[0] = limb_word(x, n, len - 64);
+    out[1] = limb_word(x, n, len - 128);
+}
+
+/* project.c's num_pow5. 5^q for q >= 0 is kept exactly and truncated.
+ * For q < 0 the entry is floor(2^b / 5^-q) + 1 truncated to 128 bits, with
+ * b chosen as in the Eisel-Lemire paper; floor(2^1792 / 5^n) is carried along by dividing by
+ * five, and shifting it down gives floor(2^b / 5^n) exactly. */
+static void pow5_build(uint64_t out[][2]) {
+    uint64_t p[NUM_POW5_LIMBS] = { 1 }, x[NUM_POW5_LIMBS] = { 0 }, y[NUM_POW5_LIMBS];
+    x[NUM_POW5_LIMBS - 1] = 1;
+    for (int n = 0; n <= NUM_POW5_MAX; n++) {
+        if (n > 0) {
+            unsigned __int128 carry = 0, rem = 0;
+            for (int i = 0; i < NUM_POW5_LIMBS; i++) {
+                carry += (unsigned __int128)p[i] * 5;
+                p[i] = (uint64_t)carry;
+                carry >>= 64;
+            }
+            for (int i = NUM_POW5_LIMBS - 1; i >= 0; i--) {
+                rem = rem << 64 | x[i];
+                x[i] = (uint64_t)(rem / 5);
+                rem %= 5;
+            }
+        }
+        limb_top128(p, NUM_POW5_LIMBS, out[n - NUM_POW5_MIN]);
+        if (n == 0 || -n < NUM_POW5_MIN) continue;
+        long z = limb_bits(p, NUM_POW5_LIMBS), b = n <= 27 ? z + 127 : 2 * z + 128;
+        long shift = 64L * (NUM_POW5_LIMBS - 1) - b;
+        for (int i = 0; i < NUM_POW5_LIMBS; i++) y[i] = limb_word(x, NUM_POW5_LIMBS, 64L * i + shift);
+        for (int i = 0; i < NUM_POW5_LIMBS && ++y[i] == 0; i++) ;
+        limb_top128(y, NUM_POW5_LIMBS, out[-n - NUM_POW5_MIN]);
+    }
+}
+
+static int count_equal(uint64_t t[][2]) {
+    int same = 0;
+    for (int q = 0; q < NUM_POW5_COUNT; q++) same += t[q][0] == num_pow5[q][0] && t[q][1] == num_pow5[q][1];
+    return same;
+}
+
+void report(const char *desc, long ns, int n) {
+    printf("  %-28s %8.1f ns/op\n", desc, (double)ns / n);
+}
+
+int main(int argc, char **argv) {
+    static uint64_t pow5[NUM_POW5_COUNT][2];
+    pow5_build(pow5);
+    if (argc > 1 && strcmp(argv[1], "-p") == 0) {
+        for (int q = 0; q < NUM_POW5_COUNT; q++)
+            printf("%s{ 0x%016llx, 0x%016llx },%s", q % 2 ? " " : "    ", (unsigned long long)pow5[q][0],
+                   (unsigned long long)pow5[q][1], q % 2 || q + 1 == NUM_POW5_COUNT ? "\n" : "");
+        return 0;
+    }
+    printf("num_pow5: %d of %d entries differ from the rebuilt table\n\n",
+           NUM_POW5_COUNT - count_equal(pow5), NUM_POW5_COUNT);
+
+    int n = argc > 1 ? atoi(argv[1]) : COUNT;
+    const char *kinds[] = { "integers", "decimals", "random" };
+    double *v = malloc(n * sizeof(double));
+    char *text = malloc((size_t)n * NUM_FORMAT_MAX), buf[64];
+    struct timespec t1, t2;
+    volatile double sink = 0;
+    if (n < 1 || !v || !text) return EXIT_FAILURE;
+
+    for (int k = 0; k < 3; k++) {
+        long bad = 0;
+        for (int i = 0; i < n; i++) {
+            v[i] = sample(k);
+            snprintf(text + (size_t)i * NUM_FORMAT_MAX, NUM_FORMAT_MAX, "%.17g", v[i]);
+        }
+        printf("%s (%d values)\n", kinds[k], n);
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < n; i++) sink += strtod(text + (size_t)i * NUM_FORMAT_MAX, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        report("parse   strtod", diff_nsec(t1, t2), n);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < n; i++) sink += num_parse(text + (size_t)i * NUM_FORMAT_MAX, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        report("parse   num_parse", diff_nsec(t1, t2), n);
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < n; i++) sink += snprintf(buf, sizeof(buf), "%lf", v[i]);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        report("format  snprintf %lf", diff_nsec(t1, t2), n);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < n; i++) sink += snprintf(buf, sizeof(buf), "%.17g", v[i]);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        report("format  snprintf %.17g", diff_nsec(t1, t2), n);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < n; i++) sink += num_format(v[i], buf);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        report("format  num_format", diff_nsec(t1, t2), n);
+
+        for (int i = 0; i < n; i++) {
+            const char *s = text + (size_t)i * NUM_FORMAT_MAX;
+            double a = strtod(s, NULL), b = num_parse(s, NULL);
+            num_format(v[i], buf);
+            if (memcmp(&a, &b, sizeof(a)) != 0 || num_parse(buf, NULL) != v[i]) bad++;
+        }
+        printf("  %-28s %8ld\n\n", "mismatches", bad);
+    }
+    free(v);
+    free(text);
+    (void)sink;
+    return 0;
+}
@@ -0,0 +1,115 @@
+/* Fan-out throughput: `parallel` inside one OShell process against
+ * `xargs -P` over the same items, in jobs per second.
+ *   echo    tiny job: builtin echo on a worker thread vs /bin/echo
+ *   math    tiny job: {}*{} evaluated in-process vs expr(1)
+ *   true    tiny external job: /bin/true spawned by both
+ *   awk     CPU-heavy external job, fewer items
+ * Build: gcc -O2 parallel_benchmark.c -o parallel_benchmark
+ * Usage: parallel_benchmark [-n ITEMS] [-j JOBS] [-r ROUNDS] <oshell>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#define AWK_LOOP "BEGIN{for(i=0;i<2000000;i++)s+=i}"
+
+extern char **environ;
+
+static long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/* Best wall time over rounds, stdin from input, stdout to /dev/null */
+long best_run(char **argv, const char *input, int rounds) {
+    long best = -1;
+    for (int r = 0; r < rounds; r++) {
+        posix_spawn_file_actions_t fa;
+        pid_t pid;
+        int status = 0;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_addopen(&fa, 0, input, O_RDONLY, 0);
+        posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+        long t0 = now_ns();
+        int rc = posix_spawnp(&pid, argv[0], &fa, NULL, argv, environ);
+        if (rc == 0) waitpid(pid, &status, 0);
+        long t = now_ns() - t0;
+        posix_spawn_file_actions_destroy(&fa);
+        if (rc != 0 || !WIFEXITED(status)) return -1;
+        if (best < 0 || t < best) best = t;
+    }
+    return best;
+}
+
+int write_items(char *path, int n) {
+    int fd = mkstemp(path);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, "w");
+    if (!fp) return 0;
+    for (int i = 1; i <= n; i++) fprintf(fp, "%d\n", i);
+    return fclose(fp) == 0;
+}
+
+void report(const char *job, const char *runner, int n, long ns) {
+    if (ns < 0) printf("%-6s %-10s %8d %12s %12s\n", job, runner, n, "failed", "-");
+    else printf("%-6s %-10s %8d %12.2f %12.0f\n", job, runner, n, ns / 1e6, n / (ns / 1e9));
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    int items = 2000, jobs = (int)sysconf(_SC_NPROCESSORS_ONLN), rounds = 3, opt;
+    while ((opt = getopt(argc, argv, "n:j:r:")) != -1) {
+        switch (opt) {
+            case 'n': items = atoi(optarg); break;
+            case 'j': jobs = atoi(optarg); break;
+            case 'r': rounds = atoi(optarg); break;
+            default: goto usage;
+        }
+    }
+    if (optind >= argc || items < 1 || jobs < 1 || rounds < 1) {
+usage:
+        fprintf(stderr, "Usage: %s [-n ITEMS] [-j JOBS] [-r ROUNDS] <oshell>\n"
+                "Example: %s -n 5000 -j 8 ./oshell\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    char *oshell = argv[optind];
+    char small[] = "/tmp/oshell_par_XXXXXX", heavy[] = "/tmp/oshell_par_heavy_XXXXXX";
+    int heavy_items = jobs * 4;
+    if (!write_items(small, items) || !write_items(heavy, heavy_items)) { perror("items"); return EXIT_FAILURE; }
+    char j[16], osh_small[256], osh_heavy[256];
+    snprintf(j, sizeof(j), "%d", jobs);
+
+    printf("%d workers\n\n%-6s %-10s %8s %12s %12s\n", jobs, "job", "runner", "jobs", "ms", "jobs/s");
+    struct {
+        const char *job, *osh_template;
+        char *xargs_cmd[8];
+        const char *input;
+        int n;
+    } cases[] = {
+        { "echo", "echo {}", { "echo", NULL }, small, items },
+        { "math", "{}*{}", { "-I{}", "expr", "{}", "*", "{}", NULL }, small, items },
+        { "true", "/bin/true", { "/bin/true", NULL }, small, items },
+        { "awk", "awk '" AWK_LOOP "'", { "awk", AWK_LOOP, NULL }, heavy, heavy_items },
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        char *osh = c == 3 ? osh_heavy : osh_small;
+        snprintf(osh, 256, "parallel -j %d -a %s %s", jobs, cases[c].input, cases[c].osh_template);
+        char *osh_argv[] = { oshell, "-c", osh, NULL };
+        char *xargs_argv[16] = { "xargs", "-P", j };
+        int k = 3;
+        if (strcmp(cases[c].xargs_cmd[0], "-I{}") != 0) { xargs_argv[k++] = "-n"; xargs_argv[k++] = "1"; }
+        for (int i = 0; cases[c].xargs_cmd[i]; i++) xargs_argv[k++] = cases[c].xargs_cmd[i];
+        xargs_argv[k] = NULL;
+        report(cases[c].job, "parallel", cases[c].n, best_run(osh_argv, cases[c].input, rounds));
+        report(cases[c].job, "xargs -P", cases[c].n, best_run(xargs_argv, cases[c].input, rounds));
+    }
+    unlink(small);
+    unlink(heavy);
+    return 0;
+}
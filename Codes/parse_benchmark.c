@@ -0,0 +1,141 @@
+/* Command line parsing cost: the old strtok parser (split on '|', copy
+ * the last command to find '&', tokenize every stage again; 64 args and
+ * 16 stages at most, no quoting) against the one-pass arena parser.
+ * Reports ns per line and malloc calls per line once the arena has
+ * settled; "first" is the allocation count of the very first parse.
+ * Build: gcc -O2 parse_benchmark.c -o parse_benchmark -pthread
+ * Usage: parse_benchmark [iterations]
+ */
+#define OSHELL_NO_MAIN
+#include "project.c"
+
+#define ITERATIONS 1000000
+#define LEGACY_MAX_ARGS     64
+#define LEGACY_MAX_COMMANDS 16
+
+/* Every malloc/calloc/realloc in the process goes through these */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+static long malloc_calls;
+
+void *malloc(size_t n) { malloc_calls++; return __libc_malloc(n); }
+void *calloc(size_t n, size_t m) { malloc_calls++; return __libc_calloc(n, m); }
+void *realloc(void *p, size_t n) { malloc_calls++; return __libc_realloc(p, n); }
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+typedef struct {
+    char *args[LEGACY_MAX_ARGS];
+    char *input_file, *output_file;
+    const builtin *bi;
+} legacy_stage;
+
+static void legacy_tokenize(char *command, char **args) {
+    int i = 0;
+    char *tok = strtok(command, " \t\r\n");
+    while (tok && i < LEGACY_MAX_ARGS - 1) { args[i++] = tok; tok = strtok(NULL, " \t\r\n"); }
+    args[i] = NULL;
+}
+
+/* The parser run_line() used before, minus the pipesize prefix */
+int legacy_parse(char *line, legacy_stage *stages) {
+    char *commands[LEGACY_MAX_COMMANDS];
+    int n = 0;
+    char *tok = strtok(line, "|");
+    while (tok && n < LEGACY_MAX_COMMANDS) { commands[n++] = trim_whitespace(tok); tok = strtok(NULL, "|"); }
+    if (n == 0) return 0;
+    char temp_cmd[1024], *args_temp[LEGACY_MAX_ARGS];
+    strncpy(temp_cmd, commands[n - 1], sizeof(temp_cmd));
+    temp_cmd[sizeof(temp_cmd) - 1] = '\0';
+    legacy_tokenize(temp_cmd, args_temp);
+    int argc = 0;
+    while (args_temp[argc]) argc++;
+    if (argc > 0 && strcmp(args_temp[argc - 1], "&") == 0) {
+        char *amp = strstr(commands[n - 1], "&");
+        if (amp) { *amp = '\0'; commands[n - 1] = trim_whitespace(commands[n - 1]); }
+    }
+    for (int c = 0; c < n; c++) {
+        legacy_stage *st = &stages[c];
+        int in = -1, out = -1;
+        legacy_tokenize(commands[c], st->args);
+        st->input_file = st->output_file = NULL;
+        for (int j = 0; st->args[j]; j++) {
+            if (strcmp(st->args[j], "<") == 0) { in = j; st->input_file = st->args[j + 1]; }
+            if (strcmp(st->args[j], ">") == 0) { out = j; st->output_file = st->args[j + 1]; }
+        }
+        if (in != -1) st->args[in] = NULL;
+        if (out != -1) st->args[out] = NULL;
+        if (!st->args[0]) return 0;
+        st->bi = find_builtin(st->args[0]);
+    }
+    return n;
+}
+
+static int legacy_fits(const char *line) {
+    int stages = 1, words = 0, in_word = 0;
+    for (const char *p = line; *p; p++) {
+        if (*p == '|') { stages++; words = 0; in_word = 0; }
+        else if (isspace((unsigned char)*p)) in_word = 0;
+        else if (!in_word) { in_word = 1; words++; }
+        if (words >= LEGACY_MAX_ARGS) return 0;
+    }
+    return stages <= LEGACY_MAX_COMMANDS;
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : ITERATIONS;
+    char long_args[4096] = "echo", long_pipe[4096] = "cat";
+    for (int i = 0; i < 200; i++) snprintf(long_args + strlen(long_args), 16, " arg%d", i);
+    for (int i = 1; i < 64; i++) strcat(long_pipe, " | cat -");
+    const char *lines[] = {
+        "ls -la /tmp",
+        "cat < input.txt | grep foo | sort -r | uniq -c > out.txt &",
+        "echo \"quoted | pipe\" 'single quoted' a\\ b",
+        "cat | cat | cat | cat | cat | cat | cat | cat | cat | cat | cat | cat",
+        long_args,
+        long_pipe,
+    };
+    static legacy_stage legacy[LEGACY_MAX_COMMANDS];
+    arena a = { NULL };
+    pipeline p;
+    char *buf = malloc(8192);
+    struct timespec t1, t2;
+    if (!buf) return EXIT_FAILURE;
+
+    printf("%d iterations per line\n\n", iterations);
+    printf("%-32s %12s %12s %10s %10s\n", "line", "strtok ns", "arena ns", "mallocs", "first");
+    for (size_t l = 0; l < sizeof(lines) / sizeof(lines[0]); l++) {
+        const char *line = lines[l];
+        size_t n = strlen(line) + 1;
+        char name[33], legacy_ns[16] = "n/a";
+        snprintf(name, sizeof(name), "%.29s%s", line, n > 30 ? "..." : "");
+
+        if (legacy_fits(line)) {
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            for (int i = 0; i < iterations; i++) { memcpy(buf, line, n); legacy_parse(buf, legacy); }
+            clock_gettime(CLOCK_MONOTONIC, &t2);
+            snprintf(legacy_ns, sizeof(legacy_ns), "%.1f", (double)diff_nsec(t1, t2) / iterations);
+        }
+
+        arena_free(&a);
+        long before = malloc_calls;
+        memcpy(buf, line, n);
+        parse_pipeline(buf, &p, &a);
+        arena_reset(&a);
+        long first = malloc_calls - before;
+        for (int i = 0; i < 16; i++) { memcpy(buf, line, n); parse_pipeline(buf, &p, &a); arena_reset(&a); }
+
+        before = malloc_calls;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < iterations; i++) { memcpy(buf, line, n); parse_pipeline(buf, &p, &a); arena_reset(&a); }
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        printf("%-32s %12s %12.1f %10.3f %10ld\n", name, legacy_ns, (double)diff_nsec(t1, t2) / iterations,
+               (double)(malloc_calls - before) / iterations, first);
+    }
+    arena_free(&a);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CALLS 1000
+#define PATH_DIRS 24       /* decoy directories searched before the real one */
+#define SESSION_CMD_FMT "PATH='%s' %s < %s > /dev/null"
+#define BASH_CMD_FMT    "PATH='%s' bash -c 'for ((i=0;i<%d;i++)); do osh_nop; done' > /dev/null"
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+/* Times one OShell session; `calls` repetitions of the given lines */
+double run_session(const char *oshell, const char *path, const char *lines, int calls) {
+    char script[] = "/tmp/oshell_path_XXXXXX";
+    char cmd[8192];
+    struct timespec t1, t2;
+    int fd = mkstemp(script);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, "w");
+    if (!fp) { perror("script"); return -1; }
+    for (int i = 0; i < calls; i++) fputs(lines, fp);
+    fputs("exit\n", fp);
+    fclose(fp);
+
+    snprintf(cmd, sizeof(cmd), SESSION_CMD_FMT, path, oshell, script);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    int ret = system(cmd);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    (void)ret;
+    unlink(script);
+    return diff_nsec(t1, t2) / 1e3 / calls;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <oshell> [calls]\nExample: %s ./oshell 1000\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    int calls = argc > 2 ? atoi(argv[2]) : CALLS;
+    char root[] = "/tmp/oshell_pathbench_XXXXXX";
+    char path[6000] = "", dir[256], abs_line[320], cmd[8192];
+    struct timespec t1, t2;
+
+    /* A realistic long PATH: decoys such as ~/.local/bin, /opt/x/bin, ...
+     * then the directory holding the command, then the system PATH */
+    if (!mkdtemp(root)) { perror("mkdtemp"); return EXIT_FAILURE; }
+    for (int i = 0; i <= PATH_DIRS; i++) {
+        snprintf(dir, sizeof(dir), "%s/d%02d", root, i);
+        mkdir(dir, 0755);
+        strcat(path, dir);
+        strcat(path, ":");
+    }
+    strncat(path, getenv("PATH") ? getenv("PATH") : "/usr/bin:/bin", sizeof(path) - strlen(path) - 1);
+    snprintf(dir, sizeof(dir), "%s/d%02d/osh_nop", root, PATH_DIRS);
+    if (symlink("/bin/true", dir) < 0) { perror("symlink"); return EXIT_FAILURE; }
+    snprintf(abs_line, sizeof(abs_line), "%s\n", dir);
+
+    printf("%d calls, command found after %d PATH directories\n\n", calls, PATH_DIRS);
+    printf("%-32s: %8.2f us/call\n", "oShell absolute path",
+           run_session(argv[1], path, abs_line, calls));
+    printf("%-32s: %8.2f us/call\n", "oShell hashed lookup",
+           run_session(argv[1], path, "osh_nop\n", calls));
+    printf("%-32s: %8.2f us/call\n", "oShell hash -r before each call",
+           run_session(argv[1], path, "hash -r\nosh_nop\n", calls));
+
+    snprintf(cmd, sizeof(cmd), BASH_CMD_FMT, path, calls);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    int ret = system(cmd);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    (void)ret;
+    printf("%-32s: %8.2f us/call\n", "Bash (hashed)", diff_nsec(t1, t2) / 1e3 / calls);
+
+    unlink(dir);
+    for (int i = 0; i <= PATH_DIRS; i++) {
+        snprintf(dir, sizeof(dir), "%s/d%02d", root, i);
+        rmdir(dir);
+    }
+    rmdir(root);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FILE_MB 256
+#define SESSION_CMD_FMT "%s < %s > /dev/null"
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+int make_input(const char *path, long mb) {
+    static char block[1 << 20];
+    FILE *fp = fopen(path, "w");
+    if (!fp) return 0;
+    for (size_t i = 0; i < sizeof(block); i++) block[i] = 'a' + i % 26;
+    for (long i = 0; i < mb; i++) fwrite(block, 1, sizeof(block), fp);
+    return fclose(fp) == 0;
+}
+
+/* One session: `pipesize SIZE cat < input | cat | ... > /dev/null`, with
+ * `depth` stages of `cat_cmd` */
+double run_pipeline(const char *oshell, const char *input, long bytes, int size,
+                    int depth, const char *cat_cmd) {
+    char script[] = "/tmp/oshell_tput_XXXXXX";
+    char cmd[512];
+    struct timespec t1, t2;
+    int fd = mkstemp(script);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, "w");
+    if (!fp) { perror("script"); return -1; }
+    fprintf(fp, "pipesize %d %s < %s", size, cat_cmd, input);
+    for (int i = 1; i < depth; i++) fprintf(fp, " | %s", cat_cmd);
+    fprintf(fp, " > /dev/null\nexit\n");
+    fclose(fp);
+
+    snprintf(cmd, sizeof(cmd), SESSION_CMD_FMT, oshell, script);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    int ret = system(cmd);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    (void)ret;
+    unlink(script);
+    return bytes / (double)diff_nsec(t1, t2);    /* bytes per ns == GB/s */
+}
+
+int main(int argc, char **argv) {
+    static const int sizes[] = { 0, 256 * 1024, 1024 * 1024 };
+    static const int depths[] = { 1, 2, 4, 8 };
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <oshell> [file_mb]\nExample: %s ./oshell 256\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    long mb = argc > 2 ? atol(argv[2]) : FILE_MB;
+    char input[] = "/tmp/oshell_tput_in_XXXXXX";
+    int fd = mkstemp(input);
+    if (fd < 0 || !make_input(input, mb)) { perror("input"); return EXIT_FAILURE; }
+    close(fd);
+
+    printf("%ld MiB through N stages (GB/s); pipe size 0 = kernel default\n\n", mb);
+    printf("%-10s %6s %14s %14s\n", "pipe size", "depth", "builtin cat", "/bin/cat");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+            double in_proc = run_pipeline(argv[1], input, mb << 20, sizes[s], depths[d], "cat");
+            double ext = run_pipeline(argv[1], input, mb << 20, sizes[s], depths[d], "/bin/cat");
+            printf("%-10d %6d %14.2f %14.2f\n", sizes[s], depths[d], in_proc, ext);
+        }
+    }
+    unlink(input);
+    return 0;
+}
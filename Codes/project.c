@@ -6,24 +6,42 @@ Created by:
 4. Himanshu Raj
 */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <ctype.h>
 #include <pthread.h>
 #include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <stdint.h>
+#include <linux/perf_event.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <arpa/inet.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-#define MAX_LINE_LENGTH 1024
-#define MAX_ARGS        64
-#define MAX_COMMANDS    16
-#define EXP_THREAD_THRESHOLD 1000000  /* ensure fast exponentiation always used */
+#define EXP_THREAD_THRESHOLD 2048     /* limbs per operand before a product is split across threads */
 
-typedef struct { double base; int exp; double result; } thread_data;
+/* One half-size product of a threaded Karatsuba split */
+typedef struct { const uint64_t *a, *b; size_t n; uint64_t *r; int threads; } thread_data;
 
 void sigint_handler(int signo) {
     printf("\nPlease use \"exit\" to terminate the shell.\n");
@@ -38,231 +56,6227 @@ char *trim_whitespace(char *s) {
     return s;
 }
 
-void tokenize_command(char *command, char **args) {
-    int i = 0;
-    char *tok = strtok(command, " \t\r\n");
-    while (tok && i < MAX_ARGS - 1) { args[i++] = tok; tok = strtok(NULL, " \t\r\n"); }
-    args[i] = NULL;
+/* Fast exponentiation (no threads) */
+double parallel_pow(double base, unsigned long long exp) {
+    double result = 1;
+    while (exp > 0) {
+        if (exp & 1) result *= base;
+        base *= base;
+        exp >>= 1;
+    }
+    return result;
+}
+
+/* Numeric I/O: decimal text <-> double without the locale and varargs
+ * machinery of strtod() and printf().
+ * num_parse() takes Clinger's fast path when the digits and the power of
+ * ten are both exact doubles and Eisel-Lemire otherwise, which is correctly
+ * rounded for up to 19 significant digits. Longer inputs that could round
+ * either way, hex, inf and nan go to strtod().
+ * num_format() writes the shortest digits that read back as the same double:
+ * integers directly, everything else through Grisu2.
+ * Both share num_pow5, the leading 128 bits of 5^q, computed exactly with
+ * multi-limb arithmetic ahead of time.
+ */
+#define NUM_POW5_MIN   (-342)
+#define NUM_POW5_MAX   348
+#define NUM_FORMAT_MAX 32          /* bytes num_format() may write, NUL included */
+
+/* {high, low} for q = NUM_POW5_MIN..NUM_POW5_MAX, generated and checked by
+ * numio_benchmark -p; a table in .rodata costs a one-shot run nothing
+ * until a slow path touches it */
+static const uint64_t num_pow5[NUM_POW5_MAX - NUM_POW5_MIN + 1][2] = {
+    { 0xeef453d6923bd65a, 0x113faa2906a13b3f }, { 0x9558b4661b6565f8, 0x4ac7ca59a424c507 },
+    { 0xbaaee17fa23ebf76, 0x5d79bcf00d2df649 }, { 0xe95a99df8ace6f53, 0xf4d82c2c107973dc },
+    { 0x91d8a02bb6c10594, 0x79071b9b8a4be869 }, { 0xb64ec836a47146f9, 0x9748e2826cdee284 },
+    { 0xe3e27a444d8d98b7, 0xfd1b1b2308169b25 }, { 0x8e6d8c6ab0787f72, 0xfe30f0f5e50e20f7 },
+    { 0xb208ef855c969f4f, 0xbdbd2d335e51a935 }, { 0xde8b2b66b3bc4723, 0xad2c788035e61382 },
+    { 0x8b16fb203055ac76, 0x4c3bcb5021afcc31 }, { 0xaddcb9e83c6b1793, 0xdf4abe242a1bbf3d },
+    { 0xd953e8624b85dd78, 0xd71d6dad34a2af0d }, { 0x87d4713d6f33aa6b, 0x8672648c40e5ad68 },
+    { 0xa9c98d8ccb009506, 0x680efdaf511f18c2 }, { 0xd43bf0effdc0ba48, 0x0212bd1b2566def2 },
+    { 0x84a57695fe98746d, 0x014bb630f7604b57 }, { 0xa5ced43b7e3e9188, 0x419ea3bd35385e2d },
+    { 0xcf42894a5dce35ea, 0x52064cac828675b9 }, { 0x818995ce7aa0e1b2, 0x7343efebd1940993 },
+    { 0xa1ebfb4219491a1f, 0x1014ebe6c5f90bf8 }, { 0xca66fa129f9b60a6, 0xd41a26e077774ef6 },
+    { 0xfd00b897478238d0, 0x8920b098955522b4 }, { 0x9e20735e8cb16382, 0x55b46e5f5d5535b0 },
+    { 0xc5a890362fddbc62, 0xeb2189f734aa831d }, { 0xf712b443bbd52b7b, 0xa5e9ec7501d523e4 },
+    { 0x9a6bb0aa55653b2d, 0x47b233c92125366e }, { 0xc1069cd4eabe89f8, 0x999ec0bb696e840a },
+    { 0xf148440a256e2c76, 0xc00670ea43ca250d }, { 0x96cd2a865764dbca, 0x380406926a5e5728 },
+    { 0xbc807527ed3e12bc, 0xc605083704f5ecf2 }, { 0xeba09271e88d976b, 0xf7864a44c633682e },
+    { 0x93445b8731587ea3, 0x7ab3ee6afbe0211d }, { 0xb8157268fdae9e4c, 0x5960ea05bad82964 },
+    { 0xe61acf033d1a45df, 0x6fb92487298e33bd }, { 0x8fd0c16206306bab, 0xa5d3b6d479f8e056 },
+    { 0xb3c4f1ba87bc8696, 0x8f48a4899877186c }, { 0xe0b62e2929aba83c, 0x331acdabfe94de87 },
+    { 0x8c71dcd9ba0b4925, 0x9ff0c08b7f1d0b14 }, { 0xaf8e5410288e1b6f, 0x07ecf0ae5ee44dd9 },
+    { 0xdb71e91432b1a24a, 0xc9e82cd9f69d6150 }, { 0x892731ac9faf056e, 0xbe311c083a225cd2 },
+    { 0xab70fe17c79ac6ca, 0x6dbd630a48aaf406 }, { 0xd64d3d9db981787d, 0x092cbbccdad5b108 },
+    { 0x85f0468293f0eb4e, 0x25bbf56008c58ea5 }, { 0xa76c582338ed2621, 0xaf2af2b80af6f24e },
+    { 0xd1476e2c07286faa, 0x1af5af660db4aee1 }, { 0x82cca4db847945ca, 0x50d98d9fc890ed4d },
+    { 0xa37fce126597973c, 0xe50ff107bab528a0 }, { 0xcc5fc196fefd7d0c, 0x1e53ed49a96272c8 },
+    { 0xff77b1fcbebcdc4f, 0x25e8e89c13bb0f7a }, { 0x9faacf3df73609b1, 0x77b191618c54e9ac },
+    { 0xc795830d75038c1d, 0xd59df5b9ef6a2417 }, { 0xf97ae3d0d2446f25, 0x4b0573286b44ad1d },
+    { 0x9becce62836ac577, 0x4ee367f9430aec32 }, { 0xc2e801fb244576d5, 0x229c41f793cda73f },
+    { 0xf3a20279ed56d48a, 0x6b43527578c1110f }, { 0x9845418c345644d6, 0x830a13896b78aaa9 },
+    { 0xbe5691ef416bd60c, 0x23cc986bc656d553 }, { 0xedec366b11c6cb8f, 0x2cbfbe86b7ec8aa8 },
+    { 0x94b3a202eb1c3f39, 0x7bf7d71432f3d6a9 }, { 0xb9e08a83a5e34f07, 0xdaf5ccd93fb0cc53 },
+    { 0xe858ad248f5c22c9, 0xd1b3400f8f9cff68 }, { 0x91376c36d99995be, 0x23100809b9c21fa1 },
+    { 0xb58547448ffffb2d, 0xabd40a0c2832a78a }, { 0xe2e69915b3fff9f9, 0x16c90c8f323f516c },
+    { 0x8dd01fad907ffc3b, 0xae3da7d97f6792e3 }, { 0xb1442798f49ffb4a, 0x99cd11cfdf41779c },
+    { 0xdd95317f31c7fa1d, 0x40405643d711d583 }, { 0x8a7d3eef7f1cfc52, 0x482835ea666b2572 },
+    { 0xad1c8eab5ee43b66, 0xda3243650005eecf }, { 0xd863b256369d4a40, 0x90bed43e40076a82 },
+    { 0x873e4f75e2224e68, 0x5a7744a6e804a291 }, { 0xa90de3535aaae202, 0x711515d0a205cb36 },
+    { 0xd3515c2831559a83, 0x0d5a5b44ca873e03 }, { 0x8412d9991ed58091, 0xe858790afe9486c2 },
+    { 0xa5178fff668ae0b6, 0x626e974dbe39a872 }, { 0xce5d73ff402d98e3, 0xfb0a3d212dc8128f },
+    { 0x80fa687f881c7f8e, 0x7ce66634bc9d0b99 }, { 0xa139029f6a239f72, 0x1c1fffc1ebc44e80 },
+    { 0xc987434744ac874e, 0xa327ffb266b56220 }, { 0xfbe9141915d7a922, 0x4bf1ff9f0062baa8 },
+    { 0x9d71ac8fada6c9b5, 0x6f773fc3603db4a9 }, { 0xc4ce17b399107c22, 0xcb550fb4384d21d3 },
+    { 0xf6019da07f549b2b, 0x7e2a53a146606a48 }, { 0x99c102844f94e0fb, 0x2eda7444cbfc426d },
+    { 0xc0314325637a1939, 0xfa911155fefb5308 }, { 0xf03d93eebc589f88, 0x793555ab7eba27ca },
+    { 0x96267c7535b763b5, 0x4bc1558b2f3458de }, { 0xbbb01b9283253ca2, 0x9eb1aaedfb016f16 },
+    { 0xea9c227723ee8bcb, 0x465e15a979c1cadc }, { 0x92a1958a7675175f, 0x0bfacd89ec191ec9 },
+    { 0xb749faed14125d36, 0xcef980ec671f667b }, { 0xe51c79a85916f484, 0x82b7e12780e7401a },
+    { 0x8f31cc0937ae58d2, 0xd1b2ecb8b0908810 }, { 0xb2fe3f0b8599ef07, 0x861fa7e6dcb4aa15 },
+    { 0xdfbdcece67006ac9, 0x67a791e093e1d49a }, { 0x8bd6a141006042bd, 0xe0c8bb2c5c6d24e0 },
+    { 0xaecc49914078536d, 0x58fae9f773886e18 }, { 0xda7f5bf590966848, 0xaf39a475506a899e },
+    { 0x888f99797a5e012d, 0x6d8406c952429603 }, { 0xaab37fd7d8f58178, 0xc8e5087ba6d33b83 },
+    { 0xd5605fcdcf32e1d6, 0xfb1e4a9a90880a64 }, { 0x855c3be0a17fcd26, 0x5cf2eea09a55067f },
+    { 0xa6b34ad8c9dfc06f, 0xf42faa48c0ea481e }, { 0xd0601d8efc57b08b, 0xf13b94daf124da26 },
+    { 0x823c12795db6ce57, 0x76c53d08d6b70858 }, { 0xa2cb1717b52481ed, 0x54768c4b0c64ca6e },
+    { 0xcb7ddcdda26da268, 0xa9942f5dcf7dfd09 }, { 0xfe5d54150b090b02, 0xd3f93b35435d7c4c },
+    { 0x9efa548d26e5a6e1, 0xc47bc5014a1a6daf }, { 0xc6b8e9b0709f109a, 0x359ab6419ca1091b },
+    { 0xf867241c8cc6d4c0, 0xc30163d203c94b62 }, { 0x9b407691d7fc44f8, 0x79e0de63425dcf1d },
+    { 0xc21094364dfb5636, 0x985915fc12f542e4 }, { 0xf294b943e17a2bc4, 0x3e6f5b7b17b2939d },
+    { 0x979cf3ca6cec5b5a, 0xa705992ceecf9c42 }, { 0xbd8430bd08277231, 0x50c6ff782a838353 },
+    { 0xece53cec4a314ebd, 0xa4f8bf5635246428 }, { 0x940f4613ae5ed136, 0x871b7795e136be99 },
+    { 0xb913179899f68584, 0x28e2557b59846e3f }, { 0xe757dd7ec07426e5, 0x331aeada2fe589cf },
+    { 0x9096ea6f3848984f, 0x3ff0d2c85def7621 }, { 0xb4bca50b065abe63, 0x0fed077a756b53a9 },
+    { 0xe1ebce4dc7f16dfb, 0xd3e8495912c62894 }, { 0x8d3360f09cf6e4bd, 0x64712dd7abbbd95c },
+    { 0xb080392cc4349dec, 0xbd8d794d96aacfb3 }, { 0xdca04777f541c567, 0xecf0d7a0fc5583a0 },
+    { 0x89e42caaf9491b60, 0xf41686c49db57244 }, { 0xac5d37d5b79b6239, 0x311c2875c522ced5 },
+    { 0xd77485cb25823ac7, 0x7d633293366b828b }, { 0x86a8d39ef77164bc, 0xae5dff9c02033197 },
+    { 0xa8530886b54dbdeb, 0xd9f57f830283fdfc }, { 0xd267caa862a12d66, 0xd072df63c324fd7b },
+    { 0x8380dea93da4bc60, 0x4247cb9e59f71e6d }, { 0xa46116538d0deb78, 0x52d9be85f074e608 },
+    { 0xcd795be870516656, 0x67902e276c921f8b }, { 0x806bd9714632dff6, 0x00ba1cd8a3db53b6 },
+    { 0xa086cfcd97bf97f3, 0x80e8a40eccd228a4 }, { 0xc8a883c0fdaf7df0, 0x6122cd128006b2cd },
+    { 0xfad2a4b13d1b5d6c, 0x796b805720085f81 }, { 0x9cc3a6eec6311a63, 0xcbe3303674053bb0 },
+    { 0xc3f490aa77bd60fc, 0xbedbfc4411068a9c }, { 0xf4f1b4d515acb93b, 0xee92fb5515482d44 },
+    { 0x991711052d8bf3c5, 0x751bdd152d4d1c4a }, { 0xbf5cd54678eef0b6, 0xd262d45a78a0635d },
+    { 0xef340a98172aace4, 0x86fb897116c87c34 }, { 0x9580869f0e7aac0e, 0xd45d35e6ae3d4da0 },
+    { 0xbae0a846d2195712, 0x8974836059cca109 }, { 0xe998d258869facd7, 0x2bd1a438703fc94b },
+    { 0x91ff83775423cc06, 0x7b6306a34627ddcf }, { 0xb67f6455292cbf08, 0x1a3bc84c17b1d542 },
+    { 0xe41f3d6a7377eeca, 0x20caba5f1d9e4a93 }, { 0x8e938662882af53e, 0x547eb47b7282ee9c },
+    { 0xb23867fb2a35b28d, 0xe99e619a4f23aa43 }, { 0xdec681f9f4c31f31, 0x6405fa00e2ec94d4 },
+    { 0x8b3c113c38f9f37e, 0xde83bc408dd3dd04 }, { 0xae0b158b4738705e, 0x9624ab50b148d445 },
+    { 0xd98ddaee19068c76, 0x3badd624dd9b0957 }, { 0x87f8a8d4cfa417c9, 0xe54ca5d70a80e5d6 },
+    { 0xa9f6d30a038d1dbc, 0x5e9fcf4ccd211f4c }, { 0xd47487cc8470652b, 0x7647c3200069671f },
+    { 0x84c8d4dfd2c63f3b, 0x29ecd9f40041e073 }, { 0xa5fb0a17c777cf09, 0xf468107100525890 },
+    { 0xcf79cc9db955c2cc, 0x7182148d4066eeb4 }, { 0x81ac1fe293d599bf, 0xc6f14cd848405530 },
+    { 0xa21727db38cb002f, 0xb8ada00e5a506a7c }, { 0xca9cf1d206fdc03b, 0xa6d90811f0e4851c },
+    { 0xfd442e4688bd304a, 0x908f4a166d1da663 }, { 0x9e4a9cec15763e2e, 0x9a598e4e043287fe },
+    { 0xc5dd44271ad3cdba, 0x40eff1e1853f29fd }, { 0xf7549530e188c128, 0xd12bee59e68ef47c },
+    { 0x9a94dd3e8cf578b9, 0x82bb74f8301958ce }, { 0xc13a148e3032d6e7, 0xe36a52363c1faf01 },
+    { 0xf18899b1bc3f8ca1, 0xdc44e6c3cb279ac1 }, { 0x96f5600f15a7b7e5, 0x29ab103a5ef8c0b9 },
+    { 0xbcb2b812db11a5de, 0x7415d448f6b6f0e7 }, { 0xebdf661791d60f56, 0x111b495b3464ad21 },
+    { 0x936b9fcebb25c995, 0xcab10dd900beec34 }, { 0xb84687c269ef3bfb, 0x3d5d514f40eea742 },
+    { 0xe65829b3046b0afa, 0x0cb4a5a3112a5112 }, { 0x8ff71a0fe2c2e6dc, 0x47f0e785eaba72ab },
+    { 0xb3f4e093db73a093, 0x59ed216765690f56 }, { 0xe0f218b8d25088b8, 0x306869c13ec3532c },
+    { 0x8c974f7383725573, 0x1e414218c73a13fb }, { 0xafbd2350644eeacf, 0xe5d1929ef90898fa },
+    { 0xdbac6c247d62a583, 0xdf45f746b74abf39 }, { 0x894bc396ce5da772, 0x6b8bba8c328eb783 },
+    { 0xab9eb47c81f5114f, 0x066ea92f3f326564 }, { 0xd686619ba27255a2, 0xc80a537b0efefebd },
+    { 0x8613fd0145877585, 0xbd06742ce95f5f36 }, { 0xa798fc4196e952e7, 0x2c48113823b73704 },
+    { 0xd17f3b51fca3a7a0, 0xf75a15862ca504c5 }, { 0x82ef85133de648c4, 0x9a984d73dbe722fb },
+    { 0xa3ab66580d5fdaf5, 0xc13e60d0d2e0ebba }, { 0xcc963fee10b7d1b3, 0x318df905079926a8 },
+    { 0xffbbcfe994e5c61f, 0xfdf17746497f7052 }, { 0x9fd561f1fd0f9bd3, 0xfeb6ea8bedefa633 },
+    { 0xc7caba6e7c5382c8, 0xfe64a52ee96b8fc0 }, { 0xf9bd690a1b68637b, 0x3dfdce7aa3c673b0 },
+    { 0x9c1661a651213e2d, 0x06bea10ca65c084e }, { 0xc31bfa0fe5698db8, 0x486e494fcff30a62 },
+    { 0xf3e2f893dec3f126, 0x5a89dba3c3efccfa }, { 0x986ddb5c6b3a76b7, 0xf89629465a75e01c },
+    { 0xbe89523386091465, 0xf6bbb397f1135823 }, { 0xee2ba6c0678b597f, 0x746aa07ded582e2c },
+    { 0x94db483840b717ef, 0xa8c2a44eb4571cdc }, { 0xba121a4650e4ddeb, 0x92f34d62616ce413 },
+    { 0xe896a0d7e51e1566, 0x77b020baf9c81d17 }, { 0x915e2486ef32cd60, 0x0ace1474dc1d122e },
+    { 0xb5b5ada8aaff80b8, 0x0d819992132456ba }, { 0xe3231912d5bf60e6, 0x10e1fff697ed6c69 },
+    { 0x8df5efabc5979c8f, 0xca8d3ffa1ef463c1 }, { 0xb1736b96b6fd83b3, 0xbd308ff8a6b17cb2 },
+    { 0xddd0467c64bce4a0, 0xac7cb3f6d05ddbde }, { 0x8aa22c0dbef60ee4, 0x6bcdf07a423aa96b },
+    { 0xad4ab7112eb3929d, 0x86c16c98d2c953c6 }, { 0xd89d64d57a607744, 0xe871c7bf077ba8b7 },
+    { 0x87625f056c7c4a8b, 0x11471cd764ad4972 }, { 0xa93af6c6c79b5d2d, 0xd598e40d3dd89bcf },
+    { 0xd389b47879823479, 0x4aff1d108d4ec2c3 }, { 0x843610cb4bf160cb, 0xcedf722a585139ba },
+    { 0xa54394fe1eedb8fe, 0xc2974eb4ee658828 }, { 0xce947a3da6a9273e, 0x733d226229feea32 },
+    { 0x811ccc668829b887, 0x0806357d5a3f525f }, { 0xa163ff802a3426a8, 0xca07c2dcb0cf26f7 },
+    { 0xc9bcff6034c13052, 0xfc89b393dd02f0b5 }, { 0xfc2c3f3841f17c67, 0xbbac2078d443ace2 },
+    { 0x9d9ba7832936edc0, 0xd54b944b84aa4c0d }, { 0xc5029163f384a931, 0x0a9e795e65d4df11 },
+    { 0xf64335bcf065d37d, 0x4d4617b5ff4a16d5 }, { 0x99ea0196163fa42e, 0x504bced1bf8e4e45 },
+    { 0xc06481fb9bcf8d39, 0xe45ec2862f71e1d6 }, { 0xf07da27a82c37088, 0x5d767327bb4e5a4c },
+    { 0x964e858c91ba2655, 0x3a6a07f8d510f86f }, { 0xbbe226efb628afea, 0x890489f70a55368b },
+    { 0xeadab0aba3b2dbe5, 0x2b45ac74ccea842e }, { 0x92c8ae6b464fc96f, 0x3b0b8bc90012929d },
+    { 0xb77ada0617e3bbcb, 0x09ce6ebb40173744 }, { 0xe55990879ddcaabd, 0xcc420a6a101d0515 },
+    { 0x8f57fa54c2a9eab6, 0x9fa946824a12232d }, { 0xb32df8e9f3546564, 0x47939822dc96abf9 },
+    { 0xdff9772470297ebd, 0x59787e2b93bc56f7 }, { 0x8bfbea76c619ef36, 0x57eb4edb3c55b65a },
+    { 0xaefae51477a06b03, 0xede622920b6b23f1 }, { 0xdab99e59958885c4, 0xe95fab368e45eced },
+    { 0x88b402f7fd75539b, 0x11dbcb0218ebb414 }, { 0xaae103b5fcd2a881, 0xd652bdc29f26a119 },
+    { 0xd59944a37c0752a2, 0x4be76d3346f0495f }, { 0x857fcae62d8493a5, 0x6f70a4400c562ddb },
+    { 0xa6dfbd9fb8e5b88e, 0xcb4ccd500f6bb952 }, { 0xd097ad07a71f26b2, 0x7e2000a41346a7a7 },
+    { 0x825ecc24c873782f, 0x8ed400668c0c28c8 }, { 0xa2f67f2dfa90563b, 0x728900802f0f32fa },
+    { 0xcbb41ef979346bca, 0x4f2b40a03ad2ffb9 }, { 0xfea126b7d78186bc, 0xe2f610c84987bfa8 },
+    { 0x9f24b832e6b0f436, 0x0dd9ca7d2df4d7c9 }, { 0xc6ede63fa05d3143, 0x91503d1c79720dbb },
+    { 0xf8a95fcf88747d94, 0x75a44c6397ce912a }, { 0x9b69dbe1b548ce7c, 0xc986afbe3ee11aba },
+    { 0xc24452da229b021b, 0xfbe85badce996168 }, { 0xf2d56790ab41c2a2, 0xfae27299423fb9c3 },
+    { 0x97c560ba6b0919a5, 0xdccd879fc967d41a }, { 0xbdb6b8e905cb600f, 0x5400e987bbc1c920 },
+    { 0xed246723473e3813, 0x290123e9aab23b68 }, { 0x9436c0760c86e30b, 0xf9a0b6720aaf6521 },
+    { 0xb94470938fa89bce, 0xf808e40e8d5b3e69 }, { 0xe7958cb87392c2c2, 0xb60b1d1230b20e04 },
+    { 0x90bd77f3483bb9b9, 0xb1c6f22b5e6f48c2 }, { 0xb4ecd5f01a4aa828, 0x1e38aeb6360b1af3 },
+    { 0xe2280b6c20dd5232, 0x25c6da63c38de1b0 }, { 0x8d590723948a535f, 0x579c487e5a38ad0e },
+    { 0xb0af48ec79ace837, 0x2d835a9df0c6d851 }, { 0xdcdb1b2798182244, 0xf8e431456cf88e65 },
+    { 0x8a08f0f8bf0f156b, 0x1b8e9ecb641b58ff }, { 0xac8b2d36eed2dac5, 0xe272467e3d222f3f },
+    { 0xd7adf884aa879177, 0x5b0ed81dcc6abb0f }, { 0x86ccbb52ea94baea, 0x98e947129fc2b4e9 },
+    { 0xa87fea27a539e9a5, 0x3f2398d747b36224 }, { 0xd29fe4b18e88640e, 0x8eec7f0d19a03aad },
+    { 0x83a3eeeef9153e89, 0x1953cf68300424ac }, { 0xa48ceaaab75a8e2b, 0x5fa8c3423c052dd7 },
+    { 0xcdb02555653131b6, 0x3792f412cb06794d }, { 0x808e17555f3ebf11, 0xe2bbd88bbee40bd0 },
+    { 0xa0b19d2ab70e6ed6, 0x5b6aceaeae9d0ec4 }, { 0xc8de047564d20a8b, 0xf245825a5a445275 },
+    { 0xfb158592be068d2e, 0xeed6e2f0f0d56712 }, { 0x9ced737bb6c4183d, 0x55464dd69685606b },
+    { 0xc428d05aa4751e4c, 0xaa97e14c3c26b886 }, { 0xf53304714d9265df, 0xd53dd99f4b3066a8 },
+    { 0x993fe2c6d07b7fab, 0xe546a8038efe4029 }, { 0xbf8fdb78849a5f96, 0xde98520472bdd033 },
+    { 0xef73d256a5c0f77c, 0x963e66858f6d4440 }, { 0x95a8637627989aad, 0xdde7001379a44aa8 },
+    { 0xbb127c53b17ec159, 0x5560c018580d5d52 }, { 0xe9d71b689dde71af, 0xaab8f01e6e10b4a6 },
+    { 0x9226712162ab070d, 0xcab3961304ca70e8 }, { 0xb6b00d69bb55c8d1, 0x3d607b97c5fd0d22 },
+    { 0xe45c10c42a2b3b05, 0x8cb89a7db77c506a }, { 0x8eb98a7a9a5b04e3, 0x77f3608e92adb242 },
+    { 0xb267ed1940f1c61c, 0x55f038b237591ed3 }, { 0xdf01e85f912e37a3, 0x6b6c46dec52f6688 },
+    { 0x8b61313bbabce2c6, 0x2323ac4b3b3da015 }, { 0xae397d8aa96c1b77, 0xabec975e0a0d081a },
+    { 0xd9c7dced53c72255, 0x96e7bd358c904a21 }, { 0x881cea14545c7575, 0x7e50d64177da2e54 },
+    { 0xaa242499697392d2, 0xdde50bd1d5d0b9e9 }, { 0xd4ad2dbfc3d07787, 0x955e4ec64b44e864 },
+    { 0x84ec3c97da624ab4, 0xbd5af13bef0b113e }, { 0xa6274bbdd0fadd61, 0xecb1ad8aeacdd58e },
+    { 0xcfb11ead453994ba, 0x67de18eda5814af2 }, { 0x81ceb32c4b43fcf4, 0x80eacf948770ced7 },
+    { 0xa2425ff75e14fc31, 0xa1258379a94d028d }, { 0xcad2f7f5359a3b3e, 0x096ee45813a04330 },
+    { 0xfd87b5f28300ca0d, 0x8bca9d6e188853fc }, { 0x9e74d1b791e07e48, 0x775ea264cf55347e },
+    { 0xc612062576589dda, 0x95364afe032a819e }, { 0xf79687aed3eec551, 0x3a83ddbd83f52205 },
+    { 0x9abe14cd44753b52, 0xc4926a9672793543 }, { 0xc16d9a0095928a27, 0x75b7053c0f178294 },
+    { 0xf1c90080baf72cb1, 0x5324c68b12dd6339 }, { 0x971da05074da7bee, 0xd3f6fc16ebca5e04 },
+    { 0xbce5086492111aea, 0x88f4bb1ca6bcf585 }, { 0xec1e4a7db69561a5, 0x2b31e9e3d06c32e6 },
+    { 0x9392ee8e921d5d07, 0x3aff322e62439fd0 }, { 0xb877aa3236a4b449, 0x09befeb9fad487c3 },
+    { 0xe69594bec44de15b, 0x4c2ebe687989a9b4 }, { 0x901d7cf73ab0acd9, 0x0f9d37014bf60a11 },
+    { 0xb424dc35095cd80f, 0x538484c19ef38c95 }, { 0xe12e13424bb40e13, 0x2865a5f206b06fba },
+    { 0x8cbccc096f5088cb, 0xf93f87b7442e45d4 }, { 0xafebff0bcb24aafe, 0xf78f69a51539d749 },
+    { 0xdbe6fecebdedd5be, 0xb573440e5a884d1c }, { 0x89705f4136b4a597, 0x31680a88f8953031 },
+    { 0xabcc77118461cefc, 0xfdc20d2b36ba7c3e }, { 0xd6bf94d5e57a42bc, 0x3d32907604691b4d },
+    { 0x8637bd05af6c69b5, 0xa63f9a49c2c1b110 }, { 0xa7c5ac471b478423, 0x0fcf80dc33721d54 },
+    { 0xd1b71758e219652b, 0xd3c36113404ea4a9 }, { 0x83126e978d4fdf3b, 0x645a1cac083126ea },
+    { 0xa3d70a3d70a3d70a, 0x3d70a3d70a3d70a4 }, { 0xcccccccccccccccc, 0xcccccccccccccccd },
+    { 0x8000000000000000, 0x0000000000000000 }, { 0xa000000000000000, 0x0000000000000000 },
+    { 0xc800000000000000, 0x0000000000000000 }, { 0xfa00000000000000, 0x0000000000000000 },
+    { 0x9c40000000000000, 0x0000000000000000 }, { 0xc350000000000000, 0x0000000000000000 },
+    { 0xf424000000000000, 0x0000000000000000 }, { 0x9896800000000000, 0x0000000000000000 },
+    { 0xbebc200000000000, 0x0000000000000000 }, { 0xee6b280000000000, 0x0000000000000000 },
+    { 0x9502f90000000000, 0x0000000000000000 }, { 0xba43b74000000000, 0x0000000000000000 },
+    { 0xe8d4a51000000000, 0x0000000000000000 }, { 0x9184e72a00000000, 0x0000000000000000 },
+    { 0xb5e620f480000000, 0x0000000000000000 }, { 0xe35fa931a0000000, 0x0000000000000000 },
+    { 0x8e1bc9bf04000000, 0x0000000000000000 }, { 0xb1a2bc2ec5000000, 0x0000000000000000 },
+    { 0xde0b6b3a76400000, 0x0000000000000000 }, { 0x8ac7230489e80000, 0x0000000000000000 },
+    { 0xad78ebc5ac620000, 0x0000000000000000 }, { 0xd8d726b7177a8000, 0x0000000000000000 },
+    { 0x878678326eac9000, 0x0000000000000000 }, { 0xa968163f0a57b400, 0x0000000000000000 },
+    { 0xd3c21bcecceda100, 0x0000000000000000 }, { 0x84595161401484a0, 0x0000000000000000 },
+    { 0xa56fa5b99019a5c8, 0x0000000000000000 }, { 0xcecb8f27f4200f3a, 0x0000000000000000 },
+    { 0x813f3978f8940984, 0x4000000000000000 }, { 0xa18f07d736b90be5, 0x5000000000000000 },
+    { 0xc9f2c9cd04674ede, 0xa400000000000000 }, { 0xfc6f7c4045812296, 0x4d00000000000000 },
+    { 0x9dc5ada82b70b59d, 0xf020000000000000 }, { 0xc5371912364ce305, 0x6c28000000000000 },
+    { 0xf684df56c3e01bc6, 0xc732000000000000 }, { 0x9a130b963a6c115c, 0x3c7f400000000000 },
+    { 0xc097ce7bc90715b3, 0x4b9f100000000000 }, { 0xf0bdc21abb48db20, 0x1e86d40000000000 },
+    { 0x96769950b50d88f4, 0x1314448000000000 }, { 0xbc143fa4e250eb31, 0x17d955a000000000 },
+    { 0xeb194f8e1ae525fd, 0x5dcfab0800000000 }, { 0x92efd1b8d0cf37be, 0x5aa1cae500000000 },
+    { 0xb7abc627050305ad, 0xf14a3d9e40000000 }, { 0xe596b7b0c643c719, 0x6d9ccd05d0000000 },
+    { 0x8f7e32ce7bea5c6f, 0xe4820023a2000000 }, { 0xb35dbf821ae4f38b, 0xdda2802c8a800000 },
+    { 0xe0352f62a19e306e, 0xd50b2037ad200000 }, { 0x8c213d9da502de45, 0x4526f422cc340000 },
+    { 0xaf298d050e4395d6, 0x9670b12b7f410000 }, { 0xdaf3f04651d47b4c, 0x3c0cdd765f114000 },
+    { 0x88d8762bf324cd0f, 0xa5880a69fb6ac800 }, { 0xab0e93b6efee0053, 0x8eea0d047a457a00 },
+    { 0xd5d238a4abe98068, 0x72a4904598d6d880 }, { 0x85a36366eb71f041, 0x47a6da2b7f864750 },
+    { 0xa70c3c40a64e6c51, 0x999090b65f67d924 }, { 0xd0cf4b50cfe20765, 0xfff4b4e3f741cf6d },
+    { 0x82818f1281ed449f, 0xbff8f10e7a8921a4 }, { 0xa321f2d7226895c7, 0xaff72d52192b6a0d },
+    { 0xcbea6f8ceb02bb39, 0x9bf4f8a69f764490 }, { 0xfee50b7025c36a08, 0x02f236d04753d5b4 },
+    { 0x9f4f2726179a2245, 0x01d762422c946590 }, { 0xc722f0ef9d80aad6, 0x424d3ad2b7b97ef5 },
+    { 0xf8ebad2b84e0d58b, 0xd2e0898765a7deb2 }, { 0x9b934c3b330c8577, 0x63cc55f49f88eb2f },
+    { 0xc2781f49ffcfa6d5, 0x3cbf6b71c76b25fb }, { 0xf316271c7fc3908a, 0x8bef464e3945ef7a },
+    { 0x97edd871cfda3a56, 0x97758bf0e3cbb5ac }, { 0xbde94e8e43d0c8ec, 0x3d52eeed1cbea317 },
+    { 0xed63a231d4c4fb27, 0x4ca7aaa863ee4bdd }, { 0x945e455f24fb1cf8, 0x8fe8caa93e74ef6a },
+    { 0xb975d6b6ee39e436, 0xb3e2fd538e122b44 }, { 0xe7d34c64a9c85d44, 0x60dbbca87196b616 },
+    { 0x90e40fbeea1d3a4a, 0xbc8955e946fe31cd }, { 0xb51d13aea4a488dd, 0x6babab6398bdbe41 },
+    { 0xe264589a4dcdab14, 0xc696963c7eed2dd1 }, { 0x8d7eb76070a08aec, 0xfc1e1de5cf543ca2 },
+    { 0xb0de65388cc8ada8, 0x3b25a55f43294bcb }, { 0xdd15fe86affad912, 0x49ef0eb713f39ebe },
+    { 0x8a2dbf142dfcc7ab, 0x6e3569326c784337 }, { 0xacb92ed9397bf996, 0x49c2c37f07965404 },
+    { 0xd7e77a8f87daf7fb, 0xdc33745ec97be906 }, { 0x86f0ac99b4e8dafd, 0x69a028bb3ded71a3 },
+    { 0xa8acd7c0222311bc, 0xc40832ea0d68ce0c }, { 0xd2d80db02aabd62b, 0xf50a3fa490c30190 },
+    { 0x83c7088e1aab65db, 0x792667c6da79e0fa }, { 0xa4b8cab1a1563f52, 0x577001b891185938 },
+    { 0xcde6fd5e09abcf26, 0xed4c0226b55e6f86 }, { 0x80b05e5ac60b6178, 0x544f8158315b05b4 },
+    { 0xa0dc75f1778e39d6, 0x696361ae3db1c721 }, { 0xc913936dd571c84c, 0x03bc3a19cd1e38e9 },
+    { 0xfb5878494ace3a5f, 0x04ab48a04065c723 }, { 0x9d174b2dcec0e47b, 0x62eb0d64283f9c76 },
+    { 0xc45d1df942711d9a, 0x3ba5d0bd324f8394 }, { 0xf5746577930d6500, 0xca8f44ec7ee36479 },
+    { 0x9968bf6abbe85f20, 0x7e998b13cf4e1ecb }, { 0xbfc2ef456ae276e8, 0x9e3fedd8c321a67e },
+    { 0xefb3ab16c59b14a2, 0xc5cfe94ef3ea101e }, { 0x95d04aee3b80ece5, 0xbba1f1d158724a12 },
+    { 0xbb445da9ca61281f, 0x2a8a6e45ae8edc97 }, { 0xea1575143cf97226, 0xf52d09d71a3293bd },
+    { 0x924d692ca61be758, 0x593c2626705f9c56 }, { 0xb6e0c377cfa2e12e, 0x6f8b2fb00c77836c },
+    { 0xe498f455c38b997a, 0x0b6dfb9c0f956447 }, { 0x8edf98b59a373fec, 0x4724bd4189bd5eac },
+    { 0xb2977ee300c50fe7, 0x58edec91ec2cb657 }, { 0xdf3d5e9bc0f653e1, 0x2f2967b66737e3ed },
+    { 0x8b865b215899f46c, 0xbd79e0d20082ee74 }, { 0xae67f1e9aec07187, 0xecd8590680a3aa11 },
+    { 0xda01ee641a708de9, 0xe80e6f4820cc9495 }, { 0x884134fe908658b2, 0x3109058d147fdcdd },
+    { 0xaa51823e34a7eede, 0xbd4b46f0599fd415 }, { 0xd4e5e2cdc1d1ea96, 0x6c9e18ac7007c91a },
+    { 0x850fadc09923329e, 0x03e2cf6bc604ddb0 }, { 0xa6539930bf6bff45, 0x84db8346b786151c },
+    { 0xcfe87f7cef46ff16, 0xe612641865679a63 }, { 0x81f14fae158c5f6e, 0x4fcb7e8f3f60c07e },
+    { 0xa26da3999aef7749, 0xe3be5e330f38f09d }, { 0xcb090c8001ab551c, 0x5cadf5bfd3072cc5 },
+    { 0xfdcb4fa002162a63, 0x73d9732fc7c8f7f6 }, { 0x9e9f11c4014dda7e, 0x2867e7fddcdd9afa },
+    { 0xc646d63501a1511d, 0xb281e1fd541501b8 }, { 0xf7d88bc24209a565, 0x1f225a7ca91a4226 },
+    { 0x9ae757596946075f, 0x3375788de9b06958 }, { 0xc1a12d2fc3978937, 0x0052d6b1641c83ae },
+    { 0xf209787bb47d6b84, 0xc0678c5dbd23a49a }, { 0x9745eb4d50ce6332, 0xf840b7ba963646e0 },
+    { 0xbd176620a501fbff, 0xb650e5a93bc3d898 }, { 0xec5d3fa8ce427aff, 0xa3e51f138ab4cebe },
+    { 0x93ba47c980e98cdf, 0xc66f336c36b10137 }, { 0xb8a8d9bbe123f017, 0xb80b0047445d4184 },
+    { 0xe6d3102ad96cec1d, 0xa60dc059157491e5 }, { 0x9043ea1ac7e41392, 0x87c89837ad68db2f },
+    { 0xb454e4a179dd1877, 0x29babe4598c311fb }, { 0xe16a1dc9d8545e94, 0xf4296dd6fef3d67a },
+    { 0x8ce2529e2734bb1d, 0x1899e4a65f58660c }, { 0xb01ae745b101e9e4, 0x5ec05dcff72e7f8f },
+    { 0xdc21a1171d42645d, 0x76707543f4fa1f73 }, { 0x899504ae72497eba, 0x6a06494a791c53a8 },
+    { 0xabfa45da0edbde69, 0x0487db9d17636892 }, { 0xd6f8d7509292d603, 0x45a9d2845d3c42b6 },
+    { 0x865b86925b9bc5c2, 0x0b8a2392ba45a9b2 }, { 0xa7f26836f282b732, 0x8e6cac7768d7141e },
+    { 0xd1ef0244af2364ff, 0x3207d795430cd926 }, { 0x8335616aed761f1f, 0x7f44e6bd49e807b8 },
+    { 0xa402b9c5a8d3a6e7, 0x5f16206c9c6209a6 }, { 0xcd036837130890a1, 0x36dba887c37a8c0f },
+    { 0x802221226be55a64, 0xc2494954da2c9789 }, { 0xa02aa96b06deb0fd, 0xf2db9baa10b7bd6c },
+    { 0xc83553c5c8965d3d, 0x6f92829494e5acc7 }, { 0xfa42a8b73abbf48c, 0xcb772339ba1f17f9 },
+    { 0x9c69a97284b578d7, 0xff2a760414536efb }, { 0xc38413cf25e2d70d, 0xfef5138519684aba },
+    { 0xf46518c2ef5b8cd1, 0x7eb258665fc25d69 }, { 0x98bf2f79d5993802, 0xef2f773ffbd97a61 },
+    { 0xbeeefb584aff8603, 0xaafb550ffacfd8fa }, { 0xeeaaba2e5dbf6784, 0x95ba2a53f983cf38 },
+    { 0x952ab45cfa97a0b2, 0xdd945a747bf26183 }, { 0xba756174393d88df, 0x94f971119aeef9e4 },
+    { 0xe912b9d1478ceb17, 0x7a37cd5601aab85d }, { 0x91abb422ccb812ee, 0xac62e055c10ab33a },
+    { 0xb616a12b7fe617aa, 0x577b986b314d6009 }, { 0xe39c49765fdf9d94, 0xed5a7e85fda0b80b },
+    { 0x8e41ade9fbebc27d, 0x14588f13be847307 }, { 0xb1d219647ae6b31c, 0x596eb2d8ae258fc8 },
+    { 0xde469fbd99a05fe3, 0x6fca5f8ed9aef3bb }, { 0x8aec23d680043bee, 0x25de7bb9480d5854 },
+    { 0xada72ccc20054ae9, 0xaf561aa79a10ae6a }, { 0xd910f7ff28069da4, 0x1b2ba1518094da04 },
+    { 0x87aa9aff79042286, 0x90fb44d2f05d0842 }, { 0xa99541bf57452b28, 0x353a1607ac744a53 },
+    { 0xd3fa922f2d1675f2, 0x42889b8997915ce8 }, { 0x847c9b5d7c2e09b7, 0x69956135febada11 },
+    { 0xa59bc234db398c25, 0x43fab9837e699095 }, { 0xcf02b2c21207ef2e, 0x94f967e45e03f4bb },
+    { 0x8161afb94b44f57d, 0x1d1be0eebac278f5 }, { 0xa1ba1ba79e1632dc, 0x6462d92a69731732 },
+    { 0xca28a291859bbf93, 0x7d7b8f7503cfdcfe }, { 0xfcb2cb35e702af78, 0x5cda735244c3d43e },
+    { 0x9defbf01b061adab, 0x3a0888136afa64a7 }, { 0xc56baec21c7a1916, 0x088aaa1845b8fdd0 },
+    { 0xf6c69a72a3989f5b, 0x8aad549e57273d45 }, { 0x9a3c2087a63f6399, 0x36ac54e2f678864b },
+    { 0xc0cb28a98fcf3c7f, 0x84576a1bb416a7dd }, { 0xf0fdf2d3f3c30b9f, 0x656d44a2a11c51d5 },
+    { 0x969eb7c47859e743, 0x9f644ae5a4b1b325 }, { 0xbc4665b596706114, 0x873d5d9f0dde1fee },
+    { 0xeb57ff22fc0c7959, 0xa90cb506d155a7ea }, { 0x9316ff75dd87cbd8, 0x09a7f12442d588f2 },
+    { 0xb7dcbf5354e9bece, 0x0c11ed6d538aeb2f }, { 0xe5d3ef282a242e81, 0x8f1668c8a86da5fa },
+    { 0x8fa475791a569d10, 0xf96e017d694487bc }, { 0xb38d92d760ec4455, 0x37c981dcc395a9ac },
+    { 0xe070f78d3927556a, 0x85bbe253f47b1417 }, { 0x8c469ab843b89562, 0x93956d7478ccec8e },
+    { 0xaf58416654a6babb, 0x387ac8d1970027b2 }, { 0xdb2e51bfe9d0696a, 0x06997b05fcc0319e },
+    { 0x88fcf317f22241e2, 0x441fece3bdf81f03 }, { 0xab3c2fddeeaad25a, 0xd527e81cad7626c3 },
+    { 0xd60b3bd56a5586f1, 0x8a71e223d8d3b074 }, { 0x85c7056562757456, 0xf6872d5667844e49 },
+    { 0xa738c6bebb12d16c, 0xb428f8ac016561db }, { 0xd106f86e69d785c7, 0xe13336d701beba52 },
+    { 0x82a45b450226b39c, 0xecc0024661173473 }, { 0xa34d721642b06084, 0x27f002d7f95d0190 },
+    { 0xcc20ce9bd35c78a5, 0x31ec038df7b441f4 }, { 0xff290242c83396ce, 0x7e67047175a15271 },
+    { 0x9f79a169bd203e41, 0x0f0062c6e984d386 }, { 0xc75809c42c684dd1, 0x52c07b78a3e60868 },
+    { 0xf92e0c3537826145, 0xa7709a56ccdf8a82 }, { 0x9bbcc7a142b17ccb, 0x88a66076400bb691 },
+    { 0xc2abf989935ddbfe, 0x6acff893d00ea435 }, { 0xf356f7ebf83552fe, 0x0583f6b8c4124d43 },
+    { 0x98165af37b2153de, 0xc3727a337a8b704a }, { 0xbe1bf1b059e9a8d6, 0x744f18c0592e4c5c },
+    { 0xeda2ee1c7064130c, 0x1162def06f79df73 }, { 0x9485d4d1c63e8be7, 0x8addcb5645ac2ba8 },
+    { 0xb9a74a0637ce2ee1, 0x6d953e2bd7173692 }, { 0xe8111c87c5c1ba99, 0xc8fa8db6ccdd0437 },
+    { 0x910ab1d4db9914a0, 0x1d9c9892400a22a2 }, { 0xb54d5e4a127f59c8, 0x2503beb6d00cab4b },
+    { 0xe2a0b5dc971f303a, 0x2e44ae64840fd61d }, { 0x8da471a9de737e24, 0x5ceaecfed289e5d2 },
+    { 0xb10d8e1456105dad, 0x7425a83e872c5f47 }, { 0xdd50f1996b947518, 0xd12f124e28f77719 },
+    { 0x8a5296ffe33cc92f, 0x82bd6b70d99aaa6f }, { 0xace73cbfdc0bfb7b, 0x636cc64d1001550b },
+    { 0xd8210befd30efa5a, 0x3c47f7e05401aa4e }, { 0x8714a775e3e95c78, 0x65acfaec34810a71 },
+    { 0xa8d9d1535ce3b396, 0x7f1839a741a14d0d }, { 0xd31045a8341ca07c, 0x1ede48111209a050 },
+    { 0x83ea2b892091e44d, 0x934aed0aab460432 }, { 0xa4e4b66b68b65d60, 0xf81da84d5617853f },
+    { 0xce1de40642e3f4b9, 0x36251260ab9d668e }, { 0x80d2ae83e9ce78f3, 0xc1d72b7c6b426019 },
+    { 0xa1075a24e4421730, 0xb24cf65b8612f81f }, { 0xc94930ae1d529cfc, 0xdee033f26797b627 },
+    { 0xfb9b7cd9a4a7443c, 0x169840ef017da3b1 }, { 0x9d412e0806e88aa5, 0x8e1f289560ee864e },
+    { 0xc491798a08a2ad4e, 0xf1a6f2bab92a27e2 }, { 0xf5b5d7ec8acb58a2, 0xae10af696774b1db },
+    { 0x9991a6f3d6bf1765, 0xacca6da1e0a8ef29 }, { 0xbff610b0cc6edd3f, 0x17fd090a58d32af3 },
+    { 0xeff394dcff8a948e, 0xddfc4b4cef07f5b0 }, { 0x95f83d0a1fb69cd9, 0x4abdaf101564f98e },
+    { 0xbb764c4ca7a4440f, 0x9d6d1ad41abe37f1 }, { 0xea53df5fd18d5513, 0x84c86189216dc5ed },
+    { 0x92746b9be2f8552c, 0x32fd3cf5b4e49bb4 }, { 0xb7118682dbb66a77, 0x3fbc8c33221dc2a1 },
+    { 0xe4d5e82392a40515, 0x0fabaf3feaa5334a }, { 0x8f05b1163ba6832d, 0x29cb4d87f2a7400e },
+    { 0xb2c71d5bca9023f8, 0x743e20e9ef511012 }, { 0xdf78e4b2bd342cf6, 0x914da9246b255416 },
+    { 0x8bab8eefb6409c1a, 0x1ad089b6c2f7548e }, { 0xae9672aba3d0c320, 0xa184ac2473b529b1 },
+    { 0xda3c0f568cc4f3e8, 0xc9e5d72d90a2741e }, { 0x8865899617fb1871, 0x7e2fa67c7a658892 },
+    { 0xaa7eebfb9df9de8d, 0xddbb901b98feeab7 }, { 0xd51ea6fa85785631, 0x552a74227f3ea565 },
+    { 0x8533285c936b35de, 0xd53a88958f87275f }, { 0xa67ff273b8460356, 0x8a892abaf368f137 },
+    { 0xd01fef10a657842c, 0x2d2b7569b0432d85 }, { 0x8213f56a67f6b29b, 0x9c3b29620e29fc73 },
+    { 0xa298f2c501f45f42, 0x8349f3ba91b47b8f }, { 0xcb3f2f7642717713, 0x241c70a936219a73 },
+    { 0xfe0efb53d30dd4d7, 0xed238cd383aa0110 }, { 0x9ec95d1463e8a506, 0xf4363804324a40aa },
+    { 0xc67bb4597ce2ce48, 0xb143c6053edcd0d5 }, { 0xf81aa16fdc1b81da, 0xdd94b7868e94050a },
+    { 0x9b10a4e5e9913128, 0xca7cf2b4191c8326 }, { 0xc1d4ce1f63f57d72, 0xfd1c2f611f63a3f0 },
+    { 0xf24a01a73cf2dccf, 0xbc633b39673c8cec }, { 0x976e41088617ca01, 0xd5be0503e085d813 },
+    { 0xbd49d14aa79dbc82, 0x4b2d8644d8a74e18 }, { 0xec9c459d51852ba2, 0xddf8e7d60ed1219e },
+    { 0x93e1ab8252f33b45, 0xcabb90e5c942b503 }, { 0xb8da1662e7b00a17, 0x3d6a751f3b936243 },
+    { 0xe7109bfba19c0c9d, 0x0cc512670a783ad4 }, { 0x906a617d450187e2, 0x27fb2b80668b24c5 },
+    { 0xb484f9dc9641e9da, 0xb1f9f660802dedf6 }, { 0xe1a63853bbd26451, 0x5e7873f8a0396973 },
+    { 0x8d07e33455637eb2, 0xdb0b487b6423e1e8 }, { 0xb049dc016abc5e5f, 0x91ce1a9a3d2cda62 },
+    { 0xdc5c5301c56b75f7, 0x7641a140cc7810fb }, { 0x89b9b3e11b6329ba, 0xa9e904c87fcb0a9d },
+    { 0xac2820d9623bf429, 0x546345fa9fbdcd44 }, { 0xd732290fbacaf133, 0xa97c177947ad4095 },
+    { 0x867f59a9d4bed6c0, 0x49ed8eabcccc485d }, { 0xa81f301449ee8c70, 0x5c68f256bfff5a74 },
+    { 0xd226fc195c6a2f8c, 0x73832eec6fff3111 }, { 0x83585d8fd9c25db7, 0xc831fd53c5ff7eab },
+    { 0xa42e74f3d032f525, 0xba3e7ca8b77f5e55 }, { 0xcd3a1230c43fb26f, 0x28ce1bd2e55f35eb },
+    { 0x80444b5e7aa7cf85, 0x7980d163cf5b81b3 }, { 0xa0555e361951c366, 0xd7e105bcc332621f },
+    { 0xc86ab5c39fa63440, 0x8dd9472bf3fefaa7 }, { 0xfa856334878fc150, 0xb14f98f6f0feb951 },
+    { 0x9c935e00d4b9d8d2, 0x6ed1bf9a569f33d3 }, { 0xc3b8358109e84f07, 0x0a862f80ec4700c8 },
+    { 0xf4a642e14c6262c8, 0xcd27bb612758c0fa }, { 0x98e7e9cccfbd7dbd, 0x8038d51cb897789c },
+    { 0xbf21e44003acdd2c, 0xe0470a63e6bd56c3 }, { 0xeeea5d5004981478, 0x1858ccfce06cac74 },
+    { 0x95527a5202df0ccb, 0x0f37801e0c43ebc8 }, { 0xbaa718e68396cffd, 0xd30560258f54e6ba },
+    { 0xe950df20247c83fd, 0x47c6b82ef32a2069 }, { 0x91d28b7416cdd27e, 0x4cdc331d57fa5441 },
+    { 0xb6472e511c81471d, 0xe0133fe4adf8e952 }, { 0xe3d8f9e563a198e5, 0x58180fddd97723a6 },
+    { 0x8e679c2f5e44ff8f, 0x570f09eaa7ea7648 }, { 0xb201833b35d63f73, 0x2cd2cc6551e513da },
+    { 0xde81e40a034bcf4f, 0xf8077f7ea65e58d1 }, { 0x8b112e86420f6191, 0xfb04afaf27faf782 },
+    { 0xadd57a27d29339f6, 0x79c5db9af1f9b563 }, { 0xd94ad8b1c7380874, 0x18375281ae7822bc },
+    { 0x87cec76f1c830548, 0x8f2293910d0b15b5 }, { 0xa9c2794ae3a3c69a, 0xb2eb3875504ddb22 },
+    { 0xd433179d9c8cb841, 0x5fa60692a46151eb }, { 0x849feec281d7f328, 0xdbc7c41ba6bcd333 },
+    { 0xa5c7ea73224deff3, 0x12b9b522906c0800 }, { 0xcf39e50feae16bef, 0xd768226b34870a00 },
+    { 0x81842f29f2cce375, 0xe6a1158300d46640 }, { 0xa1e53af46f801c53, 0x60495ae3c1097fd0 },
+    { 0xca5e89b18b602368, 0x385bb19cb14bdfc4 }, { 0xfcf62c1dee382c42, 0x46729e03dd9ed7b5 },
+    { 0x9e19db92b4e31ba9, 0x6c07a2c26a8346d1 }, { 0xc5a05277621be293, 0xc7098b7305241885 },
+    { 0xf70867153aa2db38, 0xb8cbee4fc66d1ea7 }, { 0x9a65406d44a5c903, 0x737f74f1dc043328 },
+    { 0xc0fe908895cf3b44, 0x505f522e53053ff2 }, { 0xf13e34aabb430a15, 0x647726b9e7c68fef },
+    { 0x96c6e0eab509e64d, 0x5eca783430dc19f5 }, { 0xbc789925624c5fe0, 0xb67d16413d132072 },
+    { 0xeb96bf6ebadf77d8, 0xe41c5bd18c57e88f }, { 0x933e37a534cbaae7, 0x8e91b962f7b6f159 },
+    { 0xb80dc58e81fe95a1, 0x723627bbb5a4adb0 }, { 0xe61136f2227e3b09, 0xcec3b1aaa30dd91c },
+    { 0x8fcac257558ee4e6, 0x213a4f0aa5e8a7b1 }, { 0xb3bd72ed2af29e1f, 0xa988e2cd4f62d19d },
+    { 0xe0accfa875af45a7, 0x93eb1b80a33b8605 }, { 0x8c6c01c9498d8b88, 0xbc72f130660533c3 },
+    { 0xaf87023b9bf0ee6a, 0xeb8fad7c7f8680b4 }, { 0xdb68c2ca82ed2a05, 0xa67398db9f6820e1 },
+    { 0x892179be91d43a43, 0x88083f8943a1148c }, { 0xab69d82e364948d4, 0x6a0a4f6b948959b0 },
+    { 0xd6444e39c3db9b09, 0x848ce34679abb01c }, { 0x85eab0e41a6940e5, 0xf2d80e0c0c0b4e11 },
+    { 0xa7655d1d2103911f, 0x6f8e118f0f0e2195 }, { 0xd13eb46469447567, 0x4b7195f2d2d1a9fb },
+    { 0x82c730bec1cac960, 0x8f26fdb7c3c30a3d },
+};
+
+static const double num_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* w * 10^q correctly rounded, w != 0; 0 when the product cannot tell
+ * which way to round */
+static int num_eisel_lemire(uint64_t w, long q, double *out) {
+    if (q < NUM_POW5_MIN) { *out = 0; return 1; }
+    if (q > 308) { *out = HUGE_VAL; return 1; }
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+    const uint64_t *p5 = num_pow5[q - NUM_POW5_MIN];
+    unsigned __int128 prod = (unsigned __int128)w * p5[0];
+    uint64_t hi = (uint64_t)(prod >> 64), lo = (uint64_t)prod;
+    if ((hi & 0x1FF) == 0x1FF) {
+        uint64_t carry = (uint64_t)(((unsigned __int128)w * p5[1]) >> 64);
+        lo += carry;
+        if (carry > lo) hi++;
+    }
+    if (lo == UINT64_MAX && (q < -27 || q > 55)) return 0;
+    int upper = (int)(hi >> 63), shift = upper + 9;
+    uint64_t m = hi >> shift;
+    long e2 = ((217706 * q) >> 16) + 63 + upper - lz + 1023;
+    if (e2 <= 0) {                           /* subnormal */
+        if (-e2 + 1 >= 64) { *out = 0; return 1; }
+        m >>= -e2 + 1;
+        m += m & 1;
+        m >>= 1;
+        e2 = m < (1ULL << 52) ? 0 : 1;
+    } else {
+        /* exactly halfway: round to even instead of up */
+        if (lo <= 1 && q >= -4 && q <= 23 && (m & 3) == 1 && m << shift == hi) m &= ~1ULL;
+        m += m & 1;
+        m >>= 1;
+        if (m >= (2ULL << 52)) { m = 1ULL << 52; e2++; }
+        m &= ~(1ULL << 52);
+        if (e2 >= 0x7FF) { *out = HUGE_VAL; return 1; }
+    }
+    uint64_t bits = m | (uint64_t)e2 << 52;
+    memcpy(out, &bits, sizeof(bits));
+    return 1;
+}
+
+/* strtod() replacement for decimal text: optional sign, digits, optional
+ * fraction and exponent. *end is set past the number. */
+double num_parse(const char *s, char **end) {
+    const char *p = s;
+    int neg = *p == '-';
+    if (*p == '-' || *p == '+') p++;
+    if (!(isdigit((unsigned char)*p) || (*p == '.' && isdigit((unsigned char)p[1]))) ||
+        (p[0] == '0' && (p[1] | 0x20) == 'x'))
+        return strtod(s, end);
+
+    uint64_t w = 0;
+    long q = 0;
+    int digits = 0, truncated = 0;
+    while (*p == '0') p++;
+    for (; isdigit((unsigned char)*p); p++) {
+        if (digits < 19) { w = w * 10 + (*p - '0'); digits++; }
+        else { q++; truncated |= *p != '0'; }
+    }
+    if (*p == '.') {
+        p++;
+        if (digits == 0) while (*p == '0') { p++; q--; }
+        for (; isdigit((unsigned char)*p); p++) {
+            if (digits < 19) { w = w * 10 + (*p - '0'); digits++; q--; }
+            else truncated |= *p != '0';
+        }
+    }
+    if ((*p | 0x20) == 'e') {
+        const char *e = p + 1;
+        int eneg = *e == '-';
+        if (*e == '-' || *e == '+') e++;
+        if (isdigit((unsigned char)*e)) {
+            long x = 0;
+            for (; isdigit((unsigned char)*e); e++) if (x < 100000) x = x * 10 + (*e - '0');
+            q += eneg ? -x : x;
+            p = e;
+        }
+    }
+    if (end) *end = (char *)p;
+
+    double v;
+    if (w == 0) v = 0;
+    else if (!truncated && q >= -22 && q <= 22 && w <= 1ULL << 53)
+        v = q < 0 ? (double)w / num_pow10[-q] : (double)w * num_pow10[q];
+    else {
+        double up;
+        int ok = num_eisel_lemire(w, q, &v);
+        /* dropped digits: the true value lies in [w, w+1) * 10^q */
+        if (ok && truncated) ok = num_eisel_lemire(w + 1, q, &up) && up == v;
+        if (!ok) return strtod(s, end);
+    }
+    return neg ? -v : v;
+}
+
+typedef struct { uint64_t f; int e; } num_fp;    /* f * 2^e */
+
+static num_fp num_fp_mul(num_fp x, num_fp y) {
+    unsigned __int128 p = (unsigned __int128)x.f * y.f;
+    return (num_fp){ (uint64_t)(p >> 64) + ((uint64_t)p >> 63), x.e + y.e + 64 };
+}
+
+static num_fp num_fp_norm(num_fp x) {
+    int s = __builtin_clzll(x.f);
+    return (num_fp){ x.f << s, x.e - s };
+}
+
+/* Moves the last digit down while that stays inside the interval and gets
+ * closer to the exact value */
+static void num_grisu_round(char *buf, int len, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k) {
+    while (rest < dist && delta - rest >= ten_k &&
+           (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+}
+
+/* Grisu2 for a finite v > 0: digits into buf, value = digits * 10^*dexp */
+static int num_grisu2(double v, char *buf, int *dexp) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    uint64_t F = bits & ((1ULL << 52) - 1);
+    int E = (int)(bits >> 52);
+    num_fp w = E ? (num_fp){ F | 1ULL << 52, E - 1075 } : (num_fp){ F, -1074 };
+
+    /* the rounding interval [m-, m+], narrower below powers of two */
+    num_fp mp = num_fp_norm((num_fp){ 2 * w.f + 1, w.e - 1 });
+    num_fp mm = F == 0 && E > 1 ? (num_fp){ 4 * w.f - 1, w.e - 2 } : (num_fp){ 2 * w.f - 1, w.e - 1 };
+    mm = (num_fp){ mm.f << (mm.e - mp.e), mp.e };
+    w = num_fp_norm(w);
+
+    /* scale by 10^k so the product's exponent lands in [-60, -32] */
+    int f = -60 - mp.e - 1, k = f * 78913 / (1 << 18) + (f > 0);
+    const uint64_t *p5 = num_pow5[k - NUM_POW5_MIN];
+    num_fp c = { p5[0] + (p5[1] >> 63), ((217706 * k) >> 16) - 63 };
+    num_fp W = num_fp_mul(w, c), lo = num_fp_mul(mm, c), hi = num_fp_mul(mp, c);
+    lo.f++;
+    hi.f--;
+    *dexp = -k;
+
+    uint64_t delta = hi.f - lo.f, dist = hi.f - W.f;
+    num_fp one = { 1ULL << -hi.e, hi.e };
+    uint32_t p1 = (uint32_t)(hi.f >> -one.e), pow10 = 1;
+    uint64_t p2 = hi.f & (one.f - 1);
+    int len = 0, n = 1;
+    while (n < 10 && p1 >= pow10 * 10) { pow10 *= 10; n++; }
+    while (n > 0) {
+        buf[len++] = (char)('0' + p1 / pow10);
+        p1 %= pow10;
+        n--;
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *dexp += n;
+            num_grisu_round(buf, len, dist, delta, rest, (uint64_t)pow10 << -one.e);
+            return len;
+        }
+        pow10 /= 10;
+    }
+    for (;;) {
+        p2 *= 10;
+        buf[len++] = (char)('0' + (p2 >> -one.e));
+        p2 &= one.f - 1;
+        delta *= 10;
+        dist *= 10;
+        (*dexp)--;
+        if (p2 <= delta) break;
+    }
+    num_grisu_round(buf, len, dist, delta, p2, one.f);
+    return len;
+}
+
+static int num_utoa(uint64_t u, char *out) {
+    char tmp[20];
+    int n = 0;
+    do { tmp[n++] = (char)('0' + u % 10); u /= 10; } while (u);
+    for (int i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+    return n;
+}
+
+/* Shortest text that num_parse() reads back as v: plain notation for
+ * decimal exponents -7 < e < 21, d.ddde+N outside. Writes at most
+ * NUM_FORMAT_MAX bytes including the NUL and returns the length. */
+int num_format(double v, char *out) {
+    char *o = out, digits[20];
+    if (v != v) { memcpy(out, "nan", 4); return 3; }
+    if (signbit(v)) { *o++ = '-'; v = -v; }
+    if (v == HUGE_VAL) { memcpy(o, "inf", 4); return (int)(o - out) + 3; }
+    if (v < 9007199254740992.0 && v == (double)(uint64_t)v) {
+        o += num_utoa((uint64_t)v, o);
+        *o = '\0';
+        return (int)(o - out);
+    }
+    int dexp, n = num_grisu2(v, digits, &dexp), point = n + dexp;
+    if (point > 0 && point <= 21) {                     /* ddd00 or dd.ddd */
+        if (dexp >= 0) {
+            memcpy(o, digits, n);
+            memset(o + n, '0', dexp);
+            o += point;
+        } else {
+            memcpy(o, digits, point);
+            o[point] = '.';
+            memcpy(o + point + 1, digits + point, n - point);
+            o += n + 1;
+        }
+    } else if (point > -6 && point <= 0) {              /* 0.000ddd */
+        *o++ = '0';
+        *o++ = '.';
+        memset(o, '0', -point);
+        o += -point;
+        memcpy(o, digits, n);
+        o += n;
+    } else {                                            /* d.ddde+N */
+        *o++ = digits[0];
+        if (n > 1) {
+            *o++ = '.';
+            memcpy(o, digits + 1, n - 1);
+            o += n - 1;
+        }
+        *o++ = 'e';
+        *o++ = point - 1 < 0 ? '-' : '+';
+        o += num_utoa((uint64_t)(point - 1 < 0 ? 1 - point : point - 1), o);
+    }
+    *o = '\0';
+    return (int)(o - out);
+}
+
+/* Expression compiler: infix text -> flat stack bytecode.
+ * Grammar (lowest to highest precedence):
+ *   expr  := term (('+' | '-') term)*
+ *   term  := unary (('*' | '/') unary)*
+ *   unary := ('-' | '+') unary | power
+ *   power := primary ('^' unary)?          right associative, -2^2 == -4
+ *   primary := number | name | '(' expr ')'
+ * Adjacent constant operands are folded while emitting, so a fully constant
+ * expression compiles down to a single OP_CONST. Names are resolved against the
+ * list given to compile_expr_vars() and read from prog->vars at run time.
+ */
+#define EXPR_STACK_MAX  64    /* max operand stack depth of a compiled program */
+#define EXPR_NEST_MAX   256   /* max parser recursion (parentheses / unary chains) */
+#define EXPR_INLINE_INS 16    /* instructions stored without touching the heap */
+#define EXACT_LIMIT 9007199254740992.0   /* 2^53: larger doubles may be rounded */
+
+enum { OP_CONST, OP_VAR, OP_NEG, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW };
+
+typedef struct { unsigned char op; int slot; double k; } expr_ins;
+
+typedef struct {
+    expr_ins *code;               /* points at inl until the program outgrows it */
+    int len, cap;
+    int depth, max_depth;         /* operand stack bookkeeping while compiling */
+    int wide;                     /* a constant reached 2^53, so the result may be rounded */
+    const double *vars;           /* values for OP_VAR slots, bound by the caller */
+    expr_ins inl[EXPR_INLINE_INS];
+} expr_prog;
+
+typedef struct {
+    const char *p; expr_prog *prog;
+    const char *const *names; int nnames;
+    int nest; int err;
+} expr_parser;
+
+/* base^-n is 1 / base^n taken in long double: the wider exponent range
+ * keeps base^n from overflowing before the reciprocal is a subnormal
+ * double (2^-1074), and the wider mantissa keeps the rounding of the
+ * squarings out of the result (10^-300) */
+static long double pow_recip(long double base, unsigned long long exp) {
+    long double result = 1;
+    while (exp > 0) {
+        if (exp & 1) result *= base;
+        base *= base;
+        exp >>= 1;
+    }
+    return 1 / result;
+}
+
+/* Integer exponent, negative exponents give the reciprocal */
+double pow_int(double base, long long exp) {
+    if (exp < 0) return (double)pow_recip(base, -(unsigned long long)exp);
+    return parallel_pow(base, exp);
+}
+
+/* ^ takes whole-number exponents only; anything else used to be truncated */
+static int integral_exp(double e) {
+    return e >= -9.2e18 && e <= 9.2e18 && (double)(long long)e == e;
+}
+
+/* a^b, NAN when b is not a whole number */
+double pow_real(double a, double b) {
+    return integral_exp(b) ? pow_int(a, (long long)b) : NAN;
+}
+
+static int apply_op(int op, double a, double b, double *out) {
+    switch (op) {
+        case OP_ADD: *out = a + b; break;
+        case OP_SUB: *out = a - b; break;
+        case OP_MUL: *out = a * b; break;
+        case OP_DIV: if (b == 0) return 0; *out = a / b; break;
+        case OP_POW: if (!integral_exp(b)) return 0; *out = pow_int(a, (long long)b); break;
+        default: return 0;
+    }
+    return 1;
+}
+
+static void emit_slot(expr_parser *ps, int op, int slot, double k) {
+    expr_prog *pr = ps->prog;
+    expr_ins *c = pr->code;
+    /* Peephole constant folding. Division by a constant zero is left in
+     * place so the error is still reported when the program runs. */
+    if (op == OP_NEG && pr->len >= 1 && c[pr->len - 1].op == OP_CONST) {
+        c[pr->len - 1].k = -c[pr->len - 1].k;
+        return;
+    }
+    if (op >= OP_ADD && pr->len >= 2 && c[pr->len - 1].op == OP_CONST && c[pr->len - 2].op == OP_CONST) {
+        double r;
+        if (apply_op(op, c[pr->len - 2].k, c[pr->len - 1].k, &r)) {
+            if (r <= -EXACT_LIMIT || r >= EXACT_LIMIT) pr->wide = 1;
+            c[pr->len - 2].k = r;
+            pr->len--;
+            pr->depth--;
+            return;
+        }
+    }
+    if (pr->len == pr->cap) {
+        int ncap = pr->cap * 2;
+        expr_ins *n = pr->code == pr->inl ? malloc(ncap * sizeof(*n)) : realloc(pr->code, ncap * sizeof(*n));
+        if (!n) { ps->err = 1; return; }
+        if (pr->code == pr->inl) memcpy(n, pr->inl, sizeof(pr->inl));
+        pr->code = n;
+        pr->cap = ncap;
+    }
+    if (op == OP_CONST && (k <= -EXACT_LIMIT || k >= EXACT_LIMIT)) pr->wide = 1;
+    pr->code[pr->len].op = (unsigned char)op;
+    pr->code[pr->len].slot = slot;
+    pr->code[pr->len].k = k;
+    pr->len++;
+    if (op == OP_CONST || op == OP_VAR) pr->depth++;
+    else if (op != OP_NEG) pr->depth--;
+    if (pr->depth > pr->max_depth) pr->max_depth = pr->depth;
+    if (pr->max_depth > EXPR_STACK_MAX) ps->err = 1;
+}
+
+static void emit(expr_parser *ps, int op, double k) {
+    emit_slot(ps, op, 0, k);
+}
+
+static void skip_ws(expr_parser *ps) {
+    while (isspace((unsigned char)*ps->p)) ps->p++;
+}
+
+static void parse_sum(expr_parser *ps);
+static void parse_unary(expr_parser *ps);
+
+static void parse_primary(expr_parser *ps) {
+    skip_ws(ps);
+    if (*ps->p == '(') {
+        ps->p++;
+        parse_sum(ps);
+        skip_ws(ps);
+        if (*ps->p != ')') { ps->err = 1; return; }
+        ps->p++;
+        return;
+    }
+    if (isdigit((unsigned char)*ps->p) || (*ps->p == '.' && isdigit((unsigned char)ps->p[1]))) {
+        char *end;
+        double v = num_parse(ps->p, &end);
+        ps->p = end;
+        emit(ps, OP_CONST, v);
+        return;
+    }
+    if (isalpha((unsigned char)*ps->p) || *ps->p == '_') {
+        const char *s = ps->p;
+        while (isalnum((unsigned char)*ps->p) || *ps->p == '_') ps->p++;
+        for (int i = 0; i < ps->nnames; i++) {
+            if (strncmp(ps->names[i], s, ps->p - s) == 0 && ps->names[i][ps->p - s] == '\0') {
+                emit_slot(ps, OP_VAR, i, 0);
+                return;
+            }
+        }
+    }
+    ps->err = 1;
+}
+
+static void parse_power(expr_parser *ps) {
+    parse_primary(ps);
+    skip_ws(ps);
+    if (!ps->err && *ps->p == '^') {
+        ps->p++;
+        parse_unary(ps);
+        emit(ps, OP_POW, 0);
+    }
+}
+
+static void parse_unary(expr_parser *ps) {
+    if (++ps->nest > EXPR_NEST_MAX) { ps->err = 1; return; }
+    skip_ws(ps);
+    if (*ps->p == '-' || *ps->p == '+') {
+        int neg = *ps->p++ == '-';
+        parse_unary(ps);
+        if (neg) emit(ps, OP_NEG, 0);
+    } else {
+        parse_power(ps);
+    }
+    ps->nest--;
+}
+
+static void parse_term(expr_parser *ps) {
+    parse_unary(ps);
+    for (skip_ws(ps); !ps->err && (*ps->p == '*' || *ps->p == '/'); skip_ws(ps)) {
+        int op = *ps->p++ == '*' ? OP_MUL : OP_DIV;
+        parse_unary(ps);
+        emit(ps, op, 0);
+    }
+}
+
+static void parse_sum(expr_parser *ps) {
+    if (++ps->nest > EXPR_NEST_MAX) { ps->err = 1; return; }
+    parse_term(ps);
+    for (skip_ws(ps); !ps->err && (*ps->p == '+' || *ps->p == '-'); skip_ws(ps)) {
+        int op = *ps->p++ == '+' ? OP_ADD : OP_SUB;
+        parse_term(ps);
+        emit(ps, op, 0);
+    }
+    ps->nest--;
+}
+
+void free_expr(expr_prog *prog) {
+    if (prog->code != prog->inl) free(prog->code);
+    prog->code = prog->inl;
+    prog->len = 0;
+}
+
+/* compile_expr_vars() that also sets *stop to where parsing ended */
+static int compile_at(const char *src, expr_prog *prog, const char *const *names, int nnames, const char **stop) {
+    expr_parser ps = { src, prog, names, nnames, 0, 0 };
+    prog->vars = NULL;
+    prog->code = prog->inl;
+    prog->cap = EXPR_INLINE_INS;
+    prog->len = prog->depth = prog->max_depth = prog->wide = 0;
+    parse_sum(&ps);
+    skip_ws(&ps);
+    *stop = ps.p;
+    if (ps.err || *ps.p != '\0' || prog->len == 0) {
+        free_expr(prog);
+        return 0;
+    }
+    return 1;
+}
+
+/* Returns 1 and fills prog on success, 0 if src is not a valid expression.
+ * names[i] becomes variable slot i; unknown names are a syntax error. */
+int compile_expr_vars(const char *src, expr_prog *prog, const char *const *names, int nnames) {
+    const char *stop;
+    return compile_at(src, prog, names, nnames, &stop);
+}
+
+int compile_expr(const char *src, expr_prog *prog) {
+    return compile_expr_vars(src, prog, NULL, 0);
+}
+
+/* Why src does not compile, into buf: the operator the parser stopped
+ * at, or the expression itself when it is malformed otherwise. Returns
+ * snprintf()'s length; buf is empty if src compiles. */
+int expr_error_text(const char *src, char *buf, size_t cap) {
+    expr_prog prog;
+    const char *stop;
+    if (compile_at(src, &prog, NULL, 0, &stop)) {
+        free_expr(&prog);
+        if (cap) *buf = '\0';
+        return 0;
+    }
+    if (ispunct((unsigned char)*stop) && !strchr("().", *stop))
+        return snprintf(buf, cap, "Unsupported operator: %c", *stop);
+    return snprintf(buf, cap, "Invalid expression: %s", src);
+}
+
+/* Reports expr_error_text() on stderr */
+void expr_error(const char *src) {
+    char msg[256];
+    if (expr_error_text(src, msg, sizeof(msg)) > 0) fprintf(stderr, "%s\n", msg);
+}
+
+/* Runtime errors of run_expr() on this thread: the last message, and
+ * whether to leave it unprinted (the daemon replies with it instead) */
+static __thread const char *run_error;
+static __thread int run_quiet;
+
+static int run_fail(const char *msg) {
+    run_error = msg;
+    if (!run_quiet) fprintf(stderr, "%s\n", msg);
+    return -1;
+}
+
+/* Tight evaluator loop; returns 1 on success, -1 on a runtime error */
+int run_expr(const expr_prog *prog, double *out) {
+    double st[EXPR_STACK_MAX];
+    int sp = 0;
+    for (const expr_ins *i = prog->code, *e = i + prog->len; i < e; i++) {
+        switch (i->op) {
+            case OP_CONST: st[sp++] = i->k; break;
+            case OP_VAR: st[sp++] = prog->vars[i->slot]; break;
+            case OP_NEG: st[sp - 1] = -st[sp - 1]; break;
+            case OP_ADD: sp--; st[sp - 1] += st[sp]; break;
+            case OP_SUB: sp--; st[sp - 1] -= st[sp]; break;
+            case OP_MUL: sp--; st[sp - 1] *= st[sp]; break;
+            case OP_DIV:
+                sp--;
+                if (st[sp] == 0) return run_fail("Error: div by zero");
+                st[sp - 1] /= st[sp];
+                break;
+            case OP_POW:
+                sp--;
+                if (!integral_exp(st[sp])) return run_fail("Error: exponent must be an integer");
+                st[sp - 1] = pow_int(st[sp - 1], (long long)st[sp]);
+                break;
+        }
+    }
+    *out = st[0];
+    return 1;
+}
+
+/* One-shot evaluation: 1 = ok, 0 = not an expression, -1 = runtime error.
+ * *wide (if wide is set) tells whether a value on the way reached 2^53,
+ * where the double may have been rounded. */
+int eval_expr_wide(const char *expr, double *out, int *wide) {
+    expr_prog prog;
+    if (!compile_expr(expr, &prog)) return 0;
+    int rc = run_expr(&prog, out);
+    if (wide) *wide = prog.wide;
+    free_expr(&prog);
+    return rc;
+}
+
+int eval_expr(const char *expr, double *out) {
+    return eval_expr_wide(expr, out, NULL);
+}
+
+/* Buffered writer: collects output and hands it to write(2) in large pieces.
+ * With fd -1 it captures instead: the buffer grows and is never flushed. */
+#define OUT_BUF_SIZE (1 << 20)
+
+typedef struct { int fd; char *buf; size_t len, cap; int err; } out_buf;
+
+int out_init(out_buf *o, int fd, size_t cap) {
+    o->fd = fd;
+    o->len = 0;
+    o->cap = cap;
+    o->err = 0;
+    o->buf = malloc(cap);
+    return o->buf != NULL;
+}
+
+void out_flush(out_buf *o) {
+    size_t off = 0;
+    if (o->fd < 0) return;
+    while (off < o->len) {
+        ssize_t n = write(o->fd, o->buf + off, o->len - off);
+        if (n < 0) { o->err = 1; break; }
+        off += n;
+    }
+    o->len = 0;
+}
+
+/* Makes room for n more bytes; 0 if a capture buffer cannot grow */
+static int out_reserve(out_buf *o, size_t n) {
+    if (o->len + n <= o->cap) return 1;
+    if (o->fd >= 0) { out_flush(o); return n <= o->cap; }
+    size_t ncap = o->cap ? o->cap : 4096;
+    while (ncap < o->len + n) ncap *= 2;
+    char *nb = realloc(o->buf, ncap);
+    if (!nb) { o->err = 1; return 0; }
+    o->buf = nb;
+    o->cap = ncap;
+    return 1;
+}
+
+void out_write(out_buf *o, const void *p, size_t n) {
+    if (!out_reserve(o, n)) {
+        if (o->fd < 0) return;
+        for (size_t off = 0; off < n; ) {
+            ssize_t w = write(o->fd, (const char *)p + off, n - off);
+            if (w < 0) { o->err = 1; return; }
+            off += w;
+        }
+        return;
+    }
+    memcpy(o->buf + o->len, p, n);
+    o->len += n;
+}
+
+void out_double(out_buf *o, double v) {
+    if (!out_reserve(o, NUM_FORMAT_MAX)) return;
+    o->len += num_format(v, o->buf + o->len);
+    o->buf[o->len++] = '\n';
+}
+
+void out_close(out_buf *o) {
+    out_flush(o);
+    free(o->buf);
+    o->buf = NULL;
+}
+
+/* Column evaluation (-v): one compiled program applied to a block of values
+ * at a time. Stack entries are either a scalar or a pointer to a block, and
+ * each operator runs as one SIMD kernel over the whole block. */
+#define VEC_BLOCK 1024
+
+typedef void (*vec_binop_fn)(double *d, const double *a, double ak, const double *b, double bk, int n);
+typedef void (*vec_powi_fn)(double *d, const double *a, long long e, int n);
+typedef void (*vec_neg_fn)(double *d, const double *a, int n);
+typedef void (*vec_reduce_fn)(const double *v, int n, double *sum, double *min, double *max);
+
+typedef struct {
+    const char *name;
+    vec_binop_fn binop[4];        /* indexed by op - OP_ADD: add, sub, mul, div */
+    vec_powi_fn powi;
+    vec_neg_fn neg;
+    vec_reduce_fn reduce;
+} vec_kernels;
+
+/* a or b may be NULL, in which case the scalar ak / bk is broadcast */
+#define DEFINE_VEC_BINOP(name, attr, VT, W, LD, ST, SET1, VOP, SOP)                    \
+attr static void name(double *d, const double *a, double ak, const double *b, double bk, int n) { \
+    int i = 0;                                                                         \
+    if (a && b) {                                                                      \
+        for (; i + W <= n; i += W) ST(d + i, VOP(LD(a + i), LD(b + i)));               \
+    } else if (a) {                                                                    \
+        VT vb = SET1(bk);                                                              \
+        for (; i + W <= n; i += W) ST(d + i, VOP(LD(a + i), vb));                      \
+    } else {                                                                           \
+        VT va = SET1(ak);                                                              \
+        for (; i + W <= n; i += W) ST(d + i, VOP(va, LD(b + i)));                      \
+    }                                                                                  \
+    for (; i < n; i++) d[i] = (a ? a[i] : ak) SOP (b ? b[i] : bk);                     \
+}
+
+/* Exponentiation by squaring with one exponent shared by every lane */
+#define DEFINE_VEC_POWI(name, attr, VT, W, LD, ST, SET1, MUL, DIV)                     \
+attr static void name(double *d, const double *a, long long e, int n) {               \
+    unsigned long long u = e < 0 ? -(unsigned long long)e : (unsigned long long)e;     \
+    int i = 0;                                                                         \
+    for (; i + W <= n; i += W) {                                                       \
+        VT b = LD(a + i), r = SET1(1.0);                                               \
+        for (unsigned long long k = u; k; k >>= 1) {                                   \
+            if (k & 1) r = MUL(r, b);                                                  \
+            b = MUL(b, b);                                                             \
+        }                                                                              \
+        if (e < 0) r = DIV(SET1(1.0), r);                                              \
+        ST(d + i, r);                                                                  \
+    }                                                                                  \
+    for (; i < n; i++) d[i] = pow_int(a[i], e);                                        \
+}
+
+/* d = -a by flipping the sign bit, as scalar negation does: 0 - x would
+ * turn -0 into +0 */
+#define DEFINE_VEC_NEG(name, attr, VT, W, LD, ST, SET1, XOR)                            \
+attr static void name(double *d, const double *a, int n) {                             \
+    VT sign = SET1(-0.0);                                                              \
+    int i = 0;                                                                         \
+    for (; i + W <= n; i += W) ST(d + i, XOR(LD(a + i), sign));                        \
+    for (; i < n; i++) d[i] = -a[i];                                                   \
+}
+
+/* Adds the sum of v[0..n) to *sum and widens [*min, *max] over it; each
+ * lane keeps its own partial sum, so the rounding differs from a serial
+ * loop by the order of the additions */
+#define DEFINE_VEC_REDUCE(name, attr, VT, W, LD, ST, SET1, ADD, MIN, MAX)              \
+attr static void name(const double *v, int n, double *sum, double *min, double *max) { \
+    VT s = SET1(0.0), lo = SET1(*min), hi = SET1(*max);                                \
+    double ls[W], ll[W], lh[W], t = 0;                                                 \
+    int i = 0;                                                                         \
+    for (; i + W <= n; i += W) {                                                       \
+        VT x = LD(v + i);                                                              \
+        s = ADD(s, x);                                                                 \
+        lo = MIN(lo, x);                                                               \
+        hi = MAX(hi, x);                                                               \
+    }                                                                                  \
+    ST(ls, s);                                                                         \
+    ST(ll, lo);                                                                        \
+    ST(lh, hi);                                                                        \
+    for (int k = 0; k < W; k++) {                                                      \
+        t += ls[k];                                                                    \
+        if (ll[k] < *min) *min = ll[k];                                                \
+        if (lh[k] > *max) *max = lh[k];                                                \
+    }                                                                                  \
+    for (; i < n; i++) {                                                               \
+        t += v[i];                                                                     \
+        if (v[i] < *min) *min = v[i];                                                  \
+        if (v[i] > *max) *max = v[i];                                                  \
+    }                                                                                  \
+    *sum += t;                                                                         \
+}
+
+#define DEFINE_VEC_KERNELS(isa, attr, VT, W, LD, ST, SET1, ADD, SUB, MUL, DIV, XOR, MIN, MAX) \
+    DEFINE_VEC_BINOP(isa##_add, attr, VT, W, LD, ST, SET1, ADD, +)                     \
+    DEFINE_VEC_BINOP(isa##_sub, attr, VT, W, LD, ST, SET1, SUB, -)                     \
+    DEFINE_VEC_BINOP(isa##_mul, attr, VT, W, LD, ST, SET1, MUL, *)                     \
+    DEFINE_VEC_BINOP(isa##_div, attr, VT, W, LD, ST, SET1, DIV, /)                     \
+    DEFINE_VEC_POWI(isa##_powi, attr, VT, W, LD, ST, SET1, MUL, DIV)                   \
+    DEFINE_VEC_NEG(isa##_neg, attr, VT, W, LD, ST, SET1, XOR)                          \
+    DEFINE_VEC_REDUCE(isa##_reduce, attr, VT, W, LD, ST, SET1, ADD, MIN, MAX)          \
+    static const vec_kernels isa##_kernels = {                                         \
+        #isa, { isa##_add, isa##_sub, isa##_mul, isa##_div }, isa##_powi, isa##_neg,   \
+        isa##_reduce                                                                   \
+    };
+
+#define S_LD(p)       (*(p))
+#define S_ST(p, v)    (*(p) = (v))
+#define S_SET1(x)     (x)
+#define S_ADD(a, b)   ((a) + (b))
+#define S_SUB(a, b)   ((a) - (b))
+#define S_MUL(a, b)   ((a) * (b))
+#define S_DIV(a, b)   ((a) / (b))
+#define S_MIN(a, b)   ((b) < (a) ? (b) : (a))
+#define S_MAX(a, b)   ((b) > (a) ? (b) : (a))
+
+static inline double s_xor(double a, double b) {
+    uint64_t x, y;
+    memcpy(&x, &a, sizeof(x));
+    memcpy(&y, &b, sizeof(y));
+    x ^= y;
+    memcpy(&a, &x, sizeof(a));
+    return a;
+}
+DEFINE_VEC_KERNELS(scalar, , double, 1, S_LD, S_ST, S_SET1, S_ADD, S_SUB, S_MUL, S_DIV, s_xor, S_MIN, S_MAX)
+
+#if defined(__x86_64__) || defined(__i386__)
+DEFINE_VEC_KERNELS(sse2, __attribute__((target("sse2"))), __m128d, 2,
+                   _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd,
+                   _mm_add_pd, _mm_sub_pd, _mm_mul_pd, _mm_div_pd, _mm_xor_pd, _mm_min_pd, _mm_max_pd)
+DEFINE_VEC_KERNELS(avx2, __attribute__((target("avx2"))), __m256d, 4,
+                   _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd,
+                   _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd,
+                   _mm256_xor_pd, _mm256_min_pd, _mm256_max_pd)
+#endif
+
+/* Picks the widest kernel set the CPU supports; OSHELL_SIMD=scalar|sse2|avx2 overrides */
+const vec_kernels *select_kernels(void) {
+    const char *force = getenv("OSHELL_SIMD");
+    if (force && strcmp(force, "scalar") == 0) return &scalar_kernels;
+#if defined(__x86_64__) || defined(__i386__)
+    if (force && strcmp(force, "sse2") == 0) return &sse2_kernels;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &avx2_kernels;
+    return &sse2_kernels;
+#else
+    return &scalar_kernels;
+#endif
+}
+
+typedef struct { const double *v; double k; } vec_slot;   /* v == NULL: scalar k */
+
+/* Evaluates prog over n <= VEC_BLOCK values of variable slot 0. ws must hold
+ * prog->max_depth * VEC_BLOCK doubles. Division follows IEEE rules here
+ * (x/0 gives inf or nan) since a column cannot stop on one bad element. */
+void run_expr_block(const vec_kernels *vk, const expr_prog *prog, const double *x,
+                    double *out, int n, double *ws) {
+    vec_slot st[EXPR_STACK_MAX];
+    int sp = 0;
+    for (const expr_ins *i = prog->code, *e = i + prog->len; i < e; i++) {
+        if (i->op == OP_CONST) { st[sp].v = NULL; st[sp++].k = i->k; continue; }
+        if (i->op == OP_VAR) { st[sp].v = x; st[sp++].k = 0; continue; }
+        if (i->op == OP_NEG) {
+            vec_slot *b = &st[sp - 1];
+            double *dst = ws + (size_t)(sp - 1) * VEC_BLOCK;
+            if (!b->v) { b->k = -b->k; continue; }
+            vk->neg(dst, b->v, n);
+            b->v = dst;
+            continue;
+        }
+        vec_slot *a = &st[sp - 2], *b = &st[sp - 1];
+        double *dst = ws + (size_t)(sp - 2) * VEC_BLOCK;
+        sp--;
+        if (!a->v && !b->v) {
+            switch (i->op) {
+                case OP_ADD: a->k += b->k; break;
+                case OP_SUB: a->k -= b->k; break;
+                case OP_MUL: a->k *= b->k; break;
+                case OP_DIV: a->k /= b->k; break;
+                case OP_POW: a->k = pow_real(a->k, b->k); break;
+            }
+            continue;
+        }
+        if (i->op != OP_POW) {
+            vk->binop[i->op - OP_ADD](dst, a->v, a->k, b->v, b->k, n);
+        } else if (!b->v && integral_exp(b->k)) {
+            vk->powi(dst, a->v, (long long)b->k, n);
+        } else {
+            for (int j = 0; j < n; j++)
+                dst[j] = pow_real(a->v ? a->v[j] : a->k, b->v ? b->v[j] : b->k);
+        }
+        a->v = dst;
+    }
+    if (!st[0].v) {
+        for (int j = 0; j < n; j++) out[j] = st[0].k;
+    } else if (st[0].v != out) {
+        memcpy(out, st[0].v, n * sizeof(double));
+    }
+}
+
+static int has_suffix(const char *s, const char *suffix) {
+    size_t ls = strlen(s), lx = strlen(suffix);
+    return ls >= lx && strcmp(s + ls - lx, suffix) == 0;
+}
+
+typedef struct {
+    const vec_kernels *vk;
+    const expr_prog *prog;
+    double *ws, *res;
+    out_buf out;
+    int binary_out;
+    long long count;
+} column_job;
+
+static void column_emit(column_job *cj, const double *x, int n) {
+    run_expr_block(cj->vk, cj->prog, x, cj->res, n, cj->ws);
+    if (cj->binary_out) {
+        out_write(&cj->out, cj->res, n * sizeof(double));
+    } else {
+        for (int j = 0; j < n; j++) out_double(&cj->out, cj->res[j]);
+    }
+    cj->count += n;
+}
+
+/* Raw native-endian doubles, evaluated straight out of the mapping */
+static int column_from_mmap(column_job *cj, int fd) {
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) { perror("fstat"); return 0; }
+    size_t n = sb.st_size / sizeof(double);
+    if (sb.st_size % sizeof(double))
+        fprintf(stderr, "Warning: ignoring %lld trailing bytes\n", (long long)(sb.st_size % sizeof(double)));
+    if (n == 0) return 1;
+    const double *col = mmap(NULL, n * sizeof(double), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (col == MAP_FAILED) { perror("mmap"); return 0; }
+    madvise((void *)col, n * sizeof(double), MADV_SEQUENTIAL);
+    for (size_t i = 0; i < n; i += VEC_BLOCK)
+        column_emit(cj, col + i, n - i < VEC_BLOCK ? (int)(n - i) : VEC_BLOCK);
+    munmap((void *)col, n * sizeof(double));
+    return 1;
+}
+
+/* Whitespace separated decimal text, read in large blocks */
+static int column_from_text(column_job *cj, int fd) {
+    size_t cap = OUT_BUF_SIZE, have = 0;
+    char *buf = malloc(cap + 1);
+    double *x = malloc(VEC_BLOCK * sizeof(double));
+    int nx = 0, ok = 1, eof = 0;
+    if (!buf || !x) { free(buf); free(x); return 0; }
+    while (ok && !eof) {
+        ssize_t r = read(fd, buf + have, cap - have);
+        if (r < 0) { perror("read"); ok = 0; break; }
+        if (r == 0) eof = 1;
+        have += r;
+        /* Only parse up to the last separator unless the input has ended */
+        size_t end = have;
+        if (!eof) {
+            while (end > 0 && !isspace((unsigned char)buf[end - 1])) end--;
+            if (end == 0) {
+                if (have < cap) continue;
+                fprintf(stderr, "Error: token longer than %zu bytes\n", cap);
+                ok = 0;
+                break;
+            }
+        }
+        char saved = buf[end];
+        buf[end] = '\0';
+        char *p = buf;
+        while (1) {
+            while (isspace((unsigned char)*p)) p++;
+            if (*p == '\0') break;
+            char *q;
+            x[nx] = num_parse(p, &q);
+            if (q == p) { fprintf(stderr, "Error: invalid number '%.*s'\n", (int)strcspn(p, " \t\r\n"), p); ok = 0; break; }
+            p = q;
+            if (++nx == VEC_BLOCK) { column_emit(cj, x, nx); nx = 0; }
+        }
+        buf[end] = saved;
+        memmove(buf, buf + end, have - end);
+        have -= end;
+    }
+    if (ok && nx) column_emit(cj, x, nx);
+    free(buf);
+    free(x);
+    return ok;
+}
+
+/* oshell -v EXPR IN [OUT]: binds x to every value of IN. Files ending in
+ * .bin are raw doubles (input is mmap'd), anything else is text; "-" is
+ * stdin/stdout. */
+int eval_column(const char *expr, const char *in_path, const char *out_path) {
+    static const char *const names[] = { "x" };
+    column_job cj;
+    expr_prog prog;
+    int ok = 0;
+    if (!compile_expr_vars(expr, &prog, names, 1)) {
+        fprintf(stderr, "Invalid expression: %s\n", expr);
+        return 0;
+    }
+    int in_fd = strcmp(in_path, "-") == 0 ? 0 : open(in_path, O_RDONLY);
+    if (in_fd < 0) { perror("open input file"); free_expr(&prog); return 0; }
+    int out_fd = !out_path || strcmp(out_path, "-") == 0 ? 1
+               : open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) { perror("open output file"); goto close_in; }
+
+    cj.vk = select_kernels();
+    cj.prog = &prog;
+    cj.binary_out = out_path && has_suffix(out_path, ".bin");
+    cj.count = 0;
+    cj.ws = malloc((size_t)(prog.max_depth + 1) * VEC_BLOCK * sizeof(double));
+    cj.res = malloc(VEC_BLOCK * sizeof(double));
+    if (cj.ws && cj.res && out_init(&cj.out, out_fd, OUT_BUF_SIZE)) {
+        ok = has_suffix(in_path, ".bin") ? column_from_mmap(&cj, in_fd) : column_from_text(&cj, in_fd);
+        out_close(&cj.out);
+        if (cj.out.err) { perror("write"); ok = 0; }
+    }
+    free(cj.ws);
+    free(cj.res);
+    if (out_fd != 1) close(out_fd);
+close_in:
+    if (in_fd != 0) close(in_fd);
+    free_expr(&prog);
+    return ok;
+}
+
+/* Bump arena for everything a command line parses into. Allocating is a
+ * pointer bump and arena_reset() releases the whole line at once. When a
+ * line spilled into extra blocks, the reset replaces them all with one
+ * block of their combined size, so after a few lines parsing stops calling
+ * malloc altogether. */
+#define ARENA_MIN_BLOCK 4096
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size, used, pad;       /* pad keeps data 16-byte aligned */
+    char data[];
+} arena_block;
+
+typedef struct { arena_block *head; } arena;
+
+static arena_block *arena_block_new(size_t size, arena_block *next) {
+    arena_block *b = malloc(sizeof(*b) + size);
+    if (!b) return NULL;
+    b->next = next;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+void *arena_alloc(arena *a, size_t n) {
+    arena_block *b = a->head;
+    n = (n + 15) & ~(size_t)15;
+    if (!b || b->size - b->used < n) {
+        size_t size = b ? 2 * b->size : ARENA_MIN_BLOCK;
+        while (size < n) size *= 2;
+        if (!(b = arena_block_new(size, b))) return NULL;
+        a->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+void arena_free(arena *a) {
+    for (arena_block *b = a->head, *next; b; b = next) {
+        next = b->next;
+        free(b);
+    }
+    a->head = NULL;
+}
+
+void arena_reset(arena *a) {
+    arena_block *b = a->head;
+    if (b && b->next) {
+        size_t total = 0;
+        for (arena_block *x = b; x; x = x->next) total += x->size;
+        arena_free(a);
+        a->head = arena_block_new(total, NULL);
+    } else if (b) {
+        b->used = 0;
+    }
+}
+
+/* Copies the n bytes at old into a fresh block of size bytes */
+static void *arena_grow(arena *a, const void *old, size_t n, size_t size) {
+    void *p = arena_alloc(a, size);
+    if (p && n) memcpy(p, old, n);
+    return p;
+}
+
+/* Streaming mode (-s): evaluates one expression per line of a file or stdin.
+ * The reader cuts the input into large chunks on line boundaries, a pool of
+ * workers evaluates whole chunks into private result buffers, and the main
+ * thread writes the buffers back in input order. Lines have no length limit. */
+#define STREAM_CHUNK (1 << 20)
+
+typedef struct {
+    char *data; size_t len, cap;      /* complete lines of input */
+    char *res; size_t rlen, rcap;     /* formatted results */
+    long errors;
+    int done;
+} stream_chunk;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work, finished;
+    stream_chunk *slots;
+    int nslots;
+    long long next_read, next_run;    /* chunks filled / handed to a worker */
+    int stop;
+} stream_pool;
+
+static int grow(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return 1;
+    size_t ncap = *cap ? *cap : 4096;
+    while (ncap < need) ncap *= 2;
+    char *n = realloc(*buf, ncap);
+    if (!n) return 0;
+    *buf = n;
+    *cap = ncap;
+    return 1;
+}
+
+char *exact_digits(const char *expr, int wide, int threads);
+
+static void stream_eval_chunk(stream_chunk *c) {
+    char *p = c->data, *end = c->data + c->len;
+    c->rlen = 0;
+    c->errors = 0;
+    while (p < end) {
+        char *nl = memchr(p, '\n', end - p);
+        char *eol = nl ? nl : end;
+        *eol = '\0';
+        if (eol > p && eol[-1] == '\r') eol[-1] = '\0';
+        if (!grow(&c->res, &c->rcap, c->rlen + 64)) { c->errors++; return; }
+        double v;
+        int wide = 0, rc = *trim_whitespace(p) ? eval_expr_wide(p, &v, &wide) : 2;
+        char *s = rc == 1 ? exact_digits(p, wide, 1) : NULL;
+        if (s) {
+            size_t n = strlen(s);
+            if (!grow(&c->res, &c->rcap, c->rlen + n + 1)) { free(s); c->errors++; return; }
+            memcpy(c->res + c->rlen, s, n);
+            c->rlen += n;
+            c->res[c->rlen++] = '\n';
+            free(s);
+        } else if (rc == 1) {
+            c->rlen += num_format(v, c->res + c->rlen);
+            c->res[c->rlen++] = '\n';
+        } else if (rc == 2) {
+            c->res[c->rlen++] = '\n';
+        } else {
+            memcpy(c->res + c->rlen, "error\n", 6);
+            c->rlen += 6;
+            c->errors++;
+        }
+        p = eol + 1;
+    }
+}
+
+static void *stream_worker(void *arg) {
+    stream_pool *sp = arg;
+    pthread_mutex_lock(&sp->lock);
+    while (1) {
+        while (sp->next_run == sp->next_read && !sp->stop)
+            pthread_cond_wait(&sp->work, &sp->lock);
+        if (sp->next_run == sp->next_read) break;
+        stream_chunk *c = &sp->slots[sp->next_run++ % sp->nslots];
+        pthread_mutex_unlock(&sp->lock);
+        stream_eval_chunk(c);
+        pthread_mutex_lock(&sp->lock);
+        c->done = 1;
+        pthread_cond_broadcast(&sp->finished);
+    }
+    pthread_mutex_unlock(&sp->lock);
+    return NULL;
+}
+
+/* Fills c with carry plus fresh input, cut after the last newline. Returns
+ * 0 at end of input when nothing is left, -1 on a read error. */
+static int stream_fill(stream_chunk *c, int fd, char **carry, size_t *carry_len, size_t *carry_cap, int *eof) {
+    c->len = 0;
+    if (!grow(&c->data, &c->cap, STREAM_CHUNK + *carry_len)) return -1;
+    memcpy(c->data, *carry, *carry_len);
+    c->len = *carry_len;
+    *carry_len = 0;
+    size_t cut = 0;
+    while (!*eof) {
+        if (c->len >= STREAM_CHUNK) {
+            char *nl = memrchr(c->data, '\n', c->len);
+            if (nl) { cut = nl + 1 - c->data; break; }
+        }
+        if (!grow(&c->data, &c->cap, c->len + STREAM_CHUNK)) return -1;
+        ssize_t r = read(fd, c->data + c->len, c->cap - c->len);
+        if (r < 0) { perror("read"); return -1; }
+        if (r == 0) *eof = 1;
+        c->len += r;
+    }
+    if (*eof) cut = c->len;
+    if (!grow(carry, carry_cap, c->len - cut)) return -1;
+    memcpy(*carry, c->data + cut, c->len - cut);
+    *carry_len = c->len - cut;
+    c->len = cut;
+    return cut > 0;
+}
+
+int default_threads(void) {
+    const char *env = getenv("OSHELL_THREADS");
+    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/* Returns the number of lines that failed, or -1 if the stream broke */
+long eval_stream(int fd, int out_fd, int nthreads) {
+    stream_pool sp = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                       NULL, 2 * nthreads + 2, 0, 0, 0 };
+    pthread_t *tids = calloc(nthreads, sizeof(pthread_t));
+    char *carry = NULL; size_t carry_len = 0, carry_cap = 0;
+    long long next_write = 0;
+    long errors = 0;
+    int eof = 0, failed = 0, started = 0;
+    out_buf out;
+
+    sp.slots = calloc(sp.nslots, sizeof(stream_chunk));
+    if (!tids || !sp.slots || !out_init(&out, out_fd, OUT_BUF_SIZE)) {
+        free(tids); free(sp.slots);
+        return -1;
+    }
+    for (; started < nthreads; started++)
+        if (pthread_create(&tids[started], NULL, stream_worker, &sp) != 0) break;
+    if (started == 0) failed = 1;
+
+    while (!failed) {
+        /* Keep every free slot filled so workers never wait on the reader */
+        while (!eof && sp.next_read - next_write < sp.nslots) {
+            stream_chunk *c = &sp.slots[sp.next_read % sp.nslots];
+            int rc = stream_fill(c, fd, &carry, &carry_len, &carry_cap, &eof);
+            if (rc < 0) { failed = 1; break; }
+            if (rc == 0) break;
+            pthread_mutex_lock(&sp.lock);
+            c->done = 0;
+            sp.next_read++;
+            pthread_cond_signal(&sp.work);
+            pthread_mutex_unlock(&sp.lock);
+        }
+        if (failed || next_write == sp.next_read) break;
+        stream_chunk *c = &sp.slots[next_write % sp.nslots];
+        pthread_mutex_lock(&sp.lock);
+        while (!c->done) pthread_cond_wait(&sp.finished, &sp.lock);
+        pthread_mutex_unlock(&sp.lock);
+        out_write(&out, c->res, c->rlen);
+        errors += c->errors;
+        next_write++;
+    }
+
+    pthread_mutex_lock(&sp.lock);
+    sp.stop = 1;
+    pthread_cond_broadcast(&sp.work);
+    pthread_mutex_unlock(&sp.lock);
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+    out_close(&out);
+    for (int i = 0; i < sp.nslots; i++) { free(sp.slots[i].data); free(sp.slots[i].res); }
+    free(sp.slots);
+    free(tids);
+    free(carry);
+    return failed || out.err ? -1 : errors;
+}
+
+/* Exact integers for expressions built only from integer literals and
+ * + - * ^ (no division, no variables). The double evaluator stays the
+ * fast path; this one is used when its result is too large to be exact.
+ * Evaluation runs in checked 64-bit arithmetic first and only reparses
+ * with big integers if something overflowed.
+ * Big integers are little-endian 64-bit limbs. Long products use
+ * Karatsuba; once operands reach EXP_THREAD_THRESHOLD limbs, the three
+ * half-size products of a split run on their own threads. */
+#define BIG_KARATSUBA_LIMBS 48
+#define BIG_MAX_BITS (1ULL << 23)    /* refuse results above 1 MiB, ~2.5M digits: seconds to print */
+
+typedef struct { uint64_t *d; size_t n; int neg; } bigint;   /* n == 0 is zero */
+
+typedef unsigned __int128 u128;
+
+/* r[0..na) = a + b, na >= nb; returns the carry out */
+static uint64_t limb_add(uint64_t *r, const uint64_t *a, size_t na, const uint64_t *b, size_t nb) {
+    uint64_t c = 0;
+    for (size_t i = 0; i < na; i++) {
+        u128 s = (u128)a[i] + (i < nb ? b[i] : 0) + c;
+        r[i] = (uint64_t)s;
+        c = (uint64_t)(s >> 64);
+    }
+    return c;
+}
+
+/* r[0..na) = a - b, na >= nb; returns the borrow out */
+static uint64_t limb_sub(uint64_t *r, const uint64_t *a, size_t na, const uint64_t *b, size_t nb) {
+    uint64_t br = 0;
+    for (size_t i = 0; i < na; i++) {
+        uint64_t bi = i < nb ? b[i] : 0;
+        uint64_t d = a[i] - bi - br;
+        br = (a[i] < bi) || (a[i] - bi < br);
+        r[i] = d;
+    }
+    return br;
+}
+
+/* r[0..na+nb) = a * b */
+static void limb_mul_school(uint64_t *r, const uint64_t *a, size_t na, const uint64_t *b, size_t nb) {
+    memset(r, 0, (na + nb) * sizeof(uint64_t));
+    for (size_t i = 0; i < na; i++) {
+        uint64_t c = 0;
+        for (size_t j = 0; j < nb; j++) {
+            u128 t = (u128)a[i] * b[j] + r[i + j] + c;
+            r[i + j] = (uint64_t)t;
+            c = (uint64_t)(t >> 64);
+        }
+        r[i + nb] = c;
+    }
+}
+
+static void limb_mul_n(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n, int threads);
+
+static void *limb_mul_thread(void *arg) {
+    thread_data *t = arg;
+    limb_mul_n(t->r, t->a, t->b, t->n, t->threads);
+    return NULL;
+}
+
+/* r[0..2n) = a * b for two n-limb operands (a == b squares) */
+static void limb_mul_n(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n, int threads) {
+    if (n < BIG_KARATSUBA_LIMBS) { limb_mul_school(r, a, n, b, n); return; }
+    size_t h = n / 2, m = n - h;
+    uint64_t *sa = malloc((m + 1) * sizeof(uint64_t));
+    uint64_t *sb = a == b ? sa : malloc((m + 1) * sizeof(uint64_t));
+    uint64_t *z1 = malloc(2 * (m + 1) * sizeof(uint64_t));
+    if (!sa || !sb || !z1) {            /* out of memory: fall back to no scratch at all */
+        free(sa); if (sb != sa) free(sb); free(z1);
+        limb_mul_school(r, a, n, b, n);
+        return;
+    }
+    sa[m] = limb_add(sa, a + h, m, a, h);
+    if (sb != sa) sb[m] = limb_add(sb, b + h, m, b, h);
+
+    /* z0 = a0*b0 -> r[0..2h), z2 = a1*b1 -> r[2h..2n), z1 = (a0+a1)(b0+b1) */
+    thread_data jobs[2] = {
+        { a, b, h, r, threads / 3 },
+        { a + h, b + h, m, r + 2 * h, threads / 3 },
+    };
+    pthread_t tids[2];
+    int spawned = 0;
+    if (threads > 1 && n >= EXP_THREAD_THRESHOLD) {
+        for (; spawned < 2; spawned++)
+            if (pthread_create(&tids[spawned], NULL, limb_mul_thread, &jobs[spawned]) != 0) break;
+    }
+    for (int i = spawned; i < 2; i++) limb_mul_thread(&jobs[i]);
+    limb_mul_n(z1, sa, sb, m + 1, spawned ? threads - 2 * (threads / 3) : threads);
+    for (int i = 0; i < spawned; i++) pthread_join(tids[i], NULL);
+
+    limb_sub(z1, z1, 2 * m + 2, r, 2 * h);
+    limb_sub(z1, z1, 2 * m + 2, r + 2 * h, 2 * m);
+    /* z1 < B^(2m+1), and the top of r has n + m >= 2m + 1 limbs above h */
+    uint64_t c = limb_add(r + h, r + h, 2 * m + 1, z1, 2 * m + 1);
+    for (size_t i = h + 2 * m + 1; c && i < 2 * n; i++) c = ++r[i] == 0;
+
+    free(z1);
+    if (sb != sa) free(sb);
+    free(sa);
+}
+
+/* r[0..na+nb) = a * b */
+static void limb_mul(uint64_t *r, const uint64_t *a, size_t na, const uint64_t *b, size_t nb, int threads) {
+    if (na < nb) { const uint64_t *t = a; a = b; b = t; size_t tn = na; na = nb; nb = tn; }
+    if (nb < BIG_KARATSUBA_LIMBS) { limb_mul_school(r, a, na, b, nb); return; }
+    if (na == nb) { limb_mul_n(r, a, b, na, threads); return; }
+    /* unbalanced: nb-limb slices of a, each a balanced product; a short
+     * last slice is multiplied as the smaller operand, not padded */
+    uint64_t *t = malloc(2 * nb * sizeof(uint64_t));
+    if (!t) { limb_mul_school(r, a, na, b, nb); return; }
+    memset(r, 0, (na + nb) * sizeof(uint64_t));
+    for (size_t off = 0; off < na; off += nb) {
+        size_t len = na - off < nb ? na - off : nb;
+        if (len == nb) limb_mul_n(t, a + off, b, nb, threads);
+        else limb_mul(t, b, nb, a + off, len, threads);
+        limb_add(r + off, r + off, na + nb - off, t, len + nb);
+    }
+    free(t);
+}
+
+static void big_norm(bigint *x) {
+    while (x->n > 0 && x->d[x->n - 1] == 0) x->n--;
+    if (x->n == 0) x->neg = 0;
+}
+
+void big_free(bigint *x) {
+    free(x->d);
+    x->d = NULL;
+    x->n = 0;
+}
+
+int big_set_i64(bigint *x, long long v) {
+    x->d = malloc(sizeof(uint64_t));
+    if (!x->d) return 0;
+    x->neg = v < 0;
+    x->d[0] = v < 0 ? -(uint64_t)v : (uint64_t)v;
+    x->n = 1;
+    big_norm(x);
+    return 1;
+}
+
+static int big_cmp_abs(const bigint *a, const bigint *b) {
+    if (a->n != b->n) return a->n < b->n ? -1 : 1;
+    for (size_t i = a->n; i-- > 0; )
+        if (a->d[i] != b->d[i]) return a->d[i] < b->d[i] ? -1 : 1;
+    return 0;
+}
+
+/* r = a + b, or a - b when sub is set; r must not alias a or b */
+int big_add(bigint *r, const bigint *a, const bigint *b, int sub) {
+    int bneg = b->neg ^ sub;
+    size_t n = (a->n > b->n ? a->n : b->n) + 1;
+    if (!(r->d = malloc(n * sizeof(uint64_t)))) return 0;
+    if (a->neg == bneg) {
+        const bigint *x = a->n >= b->n ? a : b, *y = x == a ? b : a;
+        r->d[x->n] = limb_add(r->d, x->d, x->n, y->d, y->n);
+        r->n = x->n + 1;
+        r->neg = a->neg;
+    } else if (big_cmp_abs(a, b) >= 0) {
+        limb_sub(r->d, a->d, a->n, b->d, b->n);
+        r->n = a->n;
+        r->neg = a->neg;
+    } else {
+        limb_sub(r->d, b->d, b->n, a->d, a->n);
+        r->n = b->n;
+        r->neg = bneg;
+    }
+    big_norm(r);
+    return 1;
+}
+
+int big_mul(bigint *r, const bigint *a, const bigint *b, int threads) {
+    if (a->n == 0 || b->n == 0) return big_set_i64(r, 0);
+    if (!(r->d = malloc((a->n + b->n) * sizeof(uint64_t)))) return 0;
+    limb_mul(r->d, a->d, a->n, b->d, b->n, threads);
+    r->n = a->n + b->n;
+    r->neg = a->neg ^ b->neg;
+    big_norm(r);
+    return 1;
+}
+
+static size_t big_bits(const bigint *x) {
+    return x->n ? 64 * (x->n - 1) + (64 - __builtin_clzll(x->d[x->n - 1])) : 0;
+}
+
+/* r = base^e by left-to-right square-and-multiply; a power of two is a
+ * shift. Returns 0 if out of memory or the result would exceed BIG_MAX_BITS. */
+int big_pow(bigint *r, const bigint *base, uint64_t e, int threads) {
+    size_t bits = big_bits(base);
+    if (e == 0 || bits <= 1) return big_set_i64(r, base->n == 0 && e ? 0 : base->neg && (e & 1) ? -1 : 1);
+    if (bits > BIG_MAX_BITS / e) return 0;
+    if (base->n == 1 && (base->d[0] & (base->d[0] - 1)) == 0) {
+        uint64_t shift = (uint64_t)__builtin_ctzll(base->d[0]) * e;
+        size_t n = shift / 64 + 1;
+        if (!(r->d = calloc(n, sizeof(uint64_t)))) return 0;
+        r->d[n - 1] = 1ULL << (shift % 64);
+        r->n = n;
+        r->neg = base->neg && (e & 1);
+        return 1;
+    }
+    bigint acc = { malloc(base->n * sizeof(uint64_t)), base->n, base->neg }, t;
+    if (!acc.d) return 0;
+    memcpy(acc.d, base->d, base->n * sizeof(uint64_t));
+    for (int i = 62 - __builtin_clzll(e); i >= 0; i--) {
+        if (!big_mul(&t, &acc, &acc, threads)) { big_free(&acc); return 0; }
+        big_free(&acc);
+        acc = t;
+        if ((e >> i) & 1) {
+            if (!big_mul(&t, &acc, base, threads)) { big_free(&acc); return 0; }
+            big_free(&acc);
+            acc = t;
+        }
+    }
+    *r = acc;
+    return 1;
+}
+
+/* r = d[0..n) * B^shift, B = 2^64, with the sign neg */
+static int big_limbs(bigint *r, const uint64_t *d, size_t n, size_t shift, int neg) {
+    if (!(r->d = calloc(n + shift + 1, sizeof(uint64_t)))) return 0;
+    if (n) memcpy(r->d + shift, d, n * sizeof(uint64_t));
+    r->n = n + shift;
+    r->neg = neg;
+    big_norm(r);
+    return 1;
+}
+
+/* x / B^k truncated toward zero */
+static int big_drop_limbs(bigint *r, const bigint *x, size_t k) {
+    return big_limbs(r, x->n > k ? x->d + k : x->d, x->n > k ? x->n - k : 0, 0, x->neg);
+}
+
+/* a = a + b, or a - b when sub is set */
+static int big_addto(bigint *a, const bigint *b, int sub) {
+    bigint t;
+    if (!big_add(&t, a, b, sub)) return 0;
+    big_free(a);
+    *a = t;
+    return 1;
+}
+
+/* Brings an approximate quotient q of a division by p and its remainder r
+ * to the exact pair: 0 <= r < p */
+static int big_settle(bigint *q, bigint *r, const bigint *p) {
+    bigint one = { (uint64_t[]){ 1 }, 1, 0 };
+    while (r->neg)
+        if (!big_addto(r, p, 0) || !big_addto(q, &one, 1)) return 0;
+    while (big_cmp_abs(r, p) >= 0)
+        if (!big_addto(r, p, 1) || !big_addto(q, &one, 0)) return 0;
+    return 1;
+}
+
+/* mu ~ floor(B^(2n) / p) for an n-limb p > 0, exact for a few limbs,
+ * which are divided bit by bit. Longer divisors take one Newton step,
+ * mu = x0 (2 - p x0 / B^(2n)), from the reciprocal of their top n/2 + 2
+ * limbs, which leaves mu off by a few units; big_divmod() settles its
+ * quotients anyway. */
+#define BIG_RECIP_LIMBS 8
+
+static int big_recip(bigint *mu, const bigint *p, int threads) {
+    size_t n = p->n;
+    if (n <= BIG_RECIP_LIMBS) {
+        uint64_t *q = calloc(2 * n + 1, sizeof(uint64_t)), rem[BIG_RECIP_LIMBS + 1] = { 0 };
+        if (!q) return 0;
+        for (long i = 128L * n; i >= 0; i--) {
+            uint64_t c = i == (long)(128 * n);    /* the single set bit of B^(2n) */
+            for (size_t j = 0; j <= n; j++) {
+                uint64_t top = rem[j] >> 63;
+                rem[j] = rem[j] << 1 | c;
+                c = top;
+            }
+            int ge = rem[n] != 0;
+            if (!ge) {
+                size_t j = n;
+                while (j-- > 0 && rem[j] == p->d[j]) ;
+                ge = j == (size_t)-1 || rem[j] > p->d[j];
+            }
+            if (ge) {
+                limb_sub(rem, rem, n + 1, p->d, n);
+                q[i / 64] |= 1ULL << (i % 64);
+            }
+        }
+        *mu = (bigint){ q, 2 * n + 1, 0 };
+        big_norm(mu);
+        return 1;
+    }
+    /* t ~ B^(2h) / top, x0 = t B^(n-h); with f = p t - B^(n+h) the step
+     * x0 p x0 / B^(2n) - x0 comes to t f / B^(2h), of which only f's top
+     * h + 2 limbs matter */
+    size_t h = n / 2 + 2;
+    bigint top = { p->d + n - h, h, 0 }, t = { NULL, 0, 0 }, f = { NULL, 0, 0 }, bnh = { NULL, 0, 0 };
+    bigint ft = { NULL, 0, 0 }, c = { NULL, 0, 0 }, step = { NULL, 0, 0 };
+    uint64_t one = 1;
+    if (!big_recip(&t, &top, threads)) return 0;
+    size_t drop = 0;
+    int ok = big_limbs(&bnh, &one, 1, n + h, 0) && big_mul(&f, p, &t, threads) && big_addto(&f, &bnh, 1);
+    if (ok && f.n > h + 2) drop = f.n - (h + 2);
+    ok = ok && big_drop_limbs(&ft, &f, drop) && big_mul(&c, &t, &ft, threads) &&
+         big_drop_limbs(&step, &c, 2 * h - drop) && big_limbs(mu, t.d, t.n, n - h, 0);
+    if (ok && !big_addto(mu, &step, 1)) { big_free(mu); ok = 0; }
+    big_free(&t);
+    big_free(&f);
+    big_free(&bnh);
+    big_free(&ft);
+    big_free(&c);
+    big_free(&step);
+    return ok;
+}
+
+/* q, r = x / p, x % p for 0 <= x < B^(2n), p of n limbs, mu = big_recip(p);
+ * Barrett's estimate is at most two below q */
+static int big_divmod(bigint *q, bigint *r, const bigint *x, const bigint *p, const bigint *mu, int threads) {
+    size_t n = p->n;
+    bigint t = { NULL, 0, 0 }, u = { NULL, 0, 0 };
+    *q = *r = (bigint){ NULL, 0, 0 };
+    int ok = big_drop_limbs(&t, x, n - 1) && big_mul(&u, &t, mu, threads) && big_drop_limbs(q, &u, n + 1);
+    big_free(&t);
+    big_free(&u);
+    ok = ok && big_mul(&t, q, p, threads) && big_add(r, x, &t, 1) && big_settle(q, r, p);
+    big_free(&t);
+    if (!ok) { big_free(q); big_free(r); }
+    return ok;
+}
+
+/* Decimal conversion divides x by 10^(19 * 2^k) for the largest k that
+ * splits it into two halves and converts each half the same way, so the
+ * cost is a few products of each size rather than one division by 10^19
+ * per 19 digits. Below 10^(19 * 2^BIG_DEC_LEAF) the chunk loop is cheaper. */
+#define BIG_DEC_CHUNK  10000000000000000000ULL     /* 10^19, the most a limb holds */
+#define BIG_DEC_LEAF   4
+#define BIG_DEC_LEVELS 40
+
+typedef struct {
+    bigint pow[BIG_DEC_LEVELS];   /* 10^(19 * 2^k) */
+    bigint mu[BIG_DEC_LEVELS];    /* big_recip(pow[k]) for k >= BIG_DEC_LEAF */
+    int threads, err;
+} big_dec;
+
+static void dec19(char *p, uint64_t v) {
+    for (int i = 18; i >= 0; i--, v /= 10) p[i] = '0' + v % 10;
+}
+
+/* x < 10^(19 * 2^BIG_DEC_LEAF) by repeated division by 10^19: width
+ * digits zero-padded, or as few as it takes when width is 0 */
+static char *big_dec_chunks(const bigint *x, size_t width, char *p) {
+    uint64_t t[1 << BIG_DEC_LEAF], parts[1 << BIG_DEC_LEAF];
+    size_t n = x->n, nparts = 0;
+    memcpy(t, x->d, n * sizeof(uint64_t));
+    while (n > 0) {
+        uint64_t rem = 0;
+        for (size_t i = n; i-- > 0; ) {
+            u128 cur = ((u128)rem << 64) | t[i];
+            t[i] = (uint64_t)(cur / BIG_DEC_CHUNK);
+            rem = (uint64_t)(cur % BIG_DEC_CHUNK);
+        }
+        parts[nparts++] = rem;
+        while (n > 0 && t[n - 1] == 0) n--;
+    }
+    if (width) {
+        memset(p, '0', width);
+        for (size_t i = 0; i < nparts; i++) dec19(p + width - 19 * (i + 1), parts[i]);
+        return p + width;
+    }
+    char lead[20];
+    int len = 0;
+    uint64_t v = nparts ? parts[nparts - 1] : 0;
+    do lead[len++] = '0' + v % 10; while (v /= 10);
+    while (len > 0) *p++ = lead[--len];
+    for (size_t i = nparts > 0 ? nparts - 1 : 0; i-- > 0; p += 19) dec19(p, parts[i]);
+    return p;
+}
+
+/* Writes x < pow[k]^2 at p: 19 * 2^(k+1) digits when pad is set, without
+ * leading zeros otherwise. Returns the end. */
+static char *big_dec_rec(big_dec *bd, const bigint *x, int k, int pad, char *p) {
+    if (k < BIG_DEC_LEAF) return big_dec_chunks(x, pad ? (size_t)19 << (k + 1) : 0, p);
+    bigint q, r;
+    if (bd->err || !big_divmod(&q, &r, x, &bd->pow[k], &bd->mu[k], bd->threads)) { bd->err = 1; return p; }
+    if (!pad && q.n == 0) {
+        p = big_dec_rec(bd, &r, k - 1, 0, p);
+    } else {
+        p = big_dec_rec(bd, &q, k - 1, pad, p);
+        p = big_dec_rec(bd, &r, k - 1, 1, p);
+    }
+    big_free(&q);
+    big_free(&r);
+    return p;
+}
+
+/* Decimal digits of x; caller frees */
+char *big_to_string(const bigint *x, int threads) {
+    big_dec bd = { .threads = threads };
+    uint64_t chunk = BIG_DEC_CHUNK;
+    size_t bits = big_bits(x);
+    bigint ax = { x->d, x->n, 0 };
+    char *s = malloc(x->n * 20 + 3), *p = s;
+    int k = 0, levels = 0;
+    if (!s || !big_limbs(&bd.pow[0], &chunk, 1, 0, 0)) { free(s); return NULL; }
+    /* the smallest k with x < pow[k]^2; the divisors below it and their reciprocals */
+    for (levels = 1; 2 * (big_bits(&bd.pow[k]) - 1) < bits; k++, levels++)
+        if (!big_mul(&bd.pow[k + 1], &bd.pow[k], &bd.pow[k], threads)) { bd.err = 1; break; }
+    for (int i = BIG_DEC_LEAF; !bd.err && i <= k; i++)
+        if (!big_recip(&bd.mu[i], &bd.pow[i], threads)) bd.err = 1;
+    if (x->neg) *p++ = '-';
+    if (!bd.err) p = big_dec_rec(&bd, &ax, k, 0, p);
+    *p = '\0';
+    for (int i = 0; i < levels; i++) {
+        big_free(&bd.pow[i]);
+        big_free(&bd.mu[i]);
+    }
+    if (bd.err) { free(s); return NULL; }
+    return s;
+}
+
+typedef struct {
+    const char *p;
+    int big;          /* 0: checked 64-bit pass, 1: bigint pass */
+    int err;          /* not an exact integer expression (or out of memory) */
+    int overflow;     /* the 64-bit pass overflowed */
+    int nest, threads;
+} exact_parser;
+
+typedef struct { long long v; bigint b; } exact_val;
+
+static void exact_sum(exact_parser *ps, exact_val *out);
+static void exact_unary(exact_parser *ps, exact_val *out);
+
+static void exact_free(exact_parser *ps, exact_val *v) {
+    if (ps->big) big_free(&v->b);
+}
+
+/* out = a OP b for '+', '-', '*'; consumes a and b */
+static void exact_binop(exact_parser *ps, int op, exact_val *a, exact_val *b, exact_val *out) {
+    if (!ps->big) {
+        long long r = 0;
+        int o = op == '+' ? __builtin_add_overflow(a->v, b->v, &r)
+              : op == '-' ? __builtin_sub_overflow(a->v, b->v, &r)
+              : __builtin_mul_overflow(a->v, b->v, &r);
+        if (o) ps->overflow = 1;
+        out->v = r;
+        return;
+    }
+    bigint r = { NULL, 0, 0 };
+    if (!(op == '*' ? big_mul(&r, &a->b, &b->b, ps->threads) : big_add(&r, &a->b, &b->b, op == '-')))
+        ps->err = 1;
+    big_free(&a->b);
+    big_free(&b->b);
+    out->b = r;
+}
+
+static void exact_primary(exact_parser *ps, exact_val *out) {
+    memset(out, 0, sizeof(*out));
+    while (isspace((unsigned char)*ps->p)) ps->p++;
+    if (*ps->p == '(') {
+        ps->p++;
+        exact_sum(ps, out);
+        while (isspace((unsigned char)*ps->p)) ps->p++;
+        if (*ps->p != ')') ps->err = 1;
+        else ps->p++;
+        return;
+    }
+    if (!isdigit((unsigned char)*ps->p)) { ps->err = 1; return; }
+    long long v = 0;
+    bigint ten = { (uint64_t[]){ 10 }, 1, 0 }, acc, digit, t;
+    if (ps->big && !big_set_i64(&acc, 0)) { ps->err = 1; return; }
+    for (; isdigit((unsigned char)*ps->p); ps->p++) {
+        int d = *ps->p - '0';
+        if (!ps->big) {
+            if (__builtin_mul_overflow(v, 10, &v) || __builtin_add_overflow(v, d, &v)) ps->overflow = 1;
+        } else if (big_mul(&t, &acc, &ten, 1) && big_set_i64(&digit, d)) {
+            big_free(&acc);
+            if (!big_add(&acc, &t, &digit, 0)) { ps->err = 1; acc.d = NULL; }
+            big_free(&t);
+            big_free(&digit);
+        } else {
+            ps->err = 1;
+        }
+        if (ps->err) break;
+    }
+    /* 1.5, 1e3 and 0x10 are not integer literals */
+    if (*ps->p == '.' || *ps->p == 'e' || *ps->p == 'E' || isalpha((unsigned char)*ps->p)) ps->err = 1;
+    out->v = v;
+    if (ps->big) out->b = acc;
+}
+
+static void exact_power(exact_parser *ps, exact_val *out) {
+    exact_primary(ps, out);
+    while (isspace((unsigned char)*ps->p)) ps->p++;
+    if (ps->err || *ps->p != '^') return;
+    ps->p++;
+    exact_val e;
+    exact_unary(ps, &e);
+    if (ps->err) { exact_free(ps, &e); return; }
+    long long ev = e.v;
+    if (ps->big) {
+        /* an exponent past 64 bits could only give a result past BIG_MAX_BITS */
+        if (e.b.neg || e.b.n > 1) ps->err = 1;
+        ev = e.b.n ? (long long)e.b.d[0] : 0;
+        big_free(&e.b);
+    }
+    if (ev < 0) ps->err = 1;                 /* reciprocal: not an integer */
+    if (ps->err) return;
+    if (!ps->big) {
+        long long r = 1, b = out->v;
+        for (unsigned long long k = ev; k && !ps->overflow; k >>= 1) {
+            if ((k & 1) && __builtin_mul_overflow(r, b, &r)) ps->overflow = 1;
+            if (k > 1 && __builtin_mul_overflow(b, b, &b)) ps->overflow = 1;
+        }
+        out->v = r;
+        return;
+    }
+    bigint r;
+    if (!big_pow(&r, &out->b, (uint64_t)ev, ps->threads)) ps->err = 1;
+    big_free(&out->b);
+    out->b = ps->err ? (bigint){ NULL, 0, 0 } : r;
+}
+
+static void exact_unary(exact_parser *ps, exact_val *out) {
+    if (++ps->nest > EXPR_NEST_MAX) { ps->err = 1; memset(out, 0, sizeof(*out)); return; }
+    while (isspace((unsigned char)*ps->p)) ps->p++;
+    if (*ps->p == '-' || *ps->p == '+') {
+        int neg = *ps->p++ == '-';
+        exact_unary(ps, out);
+        if (neg && !ps->big && __builtin_sub_overflow(0, out->v, &out->v)) ps->overflow = 1;
+        if (neg && ps->big && out->b.n) out->b.neg ^= 1;
+    } else {
+        exact_power(ps, out);
+    }
+    ps->nest--;
+}
+
+static void exact_term(exact_parser *ps, exact_val *out) {
+    exact_unary(ps, out);
+    while (isspace((unsigned char)*ps->p)) ps->p++;
+    while (!ps->err && *ps->p == '*') {
+        exact_val b;
+        ps->p++;
+        exact_unary(ps, &b);
+        exact_binop(ps, '*', out, &b, out);
+        while (isspace((unsigned char)*ps->p)) ps->p++;
+    }
+}
+
+static void exact_sum(exact_parser *ps, exact_val *out) {
+    if (++ps->nest > EXPR_NEST_MAX) { ps->err = 1; memset(out, 0, sizeof(*out)); return; }
+    exact_term(ps, out);
+    while (isspace((unsigned char)*ps->p)) ps->p++;
+    while (!ps->err && (*ps->p == '+' || *ps->p == '-')) {
+        exact_val b;
+        int op = *ps->p++;
+        exact_term(ps, &b);
+        exact_binop(ps, op, out, &b, out);
+        while (isspace((unsigned char)*ps->p)) ps->p++;
+    }
+    ps->nest--;
+}
+
+/* Exact decimal value of an integer-only expression, or NULL if expr has
+ * anything else in it (or the result is too large). Caller frees. */
+char *eval_exact(const char *expr, int threads) {
+    exact_parser ps = { expr, 0, 0, 0, 0, threads };
+    exact_val v;
+    char *s = NULL;
+    exact_sum(&ps, &v);
+    if (ps.err || *ps.p != '\0') return NULL;
+    if (!ps.overflow) {
+        if ((s = malloc(24)) != NULL) snprintf(s, 24, "%lld", v.v);
+        return s;
+    }
+    ps = (exact_parser){ expr, 1, 0, 0, 0, threads };
+    exact_sum(&ps, &v);
+    if (!ps.err) s = big_to_string(&v.b, threads);
+    big_free(&v.b);
+    return s;
+}
+
+/* The exact digits -e prints for expr when its evaluation was wide (some
+ * value reached 2^53, so the double may be rounded, even when the result
+ * is small as in 2^60+1-2^60) and the result is an integer; NULL when
+ * num_format() is what it prints. Caller frees. */
+char *exact_digits(const char *expr, int wide, int threads) {
+    return wide ? eval_exact(expr, threads) : NULL;
+}
+
+/* Writes the line -e prints for a value to o */
+void out_value(out_buf *o, const char *expr, double r, int wide) {
+    char *s = exact_digits(expr, wide, 1);
+    if (!s) { out_double(o, r); return; }
+    out_write(o, s, strlen(s));
+    out_write(o, "\n", 1);
+    free(s);
+}
+
+/* Prints what -e and the prompt show for a value */
+void print_value(const char *prefix, const char *expr, double r, int wide) {
+    char *s = exact_digits(expr, wide, default_threads());
+    if (s) printf("%s%s\n", prefix, s);
+    else {
+        char num[NUM_FORMAT_MAX];
+        size_t n = num_format(r, num);
+        num[n++] = '\n';
+        fputs(prefix, stdout);
+        fwrite(num, 1, n, stdout);
+    }
+    free(s);
+}
+
+/* Spawn engine: every pipeline stage goes through spawn_command(). The child
+ * only has to dup2 its pipe / redirect fds onto 0 and 1 and exec; pipes are
+ * created O_CLOEXEC and redirect files are opened by the parent, so nothing
+ * else needs closing. The path to exec is resolved by the caller. Exec
+ * failures come back to the parent as errno for every engine.
+ * OSHELL_SPAWN=fork|vfork|clone|posix_spawn picks the engine. */
+enum { SPAWN_FORK, SPAWN_VFORK, SPAWN_CLONE, SPAWN_POSIX, SPAWN_ENGINES };
+static const char *const spawn_names[SPAWN_ENGINES] = { "fork", "vfork", "clone", "posix_spawn" };
+int spawn_engine = SPAWN_POSIX;
+
+/* Signals the shell catches or ignores; children get them back at SIG_DFL */
+static const int shell_signals[] = { SIGINT, SIGPIPE, SIGCHLD, SIGTSTP, SIGUSR1 };
+
+#define CLONE_STACK_SIZE (64 * 1024)
+
+extern char **environ;
+
+typedef struct {
+    const char *path;             /* absolute or relative path, no PATH search */
+    char **argv;
+    int in_fd, out_fd, err_fd;    /* become the child's stdin/stdout/stderr, -1 = inherit */
+    sigset_t mask;                /* signal mask to restore in the child */
+    volatile int err;             /* written by a CLONE_VM child before _exit */
+} spawn_req;
+
+void select_spawn_engine(const char *name) {
+    for (int i = 0; name && i < SPAWN_ENGINES; i++) {
+        if (strcmp(name, spawn_names[i]) == 0) { spawn_engine = i; return; }
+    }
+    if (name) fprintf(stderr, "Unknown spawn engine '%s', using %s\n", name, spawn_names[spawn_engine]);
+}
+
+/* Runs in the child for fork/vfork/clone; only async-signal-safe calls */
+static int child_exec(spawn_req *req) {
+    for (size_t i = 0; i < sizeof(shell_signals) / sizeof(shell_signals[0]); i++)
+        signal(shell_signals[i], SIG_DFL);
+    sigprocmask(SIG_SETMASK, &req->mask, NULL);
+    if (req->in_fd >= 0 && dup2(req->in_fd, 0) < 0) return errno;
+    if (req->out_fd >= 0 && dup2(req->out_fd, 1) < 0) return errno;
+    if (req->err_fd >= 0 && dup2(req->err_fd, 2) < 0) return errno;
+    execv(req->path, req->argv);
+    return errno;
+}
+
+static int clone_child(void *arg) {
+    spawn_req *req = arg;
+    req->err = child_exec(req);
+    _exit(127);
+}
+
+static pid_t spawn_fork(spawn_req *req) {
+    int errpipe[2], err = 0;
+    if (pipe2(errpipe, O_CLOEXEC) < 0) return -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        err = child_exec(req);
+        if (write(errpipe[1], &err, sizeof(err)) < 0) _exit(126);
+        _exit(127);
+    }
+    close(errpipe[1]);
+    /* EOF means exec succeeded and closed the CLOEXEC write end */
+    if (pid > 0 && read(errpipe[0], &err, sizeof(err)) == sizeof(err)) {
+        waitpid(pid, NULL, 0);
+        errno = err;
+        pid = -1;
+    }
+    close(errpipe[0]);
+    return pid;
+}
+
+static pid_t spawn_vfork(spawn_req *req) {
+    req->err = 0;
+    pid_t pid = vfork();
+    if (pid == 0) {
+        req->err = child_exec(req);
+        _exit(127);
+    }
+    return pid;
+}
+
+static pid_t spawn_clone(spawn_req *req) {
+    static __thread char *stack;
+    if (!stack && (stack = malloc(CLONE_STACK_SIZE)) == NULL) return -1;
+    req->err = 0;
+    return clone(clone_child, stack + CLONE_STACK_SIZE, CLONE_VM | CLONE_VFORK | SIGCHLD, req);
+}
+
+static pid_t spawn_posix(spawn_req *req) {
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    sigset_t def;
+    pid_t pid;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawnattr_init(&attr);
+    if (req->in_fd >= 0) posix_spawn_file_actions_adddup2(&fa, req->in_fd, 0);
+    if (req->out_fd >= 0) posix_spawn_file_actions_adddup2(&fa, req->out_fd, 1);
+    if (req->err_fd >= 0) posix_spawn_file_actions_adddup2(&fa, req->err_fd, 2);
+    sigemptyset(&def);
+    for (size_t i = 0; i < sizeof(shell_signals) / sizeof(shell_signals[0]); i++)
+        sigaddset(&def, shell_signals[i]);
+    posix_spawnattr_setsigdefault(&attr, &def);
+    posix_spawnattr_setsigmask(&attr, &req->mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+    int rc = posix_spawn(&pid, req->path, &fa, &attr, req->argv, environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fa);
+    if (rc != 0) { errno = rc; return -1; }
+    return pid;
+}
+
+/* Execs path with argv and the given stdin/stdout/stderr (-1 = inherit).
+ * Returns the pid, or -1 with errno set if the process could not be created
+ * or exec failed. */
+pid_t spawn_command(const char *path, char **argv, int in_fd, int out_fd, int err_fd) {
+    spawn_req req = { .path = path, .argv = argv, .in_fd = in_fd, .out_fd = out_fd, .err_fd = err_fd };
+    sigset_t all;
+    pid_t pid;
+    int err;
+    /* The vfork/clone child borrows our memory; keep handlers out of it */
+    sigfillset(&all);
+    sigprocmask(SIG_BLOCK, &all, &req.mask);
+    switch (spawn_engine) {
+        case SPAWN_VFORK: pid = spawn_vfork(&req); break;
+        case SPAWN_CLONE: pid = spawn_clone(&req); break;
+        case SPAWN_POSIX: pid = spawn_posix(&req); break;
+        default:          pid = spawn_fork(&req); break;
+    }
+    err = errno;
+    if (pid > 0 && req.err) {
+        waitpid(pid, NULL, 0);
+        err = req.err;
+        pid = -1;
+    }
+    sigprocmask(SIG_SETMASK, &req.mask, NULL);
+    errno = err;
+    return pid;
+}
+
+/* Command location cache, like bash's `hash`: names are resolved against
+ * $PATH once in the shell and children exec the absolute path directly, so
+ * they skip the failing execve per PATH directory and a missing command
+ * fails before anything is spawned. The table is dropped whenever PATH
+ * changes, and an entry is dropped when exec on it reports ENOENT. */
+#define PATH_CACHE_SLOTS 256
+
+typedef struct path_entry {
+    char *name, *path;
+    unsigned hits;
+    struct path_entry *next;
+} path_entry;
+
+static path_entry *path_cache[PATH_CACHE_SLOTS];
+static char *path_cache_env;     /* PATH the entries were resolved against */
+static pthread_mutex_t path_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned name_hash(const char *s, unsigned seed) {
+    unsigned h = 2166136261u ^ seed;
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h ^ (h >> 15);
+}
+
+static void path_cache_clear_locked(void) {
+    for (int i = 0; i < PATH_CACHE_SLOTS; i++) {
+        while (path_cache[i]) {
+            path_entry *e = path_cache[i];
+            path_cache[i] = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+        }
+    }
+}
+
+void path_cache_clear(void) {
+    pthread_mutex_lock(&path_cache_lock);
+    path_cache_clear_locked();
+    pthread_mutex_unlock(&path_cache_lock);
+}
+
+void path_cache_forget(const char *name) {
+    pthread_mutex_lock(&path_cache_lock);
+    for (path_entry **pe = &path_cache[name_hash(name, 0) % PATH_CACHE_SLOTS]; *pe; pe = &(*pe)->next) {
+        if (strcmp((*pe)->name, name) == 0) {
+            path_entry *e = *pe;
+            *pe = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&path_cache_lock);
+}
+
+/* Walks PATH like execvp: empty entries mean the current directory */
+static char *search_path(const char *name, const char *path) {
+    size_t nlen = strlen(name);
+    for (const char *p = path; ; p++) {
+        const char *end = strchrnul(p, ':');
+        size_t dlen = end - p;
+        char *full = malloc(dlen + nlen + 3);
+        struct stat sb;
+        if (!full) return NULL;
+        if (dlen == 0) { full[0] = '.'; dlen = 1; }
+        else memcpy(full, p, dlen);
+        full[dlen] = '/';
+        memcpy(full + dlen + 1, name, nlen + 1);
+        if (stat(full, &sb) == 0 && S_ISREG(sb.st_mode) && access(full, X_OK) == 0) return full;
+        free(full);
+        if (*end == '\0') return NULL;
+        p = end;
+    }
+}
+
+/* Returns a malloc'd path to exec for name, or NULL if it is not in PATH.
+ * Names containing a slash are used as given. */
+char *resolve_command(const char *name) {
+    if (strchr(name, '/')) return strdup(name);
+    const char *path = getenv("PATH");
+    if (!path) path = "/usr/local/bin:/usr/bin:/bin";
+    char *found = NULL;
+    pthread_mutex_lock(&path_cache_lock);
+    if (!path_cache_env || strcmp(path_cache_env, path) != 0) {
+        path_cache_clear_locked();
+        free(path_cache_env);
+        path_cache_env = strdup(path);
+    }
+    unsigned slot = name_hash(name, 0) % PATH_CACHE_SLOTS;
+    for (path_entry *e = path_cache[slot]; e; e = e->next) {
+        if (strcmp(e->name, name) == 0) {
+            e->hits++;
+            found = strdup(e->path);
+            break;
+        }
+    }
+    if (!found && (found = search_path(name, path)) != NULL) {
+        path_entry *e = malloc(sizeof(*e));
+        if (e && (e->name = strdup(name)) && (e->path = strdup(found))) {
+            e->hits = 1;
+            e->next = path_cache[slot];
+            path_cache[slot] = e;
+        } else if (e) {
+            free(e->name);
+            free(e);
+        }
+    }
+    pthread_mutex_unlock(&path_cache_lock);
+    return found;
+}
+
+/* Resolves argv[0] through the cache and spawns it. A stale entry that exec
+ * rejects with ENOENT is forgotten and the lookup retried once. */
+pid_t spawn_resolved(char **argv, int in_fd, int out_fd, int err_fd) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        char *path = resolve_command(argv[0]);
+        if (!path) { errno = ENOENT; return -1; }
+        pid_t pid = spawn_command(path, argv, in_fd, out_fd, err_fd);
+        int err = errno;
+        free(path);
+        if (pid > 0 || err != ENOENT || strchr(argv[0], '/')) { errno = err; return pid; }
+        path_cache_forget(argv[0]);
+        errno = err;
+    }
+    return -1;
+}
+
+/* In-process data path. move_data() shifts bytes between two fds without
+ * bringing them into user memory where the kernel allows it: sendfile()
+ * from regular files, splice() whenever one side is a pipe, and a plain
+ * read/write loop only for the rest (ttys, sockets to sockets, ...).
+ * Pipe capacity is raised with F_SETPIPE_SZ when a pipe size is set. */
+#define MOVE_CHUNK (1 << 20)
+#define COPY_BUF   (64 * 1024)
+
+int pipe_size = 0;               /* session default for new pipes, 0 = kernel default */
+
+/* Applies size to the pipe behind fd; warns once if the kernel refuses */
+void set_pipe_size(int fd, int size) {
+    static int warned;
+    if (size > 0 && fcntl(fd, F_SETPIPE_SZ, size) < 0 && !warned++)
+        fprintf(stderr, "pipesize: cannot set %d bytes: %s\n", size, strerror(errno));
+}
+
+static long long copy_data(int in, int out) {
+    char buf[COPY_BUF];
+    long long total = 0;
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) > 0) {
+        for (ssize_t off = 0; off < n; ) {
+            ssize_t w = write(out, buf + off, n - off);
+            if (w < 0) return -1;
+            off += w;
+        }
+        total += n;
+    }
+    return n < 0 ? -1 : total;
+}
+
+/* Returns the number of bytes moved, or -1 on error */
+long long move_data(int in, int out) {
+    struct stat si, so;
+    long long total = 0;
+    ssize_t n;
+    if (fstat(in, &si) < 0 || fstat(out, &so) < 0) return -1;
+    int in_pipe = S_ISFIFO(si.st_mode), out_pipe = S_ISFIFO(so.st_mode);
+
+    if (S_ISREG(si.st_mode) && !out_pipe) {
+        while ((n = sendfile(out, in, NULL, MOVE_CHUNK)) > 0) total += n;
+        if (n == 0) return total;
+        if (total > 0 || (errno != EINVAL && errno != ENOSYS)) return -1;
+    } else if (in_pipe || (out_pipe && S_ISREG(si.st_mode))) {
+        /* never from a terminal: splicing a line that is already queued
+         * blocks for more input instead of returning it */
+        while ((n = splice(in, NULL, out, NULL, MOVE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE)) > 0) total += n;
+        if (n == 0) return total;
+        if (total > 0 || (errno != EINVAL && errno != ENOSYS)) return -1;
+    }
+    return copy_data(in, out);
+}
+
+/* Tracing: always-on timings of what the command loop runs, kept in a
+ * fixed ring of the last TRACE_RING events. A writer claims a slot with one
+ * atomic increment and publishes it by storing the slot's sequence number
+ * last, so recording never waits; a reader copies a slot and keeps it only
+ * if the sequence matched before and after the copy. A writer preempted for
+ * a whole lap of the ring can lose its event. Times are raw TSC
+ * ticks on x86 (CLOCK_MONOTONIC ns elsewhere) and become ns when read.
+ * Events:
+ *   parse     parse_pipeline() of one command line
+ *   spawn     one posix_spawn/fork/clone of an external stage
+ *   exec      pipeline start to the first stage running
+ *   stage     one stage, start to exit, with user + system time
+ *   pipeline  one foreground pipeline, start to the last stage's exit
+ * OSHELL_TRACE=0 turns recording off. */
+#define TRACE_RING 16384          /* events, a power of two */
+#define TRACE_NAME 24
+#define TRACE_NO_CPU UINT64_MAX   /* in-process stages share the shell's CPU time */
+
+enum { TRACE_PARSE, TRACE_SPAWN, TRACE_EXEC, TRACE_STAGE, TRACE_PIPELINE, TRACE_KINDS };
+static const char *const trace_kinds[TRACE_KINDS] = { "parse", "spawn", "exec", "stage", "pipeline" };
+
+typedef struct {
+    uint64_t seq;                 /* ring index + 1 once the slot is complete */
+    uint64_t start, ticks;        /* clock ticks */
+    uint64_t cpu_ns;
+    int kind;
+    char name[TRACE_NAME];
+} trace_event;
+
+static struct {
+    trace_event *ev;              /* TRACE_RING slots, mapped by trace_init */
+    uint64_t head;                /* next ring index to claim */
+    uint64_t since;               /* stats -r: indices below this are ignored */
+    uint64_t base_ticks;          /* a (ticks, ns) pair to convert ticks from */
+    int64_t base_ns;
+    double scale;                 /* ns per tick once calibrated, else 0 */
+} trace;
+static int trace_enabled;        /* set by trace_init once the ring is mapped */
+static char trace_path[256];      /* JSON dump file */
+
+static int64_t trace_mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static inline uint64_t trace_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)trace_mono_ns();
+#endif
+}
+
+/* What the hooks read: 0 when recording is off, so they cost a branch */
+static inline uint64_t trace_tick(void) {
+    return trace_enabled ? trace_now() : 0;
+}
+
+/* Sets trace.scale, ns per tick, from the span since the base pair once
+ * that span is 10 ms, so the ratio is good to about 1e-4. With wait, sleeps
+ * until it is; without, leaves it unset until a later call. Never called
+ * from the signal handler. */
+static void trace_calibrate(int wait) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (trace.scale) return;
+    if (!trace.base_ticks) {
+        trace.base_ns = trace_mono_ns();
+        trace.base_ticks = trace_now();
+    }
+    int64_t ns = trace_mono_ns() - trace.base_ns;
+    if (ns < 10000000) {
+        struct timespec d = { 0, 10000000 - ns };
+        if (!wait) return;
+        while (nanosleep(&d, &d) < 0 && errno == EINTR) { }
+    }
+    ns = trace_mono_ns() - trace.base_ns;
+    uint64_t ticks = trace_now() - trace.base_ticks;
+    double scale = ticks ? (double)ns / ticks : 1.0;
+    __atomic_store(&trace.scale, &scale, __ATOMIC_RELEASE);
+#else
+    (void)wait;
+#endif
+}
+
+static double trace_scale(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    trace_calibrate(1);
+    return trace.scale;
+#else
+    return 1.0;
+#endif
+}
+
+/* trace_scale() for the SIGUSR1 handler: it only reads. Before the shell
+ * has calibrated, the ratio over the span so far stands in. */
+static double trace_scale_peek(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    double scale;
+    __atomic_load(&trace.scale, &scale, __ATOMIC_ACQUIRE);
+    if (scale) return scale;
+    int64_t ns = trace_mono_ns() - trace.base_ns;
+    uint64_t ticks = trace_now() - trace.base_ticks;
+    return trace.base_ticks && ticks && ns > 0 ? (double)ns / ticks : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
+/* Maps the ring when recording is on; the one-shot modes never call this,
+ * so they do not map it */
+void trace_init(void) {
+    const char *env = getenv("OSHELL_TRACE"), *dump = getenv("OSHELL_TRACE_DUMP");
+    trace_enabled = !env || atoi(env) != 0;
+    if (trace_enabled && !trace.ev) {
+        void *ring = mmap(NULL, TRACE_RING * sizeof(trace_event), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        trace.ev = ring == MAP_FAILED ? NULL : ring;
+        trace_enabled = trace.ev != NULL;
+    }
+    trace.base_ns = trace_mono_ns();
+    trace.base_ticks = trace_now();
+    trace.scale = 0;
+    if (dump && *dump) snprintf(trace_path, sizeof(trace_path), "%s", dump);
+    else snprintf(trace_path, sizeof(trace_path), "/tmp/oshell-trace-%d.json", (int)getpid());
+}
+
+/* Records one event; name is reduced to its last path component */
+void trace_record(int kind, const char *name, uint64_t start, uint64_t end, uint64_t cpu_ns) {
+    if (!trace_enabled) return;
+    uint64_t i = __atomic_fetch_add(&trace.head, 1, __ATOMIC_RELAXED);
+    trace_event *e = &trace.ev[i & (TRACE_RING - 1)];
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->start = start;
+    e->ticks = end - start;
+    e->cpu_ns = cpu_ns;
+    e->kind = kind;
+    int n = 0;
+    for (const char *c = name; c && *c; c++) {
+        if (*c == '/' && c[1]) n = 0;
+        else if (n < TRACE_NAME - 1) e->name[n++] = *c;
+    }
+    e->name[n] = '\0';
+    __atomic_store_n(&e->seq, i + 1, __ATOMIC_RELEASE);
+}
+
+/* Copies ring slot i into *out if it still holds event i */
+static int trace_read(uint64_t i, trace_event *out) {
+    const trace_event *e = &trace.ev[i & (TRACE_RING - 1)];
+    if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != i + 1) return 0;
+    *out = *e;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&e->seq, __ATOMIC_RELAXED) == i + 1;
+}
+
+/* Ring indices [*lo, return) that may still hold events */
+static uint64_t trace_window(uint64_t *lo) {
+    uint64_t head = __atomic_load_n(&trace.head, __ATOMIC_ACQUIRE);
+    *lo = head > TRACE_RING ? head - TRACE_RING : 0;
+    if (*lo < trace.since) *lo = trace.since;
+    return head;
+}
+
+/* Writes the ring to o as JSON, ticks times scale giving CLOCK_MONOTONIC
+ * ns. With a flushing o and a buffer the caller owns, nothing here
+ * allocates or writes shell state, so the SIGUSR1 handler can use it. */
+void trace_dump(out_buf *o, double scale) {
+    char num[24];
+    uint64_t lo, head = trace_window(&lo);
+    const char *sep = "\n  ";
+    out_write(o, "{\"pid\": ", 8);
+    out_write(o, num, num_utoa((uint64_t)getpid(), num));
+    out_write(o, ", \"events\": [", 13);
+    for (uint64_t i = lo; i < head; i++) {
+        trace_event e;
+        if (!trace_read(i, &e)) continue;
+        int64_t since = (int64_t)(e.start - trace.base_ticks);
+        out_write(o, sep, strlen(sep));
+        out_write(o, "{\"kind\": \"", 10);
+        out_write(o, trace_kinds[e.kind], strlen(trace_kinds[e.kind]));
+        out_write(o, "\", \"name\": \"", 12);
+        for (int k = 0; e.name[k]; k++) {
+            unsigned char c = (unsigned char)e.name[k];
+            if (c == '"' || c == '\\') out_write(o, "\\", 1);
+            out_write(o, c < 0x20 ? "?" : &e.name[k], 1);
+        }
+        out_write(o, "\", \"start_ns\": ", 15);
+        out_write(o, num, num_utoa((uint64_t)(trace.base_ns + (int64_t)(since * scale)), num));
+        out_write(o, ", \"dur_ns\": ", 12);
+        out_write(o, num, num_utoa((uint64_t)(e.ticks * scale), num));
+        out_write(o, ", \"cpu_ns\": ", 12);
+        if (e.cpu_ns == TRACE_NO_CPU) out_write(o, "null", 4);
+        else out_write(o, num, num_utoa(e.cpu_ns, num));
+        out_write(o, "}", 1);
+        sep = ",\n  ";
+    }
+    out_write(o, "\n]}\n", 4);
+}
+
+static void trace_dump_file(double scale) {
+    int saved = errno;
+    char buf[4096];
+    out_buf o = { open(trace_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644), buf, 0, sizeof(buf), 0 };
+    if (o.fd >= 0) {
+        trace_dump(&o, scale);
+        out_flush(&o);
+        close(o.fd);
+    }
+    errno = saved;
+}
+
+static void trace_dump_at_exit(void) {
+    trace_dump_file(trace_scale());
+}
+
+static void trace_sigusr1(int signo) {
+    (void)signo;
+    trace_dump_file(trace_scale_peek());
+}
+
+/* SIGUSR1 dumps the ring at any time; with OSHELL_TRACE_DUMP set, exit does too */
+void install_trace_handlers(void) {
+    struct sigaction sa;
+    if (!trace_enabled) return;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = trace_sigusr1;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+    if (getenv("OSHELL_TRACE_DUMP")) atexit(trace_dump_at_exit);
+}
+
+/* Log-linear histogram in the HDR style: values below 2*HDR_SUB are exact,
+ * above that each power of two is split into HDR_SUB buckets, so a bucket is
+ * within 1/HDR_SUB (1.6%) of every value in it */
+#define HDR_SUB 64
+#define HDR_BUCKETS ((64 - 6) * HDR_SUB + 2 * HDR_SUB)
+
+static int hdr_index(uint64_t v) {
+    if (v < 2 * HDR_SUB) return (int)v;
+    int e = 63 - __builtin_clzll(v);                /* e >= 7 */
+    return (e - 6) * HDR_SUB + (int)(v >> (e - 6));  /* top 7 bits: 64..127 */
+}
+
+/* Largest value that falls in bucket i */
+static uint64_t hdr_value(int i) {
+    if (i < 2 * HDR_SUB) return (uint64_t)i;
+    int shift = i / HDR_SUB - 1;
+    return (((uint64_t)(i % HDR_SUB + HDR_SUB) + 1) << shift) - 1;
+}
+
+/* Nearest-rank percentile, as its bucket's upper bound but at most max */
+static uint64_t hdr_percentile(const uint32_t *h, uint64_t count, uint64_t max, double p) {
+    uint64_t rank = (uint64_t)ceil(p / 100.0 * count), seen = 0;
+    if (rank < 1) rank = 1;
+    for (int i = 0; i < HDR_BUCKETS; i++)
+        if ((seen += h[i]) >= rank) return hdr_value(i) < max ? hdr_value(i) : max;
+    return max;
+}
+
+/* Job table. Every pipeline that started at least one process becomes a
+ * job; each stage is waited for by its exact pid with wait4(), which also
+ * records that stage's resource usage. Background and stopped jobs are
+ * reaped from the prompt loop whenever the SIGCHLD handler has poked the
+ * self-pipe, so they never linger as zombies or steal a foreground wait. */
+enum { STAGE_RUNNING, STAGE_STOPPED, STAGE_DONE };
+
+typedef struct {
+    pid_t pid;
+    char *name;
+    int state, status;
+    struct rusage ru;
+    uint64_t started;             /* trace_tick() at spawn */
+} job_stage;
+
+typedef struct job {
+    int id;
+    char *cmdline;
+    int nstages;
+    job_stage *stages;
+    int background, notified;
+    struct job *next;
+} job;
+
+static job *jobs;                /* oldest first */
+static job *last_fg;             /* last finished foreground pipeline, for jobs -l */
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static int sigchld_pipe[2] = { -1, -1 };
+
+static void sigchld_handler(int signo) {
+    int saved = errno;
+    (void)signo;
+    if (write(sigchld_pipe[1], "", 1) < 0) { /* pipe full: a wakeup is pending anyway */ }
+    errno = saved;
+}
+
+void install_sigchld_handler(void) {
+    struct sigaction sa;
+    if (pipe2(sigchld_pipe, O_CLOEXEC | O_NONBLOCK) < 0) { perror("pipe"); return; }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigchld_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+}
+
+static void free_job(job *j) {
+    if (!j) return;
+    for (int i = 0; i < j->nstages; i++) free(j->stages[i].name);
+    free(j->stages);
+    free(j->cmdline);
+    free(j);
+}
+
+job *job_add(const char *cmdline, const pid_t *pids, char **names, int n, int background) {
+    job *j = calloc(1, sizeof(*j));
+    if (!j || !(j->stages = calloc(n, sizeof(job_stage))) || !(j->cmdline = strdup(cmdline))) {
+        if (j) free(j->stages);
+        free(j);
+        return NULL;
+    }
+    j->nstages = n;
+    j->background = background;
+    for (int i = 0; i < n; i++) {
+        j->stages[i].pid = pids[i];
+        j->stages[i].name = strdup(names[i] ? names[i] : "?");
+    }
+    pthread_mutex_lock(&job_lock);
+    job **pj = &jobs;
+    int id = 1;
+    for (; *pj; pj = &(*pj)->next)
+        if ((*pj)->id >= id) id = (*pj)->id + 1;
+    j->id = id;
+    *pj = j;
+    pthread_mutex_unlock(&job_lock);
+    return j;
+}
+
+static void job_unlink(job *j) {
+    for (job **pj = &jobs; *pj; pj = &(*pj)->next) {
+        if (*pj == j) { *pj = j->next; return; }
+    }
+}
+
+static int job_state(const job *j) {
+    int state = STAGE_DONE;
+    for (int i = 0; i < j->nstages; i++) {
+        if (j->stages[i].state == STAGE_RUNNING) return STAGE_RUNNING;
+        if (j->stages[i].state == STAGE_STOPPED) state = STAGE_STOPPED;
+    }
+    return state;
+}
+
+static uint64_t rusage_ns(const struct rusage *ru) {
+    return (uint64_t)(ru->ru_utime.tv_sec + ru->ru_stime.tv_sec) * 1000000000ULL +
+           (uint64_t)(ru->ru_utime.tv_usec + ru->ru_stime.tv_usec) * 1000ULL;
+}
+
+/* A stage's end is when the shell reaps it, which for a stage that exits
+ * before an earlier one is as late as that earlier exit */
+static void stage_update(job_stage *s, int status, const struct rusage *ru) {
+    if (WIFSTOPPED(status)) {
+        s->state = STAGE_STOPPED;
+    } else if (WIFCONTINUED(status)) {
+        s->state = STAGE_RUNNING;
+    } else {
+        s->state = STAGE_DONE;
+        s->status = status;
+        s->ru = *ru;
+        if (s->started) trace_record(TRACE_STAGE, s->name, s->started, trace_tick(), rusage_ns(ru));
+    }
+}
+
+static const char *state_name(int state) {
+    return state == STAGE_RUNNING ? "Running" : state == STAGE_STOPPED ? "Stopped" : "Done";
+}
+
+/* Blocks until every stage of j has exited or one of them stops. A finished
+ * foreground job leaves the table and becomes last_fg. */
+int wait_job(job *j) {
+    for (int i = 0; i < j->nstages; i++) {
+        job_stage *s = &j->stages[i];
+        while (s->state == STAGE_RUNNING) {
+            int status;
+            struct rusage ru;
+            pid_t r = wait4(s->pid, &status, WUNTRACED, &ru);
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) { s->state = STAGE_DONE; break; }
+            pthread_mutex_lock(&job_lock);
+            stage_update(s, status, &ru);
+            pthread_mutex_unlock(&job_lock);
+        }
+    }
+    int state = job_state(j);
+    if (state == STAGE_STOPPED) {
+        j->background = 1;
+        printf("\n[%d]+  Stopped                 %s\n", j->id, j->cmdline);
+        return -1;
+    }
+    pthread_mutex_lock(&job_lock);
+    job_unlink(j);
+    if (!j->background) {
+        free_job(last_fg);
+        last_fg = j;
+        j = NULL;
+    }
+    pthread_mutex_unlock(&job_lock);
+    int status = j ? j->stages[j->nstages - 1].status : last_fg->stages[last_fg->nstages - 1].status;
+    free_job(j);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/* Polls background and stopped jobs after SIGCHLD and reports changes */
+void reap_jobs(void) {
+    char buf[64];
+    if (sigchld_pipe[0] < 0 || read(sigchld_pipe[0], buf, sizeof(buf)) <= 0) return;
+    while (read(sigchld_pipe[0], buf, sizeof(buf)) > 0) { }
+    pthread_mutex_lock(&job_lock);
+    for (job **pj = &jobs; *pj; ) {
+        job *j = *pj;
+        if (!j->background) { pj = &j->next; continue; }
+        int before = job_state(j);
+        for (int i = 0; i < j->nstages; i++) {
+            job_stage *s = &j->stages[i];
+            int status;
+            struct rusage ru;
+            if (s->state != STAGE_DONE && wait4(s->pid, &status, WNOHANG | WUNTRACED | WCONTINUED, &ru) > 0)
+                stage_update(s, status, &ru);
+        }
+        int after = job_state(j);
+        if (after != before || after == STAGE_DONE)
+            printf("[%d]   %-22s %s\n", j->id, state_name(after), j->cmdline);
+        if (after == STAGE_DONE) {
+            *pj = j->next;
+            free_job(j);
+        } else {
+            pj = &j->next;
+        }
+    }
+    pthread_mutex_unlock(&job_lock);
+    fflush(stdout);
+}
+
+/* "%n", "n" or nothing (most recent job) */
+static job *find_job(const char *spec) {
+    job *found = NULL;
+    int id = spec ? atoi(spec[0] == '%' ? spec + 1 : spec) : 0;
+    for (job *j = jobs; j; j = j->next)
+        if (id ? j->id == id : 1) found = j;
+    return found;
+}
+
+static void job_signal(job *j, int sig) {
+    for (int i = 0; i < j->nstages; i++) {
+        if (j->stages[i].state != STAGE_DONE) {
+            kill(j->stages[i].pid, sig);
+            if (sig == SIGCONT) j->stages[i].state = STAGE_RUNNING;
+        }
+    }
+}
+
+static void print_stage(out_buf *out, const job_stage *s) {
+    char line[256];
+    int n;
+    if (s->state != STAGE_DONE) {
+        n = snprintf(line, sizeof(line), "    %8d  %-8s %s\n", (int)s->pid, state_name(s->state), s->name);
+    } else {
+        n = snprintf(line, sizeof(line),
+                     "    %8d  %-8s %-12s user %.3fs  sys %.3fs  maxrss %ldKB  csw %ld/%ld\n",
+                     (int)s->pid, WIFEXITED(s->status) ? "Exit" : "Signal",
+                     s->name,
+                     s->ru.ru_utime.tv_sec + s->ru.ru_utime.tv_usec / 1e6,
+                     s->ru.ru_stime.tv_sec + s->ru.ru_stime.tv_usec / 1e6,
+                     s->ru.ru_maxrss, s->ru.ru_nvcsw, s->ru.ru_nivcsw);
+    }
+    out_write(out, line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+}
+
+/* Counters around a unit of work: cycles, instructions, cache and branch
+ * misses from perf_event_open, plus page faults and context switches.
+ * Every counter is inherited, so processes and threads started inside
+ * the region count too; their totals are folded in as they are reaped.
+ * exec-faults is the same page-fault counter armed with enable_on_exec,
+ * so page-faults minus exec-faults is what fork and copy-on-write cost
+ * before the exec. Counters the kernel refuses read as -1; if none open,
+ * page faults and context switches come from getrusage instead. */
+enum { PC_CYCLES, PC_INSTRUCTIONS, PC_CACHE_MISSES, PC_BRANCH_MISSES,
+       PC_PAGE_FAULTS, PC_EXEC_FAULTS, PC_CTX_SWITCHES, PC_COUNT };
+
+static const struct { const char *name; unsigned type; unsigned long long config; int on_exec; } perf_events[PC_COUNT] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0 },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0 },
+    { "cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 0 },
+    { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 0 },
+    { "page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, 0 },
+    { "exec-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, 1 },
+    { "context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, 0 },
+};
+
+typedef struct {
+    int fd[PC_COUNT];            /* -1 where the counter is unavailable */
+    int nopen;                   /* 0: rusage fallback */
+    struct rusage self0, child0;
+    struct timespec t0;
+    long long v[PC_COUNT];       /* filled by perf_stop, -1 if unknown */
+    long ns;
+} perf_counters;
+
+static int perf_event_open(struct perf_event_attr *attr) {
+    return (int)syscall(SYS_perf_event_open, attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+/* Returns the number of counters opened */
+int perf_open(perf_counters *pc) {
+    pc->nopen = 0;
+    for (int i = 0; i < PC_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_events[i].type;
+        attr.config = perf_events[i].config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.enable_on_exec = perf_events[i].on_exec;
+        attr.exclude_hv = 1;
+        pc->fd[i] = perf_event_open(&attr);
+        if (pc->fd[i] < 0 && (errno == EACCES || errno == EPERM)) {
+            attr.exclude_kernel = 1;     /* perf_event_paranoid >= 2 */
+            pc->fd[i] = perf_event_open(&attr);
+        }
+        if (pc->fd[i] >= 0) pc->nopen++;
+    }
+    return pc->nopen;
+}
+
+void perf_start(perf_counters *pc) {
+    getrusage(RUSAGE_SELF, &pc->self0);
+    getrusage(RUSAGE_CHILDREN, &pc->child0);
+    for (int i = 0; i < PC_COUNT; i++) {
+        if (pc->fd[i] < 0) continue;
+        ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+        if (!perf_events[i].on_exec) ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &pc->t0);
+}
+
+void perf_stop(perf_counters *pc) {
+    struct rusage self, child;
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    pc->ns = (t1.tv_sec - pc->t0.tv_sec) * 1000000000L + (t1.tv_nsec - pc->t0.tv_nsec);
+    for (int i = 0; i < PC_COUNT; i++) {
+        uint64_t v;
+        pc->v[i] = -1;
+        if (pc->fd[i] < 0) continue;
+        ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(pc->fd[i], &v, sizeof(v)) == sizeof(v)) pc->v[i] = (long long)v;
+    }
+    if (pc->nopen == 0) {
+        getrusage(RUSAGE_SELF, &self);
+        getrusage(RUSAGE_CHILDREN, &child);
+        pc->v[PC_PAGE_FAULTS] = self.ru_minflt + self.ru_majflt + child.ru_minflt + child.ru_majflt
+            - pc->self0.ru_minflt - pc->self0.ru_majflt - pc->child0.ru_minflt - pc->child0.ru_majflt;
+        pc->v[PC_CTX_SWITCHES] = self.ru_nvcsw + self.ru_nivcsw + child.ru_nvcsw + child.ru_nivcsw
+            - pc->self0.ru_nvcsw - pc->self0.ru_nivcsw - pc->child0.ru_nvcsw - pc->child0.ru_nivcsw;
+    }
+}
+
+void perf_close(perf_counters *pc) {
+    for (int i = 0; i < PC_COUNT; i++)
+        if (pc->fd[i] >= 0) close(pc->fd[i]);
+}
+
+/* One line per known counter, in `perf stat` style */
+void perf_report(const perf_counters *pc, FILE *fp) {
+    fprintf(fp, "\n Counters (%s):\n", pc->nopen ? "perf_event" : "rusage");
+    for (int i = 0; i < PC_COUNT; i++) {
+        if (pc->v[i] < 0) continue;
+        fprintf(fp, " %16lld  %s", pc->v[i], perf_events[i].name);
+        if (i == PC_INSTRUCTIONS && pc->v[PC_CYCLES] > 0)
+            fprintf(fp, "    # %.2f insn per cycle", (double)pc->v[i] / pc->v[PC_CYCLES]);
+        if (i == PC_EXEC_FAULTS && pc->v[PC_PAGE_FAULTS] >= 0)
+            fprintf(fp, "    # %lld before exec", pc->v[PC_PAGE_FAULTS] - pc->v[i]);
+        fputc('\n', fp);
+    }
+    fprintf(fp, " %16.3f  ms elapsed\n", pc->ns / 1e6);
+}
+
+/* Result memo for expressions typed or sent again and again. Keys are the
+ * expression text with blanks dropped wherever they cannot separate two
+ * tokens, so "2 ^ 30" and "2^30" share a slot but "1 2" and "12" do not.
+ * The table is open addressing over a fixed power-of-two number of slots,
+ * and a key only ever lives in the EXPR_CACHE_PROBE slots after its hash.
+ * When that window is full, CLOCK picks the victim: the hand goes round the
+ * window from where the last eviction left it, a slot hit since the hand
+ * last passed loses its reference bit and survives, and the first one
+ * without it is replaced.
+ * Slots are allocated once, so memory stays fixed however long the
+ * session runs. Only successful results are stored, and lines that are
+ * not expressions at all (commands) are not counted as misses. */
+#define EXPR_CACHE_KEY     112
+#define EXPR_CACHE_PROBE   8
+#define EXPR_CACHE_DEFAULT 1024
+
+typedef struct {
+    unsigned hash;
+    unsigned char used, ref, wide;
+    double val;
+    char key[EXPR_CACHE_KEY];
+} cache_slot;
+
+static struct {
+    cache_slot *slots;
+    size_t cap;                  /* 0: disabled */
+    size_t hand;                 /* CLOCK hand: window offset the next sweep starts at */
+    int ready;
+    unsigned long long hits, misses, inserts, evictions;
+    pthread_mutex_t lock;
+} expr_cache = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* (Re)creates the table with at least `entries` slots; 0 disables it */
+static void cache_resize_locked(size_t entries) {
+    size_t cap = entries ? EXPR_CACHE_PROBE : 0;
+    while (cap && cap < entries) cap <<= 1;
+    free(expr_cache.slots);
+    expr_cache.slots = cap ? calloc(cap, sizeof(cache_slot)) : NULL;
+    expr_cache.cap = expr_cache.slots ? cap : 0;
+    expr_cache.hand = 0;
+    expr_cache.ready = 1;
+}
+
+static void cache_init_locked(void) {
+    const char *env = getenv("OSHELL_CACHE");
+    cache_resize_locked(env ? (size_t)atol(env) : EXPR_CACHE_DEFAULT);
+}
+
+/* eval_expr_wide() behind the memo; wide may be NULL */
+int eval_cached(const char *expr, double *out, int *wide) {
+    char key[EXPR_CACHE_KEY];
+    size_t n = 0;
+    for (const char *p = expr; *p; p++) {
+        if (isspace((unsigned char)*p)) {
+            while (isspace((unsigned char)p[1])) p++;
+            if (n == 0 || !p[1] || !(isalnum((unsigned char)key[n - 1]) || key[n - 1] == '.') ||
+                !(isalnum((unsigned char)p[1]) || p[1] == '.'))
+                continue;
+        }
+        if (n == sizeof(key) - 1) return eval_expr_wide(expr, out, wide);    /* too long to keep */
+        key[n++] = isspace((unsigned char)*p) ? ' ' : *p;
+    }
+    key[n] = '\0';
+    unsigned h = name_hash(key, 0);
+
+    pthread_mutex_lock(&expr_cache.lock);
+    if (!expr_cache.ready) cache_init_locked();
+    if (expr_cache.cap == 0) {
+        pthread_mutex_unlock(&expr_cache.lock);
+        return eval_expr_wide(expr, out, wide);
+    }
+    size_t mask = expr_cache.cap - 1;
+    for (size_t i = 0; i < EXPR_CACHE_PROBE; i++) {
+        cache_slot *s = &expr_cache.slots[(h + i) & mask];
+        if (!s->used) break;
+        if (s->hash == h && strcmp(s->key, key) == 0) {
+            s->ref = 1;
+            expr_cache.hits++;
+            *out = s->val;
+            if (wide) *wide = s->wide;
+            pthread_mutex_unlock(&expr_cache.lock);
+            return 1;
+        }
+    }
+    pthread_mutex_unlock(&expr_cache.lock);
+
+    int w = 0, rc = eval_expr_wide(expr, out, &w);
+    if (wide) *wide = w;
+    if (rc == 0) return rc;
+
+    pthread_mutex_lock(&expr_cache.lock);
+    expr_cache.misses++;
+    if (rc == 1 && expr_cache.cap > 0) {
+        mask = expr_cache.cap - 1;
+        cache_slot *victim = NULL;
+        for (size_t i = 0; i < EXPR_CACHE_PROBE && !victim; i++) {
+            cache_slot *s = &expr_cache.slots[(h + i) & mask];
+            if (!s->used || (s->hash == h && strcmp(s->key, key) == 0)) victim = s;
+        }
+        for (size_t i = 0; i < 2 * EXPR_CACHE_PROBE && !victim; i++) {
+            size_t at = (expr_cache.hand + i) % EXPR_CACHE_PROBE;
+            cache_slot *s = &expr_cache.slots[(h + at) & mask];
+            if (s->ref) { s->ref = 0; continue; }
+            victim = s;
+            expr_cache.hand = at + 1;
+            expr_cache.evictions++;
+        }
+        victim->hash = h;
+        victim->used = 1;
+        victim->ref = 0;
+        victim->wide = (unsigned char)w;
+        victim->val = *out;
+        memcpy(victim->key, key, n + 1);
+        expr_cache.inserts++;
+    }
+    pthread_mutex_unlock(&expr_cache.lock);
+    return rc;
+}
+
+/* Builtins run inside the shell and never fork. Each one reads in_fd and
+ * writes through an out_buf; main() looks the command up before spawning.
+ * A lone foreground builtin runs on the shell's own thread, builtin stages of
+ * a larger pipeline run on their own thread with private copies of their
+ * pipe fds, and builtins in background pipelines fall back to fork.
+ * Side-effect free builtins carry flags that let adjacent stages fuse. */
+typedef int (*builtin_fn)(char **argv, int in_fd, out_buf *out);
+typedef struct { const char *name; builtin_fn fn; int flags; } builtin;
+
+#define BI_NOINPUT  1    /* never reads stdin: a fused run can start here */
+#define BI_PASSTHRU 2    /* with no arguments, output == input */
+#define BI_NOSTATE  4    /* leaves the shell as it was: $(...) may run it in-process */
+#define BI_NOOPTS   8    /* takes no options: a '-...' word runs the external command */
+
+#define BUILTIN_OUT_SIZE (64 * 1024)
+
+int exit_requested = 0;
+int exit_status = 0;     /* $?: the last pipeline or expression, or exit N */
+
+int bi_true(char **argv, int in_fd, out_buf *out) {
+    (void)argv; (void)in_fd; (void)out;
+    return 0;
+}
+
+int bi_false(char **argv, int in_fd, out_buf *out) {
+    (void)argv; (void)in_fd; (void)out;
+    return 1;
+}
+
+/* Writes the echo -e escape at s (s[0] is the backslash) and returns the
+ * chars consumed, or 0 for \c, which ends all output */
+static int echo_escape(const char *s, out_buf *out) {
+    int n = 2, c = 0;
+    switch (s[1]) {
+        case 'a': c = '\a'; break;
+        case 'b': c = '\b'; break;
+        case 'c': return 0;
+        case 'e': c = 033; break;
+        case 'f': c = '\f'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+        case 'v': c = '\v'; break;
+        case '\\': c = '\\'; break;
+        case '0':   /* \0nnn: up to three octal digits */
+            for (; n < 5 && s[n] >= '0' && s[n] <= '7'; n++) c = c * 8 + s[n] - '0';
+            break;
+        case 'x':   /* \xHH: one or two hex digits */
+            for (; n < 4 && isxdigit((unsigned char)s[n]); n++)
+                c = c * 16 + (isdigit((unsigned char)s[n]) ? s[n] - '0' : (s[n] | 040) - 'a' + 10);
+            if (n == 2) { out_write(out, s, 2); return 2; }   /* \x without digits */
+            break;
+        default: out_write(out, s, s[1] ? 2 : 1); return s[1] ? 2 : 1;
+    }
+    char ch = (char)c;
+    out_write(out, &ch, 1);
+    return n;
+}
+
+/* echo [-neE] [ARG...]: leading words made only of n, e and E are options,
+ * as in bash; -e interprets backslash escapes and -E (the default) does not */
+int bi_echo(char **argv, int in_fd, out_buf *out) {
+    int newline = 1, escapes = 0, i = 1;
+    (void)in_fd;
+    for (; argv[i] && argv[i][0] == '-' && argv[i][1] && strspn(argv[i] + 1, "neE") == strlen(argv[i] + 1); i++)
+        for (const char *o = argv[i] + 1; *o; o++) {
+            if (*o == 'n') newline = 0;
+            else escapes = *o == 'e';
+        }
+    for (int first = i; argv[i]; i++) {
+        if (i > first) out_write(out, " ", 1);
+        if (!escapes) { out_write(out, argv[i], strlen(argv[i])); continue; }
+        for (const char *s = argv[i]; *s; ) {
+            const char *bs = strchr(s, '\\');
+            if (!bs) { out_write(out, s, strlen(s)); break; }
+            out_write(out, s, bs - s);
+            int n = echo_escape(bs, out);
+            if (n == 0) return 0;
+            s = bs + n;
+        }
+    }
+    if (newline) out_write(out, "\n", 1);
+    return 0;
+}
+
+int bi_pwd(char **argv, int in_fd, out_buf *out) {
+    char buf[4096];
+    (void)argv; (void)in_fd;
+    if (!getcwd(buf, sizeof(buf))) { perror("pwd"); return 1; }
+    out_write(out, buf, strlen(buf));
+    out_write(out, "\n", 1);
+    return 0;
+}
+
+int bi_cd(char **argv, int in_fd, out_buf *out) {
+    const char *dir = argv[1] ? argv[1] : getenv("HOME");
+    (void)in_fd; (void)out;
+    if (!dir) { fprintf(stderr, "cd: HOME not set\n"); return 1; }
+    if (chdir(dir) < 0) { fprintf(stderr, "cd: %s: %s\n", dir, strerror(errno)); return 1; }
+    return 0;
+}
+
+int bi_exit(char **argv, int in_fd, out_buf *out) {
+    (void)in_fd; (void)out;
+    exit_requested = 1;
+    if (argv[1]) exit_status = atoi(argv[1]);   /* bare exit keeps the last status, as in sh */
+    return exit_status;
+}
+
+/* Copies backslash escapes from s into out, returns chars consumed */
+static int printf_escape(const char *s, out_buf *out) {
+    char c;
+    switch (s[1]) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case '\\': c = '\\'; break;
+        case '\0': out_write(out, "\\", 1); return 1;
+        default: out_write(out, s, 2); return 2;
+    }
+    out_write(out, &c, 1);
+    return 2;
+}
+
+/* printf FORMAT [ARG...]: %s %c %d %i %u %x %X %o %f %g %e and %%, with
+ * flags, width and precision. The format is reused while arguments remain. */
+int bi_printf(char **argv, int in_fd, out_buf *out) {
+    char spec[32], tmp[512];
+    (void)in_fd;
+    if (!argv[1]) { fprintf(stderr, "printf: usage: printf format [arguments]\n"); return 1; }
+    char **arg = argv + 2;
+    do {
+        int consumed = 0;
+        for (const char *f = argv[1]; *f; ) {
+            if (*f == '\\') { f += printf_escape(f, out); continue; }
+            if (*f != '%') { out_write(out, f++, 1); continue; }
+            if (f[1] == '%') { out_write(out, "%", 1); f += 2; continue; }
+            size_t n = strspn(f + 1, "-+ #0123456789.") + 1;
+            if (!f[n] || n + 2 > sizeof(spec)) { out_write(out, f, strlen(f)); break; }
+            char conv = f[n];
+            const char *a = *arg ? *arg++ : "";
+            int len;
+            consumed = 1;
+            memcpy(spec, f, n);
+            switch (conv) {
+                case 'd': case 'i':
+                    strcpy(spec + n, "lld");
+                    len = snprintf(tmp, sizeof(tmp), spec, strtoll(a, NULL, 0));
+                    break;
+                case 'u': case 'x': case 'X': case 'o':
+                    spec[n] = 'l'; spec[n + 1] = 'l'; spec[n + 2] = conv; spec[n + 3] = '\0';
+                    len = snprintf(tmp, sizeof(tmp), spec, strtoull(a, NULL, 0));
+                    break;
+                case 'f': case 'g': case 'e': case 'F': case 'G': case 'E':
+                    spec[n] = conv; spec[n + 1] = '\0';
+                    len = snprintf(tmp, sizeof(tmp), spec, strtod(a, NULL));
+                    break;
+                case 'c':
+                    spec[n] = 'c'; spec[n + 1] = '\0';
+                    len = snprintf(tmp, sizeof(tmp), spec, *a);
+                    break;
+                default:
+                    spec[n] = 's'; spec[n + 1] = '\0';
+                    len = snprintf(tmp, sizeof(tmp), spec, a);
+                    break;
+            }
+            out_write(out, tmp, len < (int)sizeof(tmp) ? len : (int)sizeof(tmp) - 1);
+            f += n + 1;
+        }
+        if (!consumed) break;
+    } while (*arg);
+    return 0;
+}
+
+/* hash: list cached command locations; hash -r: forget them all;
+ * hash NAME...: look the names up now */
+int bi_hash(char **argv, int in_fd, out_buf *out) {
+    char line[4200];
+    int rc = 0;
+    (void)in_fd;
+    if (argv[1] && strcmp(argv[1], "-r") == 0) {
+        path_cache_clear();
+        return 0;
+    }
+    if (argv[1]) {
+        for (int i = 1; argv[i]; i++) {
+            char *p = resolve_command(argv[i]);
+            if (!p) { fprintf(stderr, "hash: %s: not found\n", argv[i]); rc = 1; }
+            free(p);
+        }
+        return rc;
+    }
+    pthread_mutex_lock(&path_cache_lock);
+    int any = 0;
+    for (int i = 0; i < PATH_CACHE_SLOTS; i++) {
+        for (path_entry *e = path_cache[i]; e; e = e->next) {
+            if (!any++) out_write(out, "hits\tcommand\n", 13);
+            int n = snprintf(line, sizeof(line), "%4u\t%s\n", e->hits, e->path);
+            out_write(out, line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+        }
+    }
+    pthread_mutex_unlock(&path_cache_lock);
+    if (!any) out_write(out, "hash: hash table empty\n", 23);
+    return 0;
+}
+
+/* cachestat: hit/miss counters of the expression memo.
+ * -r resets the counters, -s N empties it and resizes it to N entries
+ * (rounded up to a power of two, 0 turns it off). */
+int bi_cachestat(char **argv, int in_fd, out_buf *out) {
+    char line[256];
+    (void)in_fd;
+    pthread_mutex_lock(&expr_cache.lock);
+    if (!expr_cache.ready) cache_init_locked();
+    if (argv[1] && strcmp(argv[1], "-r") == 0) {
+        expr_cache.hits = expr_cache.misses = expr_cache.inserts = expr_cache.evictions = 0;
+    } else if (argv[1] && strcmp(argv[1], "-s") == 0 && argv[2]) {
+        char *end;
+        long v = strtol(argv[2], &end, 0);
+        if (*end || v < 0 || v > (1 << 24)) {
+            pthread_mutex_unlock(&expr_cache.lock);
+            fprintf(stderr, "cachestat: invalid size '%s'\n", argv[2]);
+            return 1;
+        }
+        cache_resize_locked((size_t)v);
+    } else if (argv[1]) {
+        pthread_mutex_unlock(&expr_cache.lock);
+        fprintf(stderr, "cachestat: usage: cachestat [-r | -s ENTRIES]\n");
+        return 1;
+    } else {
+        size_t used = 0;
+        for (size_t i = 0; i < expr_cache.cap; i++) used += expr_cache.slots[i].used;
+        unsigned long long lookups = expr_cache.hits + expr_cache.misses;
+        int n = snprintf(line, sizeof(line),
+                         "capacity %zu, entries %zu, hits %llu, misses %llu (%.1f%% hit), inserts %llu, evictions %llu\n",
+                         expr_cache.cap, used, expr_cache.hits, expr_cache.misses,
+                         lookups ? 100.0 * expr_cache.hits / lookups : 0.0,
+                         expr_cache.inserts, expr_cache.evictions);
+        out_write(out, line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+    }
+    pthread_mutex_unlock(&expr_cache.lock);
+    return 0;
+}
+
+/* cat [FILE...]: file and stdin contents go straight to the output fd.
+ * A reader that went away (EPIPE) ends the stage quietly, like SIGPIPE. */
+int bi_cat(char **argv, int in_fd, out_buf *out) {
+    char *stdin_only[] = { "-", NULL };
+    int rc = 0;
+    if (out->fd < 0) {
+        /* capturing: the bytes have to land in the buffer */
+        char buf[COPY_BUF];
+        ssize_t n;
+        for (char **a = argv[1] ? argv + 1 : stdin_only; *a; a++) {
+            int fd = strcmp(*a, "-") == 0 ? in_fd : open(*a, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) { fprintf(stderr, "cat: %s: %s\n", *a, strerror(errno)); rc = 1; continue; }
+            while ((n = read(fd, buf, sizeof(buf))) > 0) out_write(out, buf, n);
+            if (fd != in_fd) close(fd);
+        }
+        return rc;
+    }
+    out_flush(out);
+    for (char **a = argv[1] ? argv + 1 : stdin_only; *a; a++) {
+        int fd = strcmp(*a, "-") == 0 ? in_fd : open(*a, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { fprintf(stderr, "cat: %s: %s\n", *a, strerror(errno)); rc = 1; continue; }
+        long long n = move_data(fd, out->fd);
+        if (fd != in_fd) close(fd);
+        if (n < 0 && errno == EPIPE) return 1;
+        if (n < 0) { fprintf(stderr, "cat: %s: %s\n", *a, strerror(errno)); rc = 1; }
+    }
+    return rc;
+}
+
+/* pipesize: show the session pipe size; pipesize BYTES: set it (0 = kernel
+ * default). "pipesize BYTES cmd | ..." applies to that pipeline only. */
+int bi_pipesize(char **argv, int in_fd, out_buf *out) {
+    char line[64];
+    (void)in_fd;
+    if (!argv[1]) {
+        int n = snprintf(line, sizeof(line), "%d\n", pipe_size);
+        out_write(out, line, n);
+        return 0;
+    }
+    char *end;
+    long v = strtol(argv[1], &end, 0);
+    if (*end || v < 0 || v > (1 << 30)) { fprintf(stderr, "pipesize: invalid size '%s'\n", argv[1]); return 1; }
+    pipe_size = (int)v;
+    return 0;
+}
+
+/* jobs [-l]: list jobs; -l adds every stage with its pid and, once it has
+ * exited, its CPU time, peak RSS and context switches (also shown for the
+ * last foreground pipeline) */
+int bi_jobs(char **argv, int in_fd, out_buf *out) {
+    char line[4200];
+    int verbose = argv[1] && strcmp(argv[1], "-l") == 0;
+    (void)in_fd;
+    pthread_mutex_lock(&job_lock);
+    for (job *j = jobs; j; j = j->next) {
+        if (!j->background) continue;
+        int n = snprintf(line, sizeof(line), "[%d]   %-22s %s\n", j->id, state_name(job_state(j)), j->cmdline);
+        out_write(out, line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+        for (int i = 0; verbose && i < j->nstages; i++) print_stage(out, &j->stages[i]);
+    }
+    if (verbose && last_fg) {
+        int n = snprintf(line, sizeof(line), "last   %-22s %s\n", "Done", last_fg->cmdline);
+        out_write(out, line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+        for (int i = 0; i < last_fg->nstages; i++) print_stage(out, &last_fg->stages[i]);
+    }
+    pthread_mutex_unlock(&job_lock);
+    return 0;
+}
+
+/* wait [%n]: wait for one job, or for every background job */
+int bi_wait(char **argv, int in_fd, out_buf *out) {
+    int rc = 0;
+    (void)in_fd; (void)out;
+    if (argv[1]) {
+        job *j = find_job(argv[1]);
+        if (!j) { fprintf(stderr, "wait: %s: no such job\n", argv[1]); return 127; }
+        return wait_job(j);
+    }
+    for (job *j; (j = find_job(NULL)) != NULL && job_state(j) == STAGE_RUNNING; )
+        rc = wait_job(j);
+    return rc;
+}
+
+/* fg [%n]: continue a job in the foreground and wait for it */
+int bi_fg(char **argv, int in_fd, out_buf *out) {
+    (void)in_fd; (void)out;
+    job *j = find_job(argv[1]);
+    if (!j) { fprintf(stderr, "fg: %s: no such job\n", argv[1] ? argv[1] : "current"); return 1; }
+    printf("%s\n", j->cmdline);
+    fflush(stdout);
+    j->background = 0;
+    job_signal(j, SIGCONT);
+    return wait_job(j);
+}
+
+/* bg [%n]: continue a stopped job in the background */
+int bi_bg(char **argv, int in_fd, out_buf *out) {
+    char line[4200];
+    (void)in_fd;
+    job *j = find_job(argv[1]);
+    if (!j) { fprintf(stderr, "bg: %s: no such job\n", argv[1] ? argv[1] : "current"); return 1; }
+    j->background = 1;
+    job_signal(j, SIGCONT);
+    int n = snprintf(line, sizeof(line), "[%d]   %s &\n", j->id, j->cmdline);
+    out_write(out, line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+    return 0;
+}
+
+static int trace_cmp(const void *a, const void *b) {
+    const trace_event *x = a, *y = b;
+    int c = strcmp(x->name, y->name);
+    return c ? c : x->kind - y->kind;
+}
+
+static void format_ns(char *out, size_t cap, double ns) {
+    if (ns < 1e3) snprintf(out, cap, "%.0fns", ns);
+    else if (ns < 1e6) snprintf(out, cap, "%.1fus", ns / 1e3);
+    else if (ns < 1e9) snprintf(out, cap, "%.2fms", ns / 1e6);
+    else snprintf(out, cap, "%.2fs", ns / 1e9);
+}
+
+/* stats [-j | -r]: p50/p99/p99.9/max per command name and event kind over
+ * the events still in the trace ring, with the median CPU time where there
+ * is one; -j writes the ring as JSON, -r forgets the events so far */
+int bi_stats(char **argv, int in_fd, out_buf *out) {
+    char line[256], col[5][16];
+    (void)in_fd;
+    if (argv[1] && !argv[2] && strcmp(argv[1], "-r") == 0) {
+        trace.since = __atomic_load_n(&trace.head, __ATOMIC_ACQUIRE);
+        return 0;
+    }
+    if (argv[1] && !(!argv[2] && strcmp(argv[1], "-j") == 0)) {
+        fprintf(stderr, "usage: stats [-j | -r]\n");
+        return 2;
+    }
+    if (!trace_enabled) { fprintf(stderr, "stats: tracing is off (OSHELL_TRACE=0)\n"); return 1; }
+    if (argv[1]) { trace_dump(out, trace_scale()); return 0; }
+
+    trace_event *ev = malloc(TRACE_RING * sizeof(*ev));
+    uint32_t *wall = malloc(2 * HDR_BUCKETS * sizeof(uint32_t)), *cpu = wall + HDR_BUCKETS;
+    if (!ev || !wall) { free(ev); free(wall); perror("stats"); return 1; }
+    uint64_t lo, head = trace_window(&lo);
+    size_t n = 0;
+    for (uint64_t i = lo; i < head; i++) n += trace_read(i, &ev[n]);
+    qsort(ev, n, sizeof(*ev), trace_cmp);
+    double scale = trace_scale();
+
+    int len = snprintf(line, sizeof(line), "%-16s %-8s %7s %9s %9s %9s %9s %9s\n",
+                       "command", "event", "count", "p50", "p99", "p99.9", "max", "cpu p50");
+    out_write(out, line, len);
+    for (size_t g = 0, end; g < n; g = end) {
+        uint64_t count = 0, ncpu = 0, max = 0, cpu_max = 0;
+        memset(wall, 0, 2 * HDR_BUCKETS * sizeof(uint32_t));
+        for (end = g; end < n && trace_cmp(&ev[g], &ev[end]) == 0; end++) {
+            uint64_t ns = (uint64_t)(ev[end].ticks * scale);
+            wall[hdr_index(ns)]++;
+            if (ns > max) max = ns;
+            count++;
+            if (ev[end].cpu_ns == TRACE_NO_CPU) continue;
+            cpu[hdr_index(ev[end].cpu_ns)]++;
+            if (ev[end].cpu_ns > cpu_max) cpu_max = ev[end].cpu_ns;
+            ncpu++;
+        }
+        format_ns(col[0], sizeof(col[0]), hdr_percentile(wall, count, max, 50));
+        format_ns(col[1], sizeof(col[1]), hdr_percentile(wall, count, max, 99));
+        format_ns(col[2], sizeof(col[2]), hdr_percentile(wall, count, max, 99.9));
+        format_ns(col[3], sizeof(col[3]), max);
+        if (ncpu) format_ns(col[4], sizeof(col[4]), hdr_percentile(cpu, ncpu, cpu_max, 50));
+        else strcpy(col[4], "-");
+        len = snprintf(line, sizeof(line), "%-16s %-8s %7llu %9s %9s %9s %9s %9s\n",
+                       ev[g].name, trace_kinds[ev[g].kind], (unsigned long long)count,
+                       col[0], col[1], col[2], col[3], col[4]);
+        out_write(out, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+    }
+    free(ev);
+    free(wall);
+    return 0;
+}
+
+/* parallel [-j N] [-P N] [-k] [-a FILE | -r FROM..TO] TEMPLATE... [::: ITEM...]
+ * Runs TEMPLATE once per input item: "{}" in a word is replaced by the
+ * item, and without any "{}" the item is appended as the last argument.
+ * Items are the words after :::, the lines of FILE, the integers of a
+ * range, or else the lines of stdin.
+ * A template that is an expression is evaluated and a side-effect free
+ * builtin is called, both on the worker threads. Anything else is spawned
+ * with its stdout on a pipe, and at most -P (default -j) processes run at
+ * once. Each job's output is collected whole. With -k it is written in
+ * input order, otherwise as jobs complete.
+ * Scheduling is work stealing over index ranges. Every worker starts with
+ * an equal slice of the jobs and takes from the front of its own range.
+ * A worker that runs dry takes the back half of another worker's range,
+ * so uneven jobs do not leave threads idle. */
+#define PAR_MAX_WORKERS 256
+#define PAR_MAX_ITEMS (1L << 24)    /* jobs per call; -k keeps an out_buf for each */
+
+const builtin *find_builtin(const char *name);
+const builtin *stage_builtin(char **args);
+
+typedef struct {
+    pthread_mutex_t lock;
+    long lo, hi;                  /* jobs not yet started */
+} par_range;
+
+typedef struct {
+    char **tmpl;                  /* template words */
+    int ntmpl, subst;             /* subst: some word contains {} */
+    char **items;                 /* NULL: the range from + i * step */
+    long nitems;
+    long long from, step;
+    int math;
+    const builtin *bi;
+    int nworkers, devnull;
+    par_range *ranges;
+    pthread_mutex_t lock;         /* output, results and the process count */
+    pthread_cond_t ready;         /* a result or a process slot became free */
+    int ordered, procs, max_procs;
+    out_buf *out, *results;
+    unsigned char *done;
+    long failed;
+} par_run;
+
+typedef struct { par_run *pr; int id; } par_worker_arg;
+
+/* Next job for worker id, stealing when its own range is empty; -1 when
+ * no range has any left */
+static long par_next(par_run *pr, int id) {
+    par_range *own = &pr->ranges[id];
+    long job = -1;
+    pthread_mutex_lock(&own->lock);
+    if (own->lo < own->hi) job = own->lo++;
+    pthread_mutex_unlock(&own->lock);
+    for (int k = 1; job < 0 && k < pr->nworkers; k++) {
+        par_range *v = &pr->ranges[(id + k) % pr->nworkers];
+        long lo = 0, hi = 0;
+        pthread_mutex_lock(&v->lock);
+        if (v->hi > v->lo) {
+            hi = v->hi;
+            lo = v->hi = v->hi - (v->hi - v->lo + 1) / 2;
+        }
+        pthread_mutex_unlock(&v->lock);
+        if (hi > lo) {
+            pthread_mutex_lock(&own->lock);
+            own->lo = lo + 1;
+            own->hi = hi;
+            pthread_mutex_unlock(&own->lock);
+            job = lo;
+        }
+    }
+    return job;
+}
+
+/* argv of one job, built in a */
+static char **par_argv(par_run *pr, const char *item, arena *a) {
+    size_t ilen = strlen(item);
+    char **argv = arena_alloc(a, (pr->ntmpl + 2) * sizeof(char *));
+    if (!argv) return NULL;
+    int n = 0;
+    for (int i = 0; i < pr->ntmpl; i++) {
+        const char *w = pr->tmpl[i], *p;
+        if (!strstr(w, "{}")) { argv[n++] = (char *)w; continue; }
+        size_t len = strlen(w) + 1, k = 0;
+        for (p = w; (p = strstr(p, "{}")) != NULL; p += 2) len += ilen;
+        char *s = arena_alloc(a, len);
+        if (!s) return NULL;
+        for (p = w; *p; ) {
+            if (p[0] == '{' && p[1] == '}') { memcpy(s + k, item, ilen); k += ilen; p += 2; }
+            else s[k++] = *p++;
+        }
+        s[k] = '\0';
+        argv[n++] = s;
+    }
+    if (!pr->subst) argv[n++] = (char *)item;
+    argv[n] = NULL;
+    return argv;
+}
+
+static char *par_join(char **argv, arena *a) {
+    size_t len = 1;
+    for (int i = 0; argv[i]; i++) len += strlen(argv[i]) + 1;
+    char *s = arena_alloc(a, len), *p = s;
+    if (!s) return NULL;
+    for (int i = 0; argv[i]; i++) p += sprintf(p, i ? " %s" : "%s", argv[i]);
+    *p = '\0';
+    return s;
+}
+
+/* External job: stdout comes back through a pipe into cap */
+static int par_spawn(par_run *pr, char **argv, out_buf *cap) {
+    int fds[2], status = 0;
+    char buf[COPY_BUF];
+    pthread_mutex_lock(&pr->lock);
+    while (pr->procs >= pr->max_procs) pthread_cond_wait(&pr->ready, &pr->lock);
+    pr->procs++;
+    pthread_mutex_unlock(&pr->lock);
+    pid_t pid = -1;
+    if (pipe2(fds, O_CLOEXEC) == 0) {
+        pid = spawn_resolved(argv, pr->devnull, fds[1], -1);
+        int err = errno;
+        close(fds[1]);
+        for (ssize_t n; pid > 0 && (n = read(fds[0], buf, sizeof(buf))) != 0; )
+            if (n > 0) out_write(cap, buf, n);
+            else if (errno != EINTR) break;
+        close(fds[0]);
+        errno = err;
+    }
+    if (pid < 0 && errno == ENOENT) fprintf(stderr, "parallel: %s: command not found\n", argv[0]);
+    else if (pid < 0) fprintf(stderr, "parallel: %s: %s\n", argv[0], strerror(errno));
+    else while (waitpid(pid, &status, 0) < 0 && errno == EINTR) ;
+    pthread_mutex_lock(&pr->lock);
+    pr->procs--;
+    pthread_cond_broadcast(&pr->ready);
+    pthread_mutex_unlock(&pr->lock);
+    return pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+static int par_job(par_run *pr, long job, out_buf *cap, arena *a) {
+    char num[32];
+    const char *item = pr->items ? pr->items[job] : num;
+    if (!pr->items) snprintf(num, sizeof(num), "%lld", pr->from + job * pr->step);
+    char **argv = par_argv(pr, item, a);
+    if (!argv) return 1;
+    if (pr->math) {
+        char *expr = par_join(argv, a);
+        double v;
+        int wide;
+        if (!expr || eval_expr_wide(expr, &v, &wide) != 1) return 1;
+        out_value(cap, expr, v, wide);
+        return 0;
+    }
+    if (pr->bi) return pr->bi->fn(argv, pr->devnull, cap);
+    return par_spawn(pr, argv, cap);
+}
+
+static void *par_worker(void *arg) {
+    par_worker_arg *wa = arg;
+    par_run *pr = wa->pr;
+    arena a = { NULL };
+    long job;
+    while ((job = par_next(pr, wa->id)) >= 0) {
+        out_buf cap;
+        int failed = !out_init(&cap, -1, 256) || par_job(pr, job, &cap, &a);
+        arena_reset(&a);
+        pthread_mutex_lock(&pr->lock);
+        pr->failed += failed;
+        if (pr->ordered) {
+            pr->results[job] = cap;
+            pr->done[job] = 1;
+            pthread_cond_broadcast(&pr->ready);
+        } else {
+            out_write(pr->out, cap.buf, cap.len);
+            free(cap.buf);
+        }
+        pthread_mutex_unlock(&pr->lock);
+    }
+    arena_free(&a);
+    return NULL;
+}
+
+/* Splits buf (NUL-terminated) into lines; empty lines are dropped */
+static char **par_lines(char *buf, long *n) {
+    long count = 0, cap = 64;
+    char **items = malloc(cap * sizeof(char *));
+    for (char *p = buf, *nl; items && *p; p = nl ? nl + 1 : p + strlen(p)) {
+        if ((nl = strchr(p, '\n'))) *nl = '\0';
+        if (!*p) continue;
+        if (count == cap) {
+            char **grown = realloc(items, (cap *= 2) * sizeof(char *));
+            if (!grown) { free(items); return NULL; }
+            items = grown;
+        }
+        items[count++] = p;
+    }
+    *n = count;
+    return items;
+}
+
+/* Everything left on fd, NUL-terminated; *size (if set) gets the length */
+static char *read_all(int fd, size_t *size) {
+    size_t len = 0, cap = 0;
+    char *buf = NULL;
+    for (;;) {
+        if (!grow(&buf, &cap, len + COPY_BUF + 1)) { free(buf); return NULL; }
+        ssize_t r = read(fd, buf + len, cap - len - 1);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) { free(buf); return NULL; }
+        if (r == 0) break;
+        len += r;
+    }
+    buf[len] = '\0';
+    if (size) *size = len;
+    return buf;
+}
+
+int bi_parallel(char **argv, int in_fd, out_buf *out) {
+    par_run pr = { .nworkers = default_threads(), .lock = PTHREAD_MUTEX_INITIALIZER,
+                   .ready = PTHREAD_COND_INITIALIZER, .out = out, .step = 1 };
+    const char *file = NULL, *range = NULL;
+    char *input = NULL;
+    int argi = 1;
+    for (; argv[argi] && argv[argi][0] == '-'; argi++) {
+        const char *opt = argv[argi];
+        if (strcmp(opt, "-k") == 0) pr.ordered = 1;
+        else if (strcmp(opt, "-j") == 0 && argv[argi + 1]) pr.nworkers = atoi(argv[++argi]);
+        else if (strcmp(opt, "-P") == 0 && argv[argi + 1]) pr.max_procs = atoi(argv[++argi]);
+        else if (strcmp(opt, "-a") == 0 && argv[argi + 1]) file = argv[++argi];
+        else if (strcmp(opt, "-r") == 0 && argv[argi + 1]) range = argv[++argi];
+        else break;
+    }
+    pr.tmpl = argv + argi;
+    while (argv[argi] && strcmp(argv[argi], ":::") != 0) argi++;
+    pr.ntmpl = (int)(argv + argi - pr.tmpl);
+    if (pr.ntmpl == 0 || pr.nworkers < 1) {
+        fprintf(stderr, "parallel: usage: parallel [-j N] [-P N] [-k] [-a FILE | -r FROM..TO] COMMAND... [::: ITEM...]\n");
+        return 2;
+    }
+    if (pr.nworkers > PAR_MAX_WORKERS) pr.nworkers = PAR_MAX_WORKERS;
+    if (pr.max_procs < 1) pr.max_procs = pr.nworkers;
+
+    /* Items */
+    if (argv[argi]) {
+        pr.items = argv + argi + 1;
+        while (pr.items[pr.nitems]) pr.nitems++;
+    } else if (range) {
+        char *dots, *end;
+        long long from = strtoll(range, &dots, 0), to;
+        if (strncmp(dots, "..", 2) != 0 || (to = strtoll(dots + 2, &end, 0), *end) || dots == range) {
+            fprintf(stderr, "parallel: invalid range '%s'\n", range);
+            return 2;
+        }
+        /* the span in unsigned arithmetic: to - from can overflow */
+        unsigned long long span = from <= to ? (unsigned long long)to - (unsigned long long)from
+                                             : (unsigned long long)from - (unsigned long long)to;
+        if (span >= PAR_MAX_ITEMS) {
+            fprintf(stderr, "parallel: range '%s' has more than %ld items\n", range, PAR_MAX_ITEMS);
+            return 2;
+        }
+        pr.from = from;
+        pr.step = from <= to ? 1 : -1;
+        pr.nitems = (long)span + 1;
+    } else {
+        int fd = file ? open(file, O_RDONLY | O_CLOEXEC) : in_fd;
+        if (fd < 0 || !(input = read_all(fd, NULL))) {
+            fprintf(stderr, "parallel: %s: %s\n", file ? file : "stdin", strerror(errno));
+            if (file && fd >= 0) close(fd);
+            return 1;
+        }
+        if (file) close(fd);
+        if (!(pr.items = par_lines(input, &pr.nitems))) { free(input); perror("malloc"); return 1; }
+    }
+    if (pr.nitems > PAR_MAX_ITEMS) {
+        fprintf(stderr, "parallel: more than %ld items\n", PAR_MAX_ITEMS);
+        if (input) { free(pr.items); free(input); }
+        return 2;
+    }
+    for (int i = 0; i < pr.ntmpl; i++) pr.subst |= strstr(pr.tmpl[i], "{}") != NULL;
+
+    /* What kind of job this is, judged on the first item */
+    int rc = 0;
+    if (pr.nitems > 0) {
+        arena a = { NULL };
+        char num[32], **first;
+        snprintf(num, sizeof(num), "%lld", pr.from);
+        expr_prog prog;
+        char *expr = (first = par_argv(&pr, pr.items ? pr.items[0] : num, &a)) ? par_join(first, &a) : NULL;
+        if (expr && compile_expr(expr, &prog)) {
+            pr.math = 1;
+            free_expr(&prog);
+        } else if (first && (pr.bi = stage_builtin(first)) && !(pr.bi->flags & (BI_NOINPUT | BI_PASSTHRU))) {
+            fprintf(stderr, "parallel: %s: builtin cannot run in parallel\n", pr.tmpl[0]);
+            rc = 2;
+        }
+        arena_free(&a);
+    }
+
+    pthread_t tids[PAR_MAX_WORKERS];
+    par_worker_arg args[PAR_MAX_WORKERS];
+    int started = 0;
+    pr.devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    pr.ranges = calloc(pr.nworkers, sizeof(par_range));
+    if (pr.ordered) {
+        pr.results = calloc(pr.nitems ? pr.nitems : 1, sizeof(out_buf));
+        pr.done = calloc(pr.nitems ? pr.nitems : 1, 1);
+    }
+    if (rc == 0 && (pr.devnull < 0 || !pr.ranges || (pr.ordered && (!pr.results || !pr.done)))) {
+        perror("parallel");
+        rc = 1;
+    }
+    for (int w = 0; rc == 0 && w < pr.nworkers; w++) {
+        pthread_mutex_init(&pr.ranges[w].lock, NULL);
+        pr.ranges[w].lo = pr.nitems * w / pr.nworkers;
+        pr.ranges[w].hi = pr.nitems * (w + 1) / pr.nworkers;
+    }
+    for (; rc == 0 && started < pr.nworkers && started < pr.nitems; started++) {
+        args[started] = (par_worker_arg){ &pr, started };
+        if (pthread_create(&tids[started], NULL, par_worker, &args[started]) != 0) break;
+    }
+    /* A worker that failed to start leaves its range to be stolen */
+    if (rc == 0 && started == 0 && pr.nitems > 0) { perror("pthread_create"); rc = 1; }
+    if (pr.ordered && started > 0) {
+        pthread_mutex_lock(&pr.lock);
+        for (long i = 0; i < pr.nitems; i++) {
+            while (!pr.done[i]) pthread_cond_wait(&pr.ready, &pr.lock);
+            pthread_mutex_unlock(&pr.lock);
+            out_write(out, pr.results[i].buf, pr.results[i].len);
+            free(pr.results[i].buf);
+            pthread_mutex_lock(&pr.lock);
+        }
+        pthread_mutex_unlock(&pr.lock);
+    }
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+
+    if (pr.devnull >= 0) close(pr.devnull);
+    free(pr.ranges);
+    free(pr.results);
+    free(pr.done);
+    if (input) { free(pr.items); free(input); }
+    return rc ? rc : pr.failed > 0;
+}
+
+/* Aggregation builtins: sum, mean, minmax, count and histogram read one
+ * number per line (the first field; blank lines are skipped) from stdin or
+ * FILE arguments. Short lines are classified with one SSE2 compare per
+ * character class; other lines are converted eight digits at a time and
+ * skipped with memchr. Parsed values are reduced a block at a time by the
+ * SIMD kernels of the column evaluator. A regular file is mapped and split
+ * at line boundaries across threads; a pipe is read in blocks on the
+ * calling thread. histogram needs the range before it can bin, so it reads
+ * its input twice and buffers a pipe first. */
+#define AGG_BLOCK       256
+#define AGG_READ        (1024 * 1024)
+#define AGG_THREAD_MIN  (4L * 1024 * 1024)   /* bytes of mapped input per thread */
+#define AGG_MAX_THREADS 64
+#define AGG_MAX_BINS    10000
+
+typedef struct {
+    double sum, min, max;
+    long long count, bad;
+    const vec_kernels *vk;
+    int nbins;                    /* histogram: nbins bins over [lo, hi] */
+    double lo, hi;
+    long long *bins;              /* NULL unless binning */
+} agg_acc;
+
+#define SWAR_ONES 0x0101010101010101ULL
+
+static const uint32_t agg_pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+/* How many of the 8 little-endian bytes of w, from the first, are digits */
+static inline int swar_digit_run(uint64_t w) {
+    uint64_t t = (w & 0xF0F0F0F0F0F0F0F0ULL) | (((w + 6 * SWAR_ONES) & 0xF0F0F0F0F0F0F0F0ULL) >> 4);
+    uint64_t x = t ^ (0x33 * SWAR_ONES);
+    return x ? __builtin_ctzll(x) >> 3 : 8;
+}
+
+/* Value of 8 ASCII digits, the first one in the lowest byte */
+static inline uint32_t swar_parse8(uint64_t w) {
+    w -= 0x30 * SWAR_ONES;
+    w = w * 10 + (w >> 8);
+    w = ((w & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)) +
+         ((w >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))) >> 32;
+    return (uint32_t)w;
+}
+
+/* Value of the first k (0..8) ASCII digits of w: they are shifted to the
+ * top and the low bytes padded with '0'; shifts are split in two so k = 0
+ * and k = 8 stay defined */
+static inline uint32_t swar_parse_n(uint64_t w, int k) {
+    int s = 32 - 4 * k;
+    return swar_parse8(w << s << s | (0x30 * SWAR_ONES) >> (4 * k) >> (4 * k));
+}
+
+/* Consumes the digits at *pp, appending them to *w while it holds fewer
+ * than 19 (*taken counts those). Returns how many digits there were. */
+static inline int agg_digits(const char **pp, const char *end, uint64_t *w, int *taken) {
+    const char *p = *pp;
+    int total = 0, k = 8;
+    while (k == 8 && end - p >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, p, 8);
+        if ((k = swar_digit_run(chunk)) == 0) break;
+        if (*taken + k <= 19) {
+            *w = *w * agg_pow10[k] + swar_parse_n(chunk, k);
+            *taken += k;
+        } else {
+            for (int i = 0; i < k && *taken < 19; i++, (*taken)++) *w = *w * 10 + (p[i] - '0');
+        }
+        p += k;
+        total += k;
+    }
+    if (k == 8) {
+        for (; p < end && (unsigned)(*p - '0') < 10; p++, total++)
+            if (*taken < 19) { *w = *w * 10 + (*p - '0'); (*taken)++; }
+    }
+    *pp = p;
+    return total;
+}
+
+static inline int agg_sep(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* num_parse() of the field [s, t); t < end means a separator follows */
+static int agg_slow(const char *s, const char *t, const char *end, double *v) {
+    char tmp[64], *e;
+    if (t < end) {
+        *v = num_parse(s, &e);
+        return e == t;
+    }
+    if (t - s >= (long)sizeof(tmp)) return 0;
+    memcpy(tmp, s, t - s);
+    tmp[t - s] = '\0';
+    *v = num_parse(tmp, &e);
+    return e == tmp + (t - s);
+}
+
+/* First field of the line at p. Decimals of up to 19 digits whose value
+ * is exact are converted here; exponents and anything unusual go through
+ * num_parse(). Returns 1 for a number, 0 for a blank line, -1 otherwise,
+ * and sets *next to the start of the following line. */
+static int agg_line(const char *p, const char *end, double *v, const char **next) {
+    int rc = 0;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p < end && *p != '\n' && *p != '\r') {
+        const char *s = p, *d;
+        int neg = *p == '-', taken = 0, lead = 0, nf = 0, ni, seen;
+        uint64_t w = 0;
+        if (*p == '-' || *p == '+') p++;
+        d = p;
+        while (p < end && *p == '0') p++;
+        ni = agg_digits(&p, end, &w, &taken);
+        seen = p > d;
+        if (p < end && *p == '.') {
+            const char *f = ++p;
+            if (taken == 0) while (p < end && *p == '0') p++;
+            lead = (int)(p - f);
+            nf = agg_digits(&p, end, &w, &taken);
+            seen |= p > f;
+        }
+        if (seen && (p == end || agg_sep(*p)) && ni + nf == taken && w <= 1ULL << 53 && lead + nf <= 22) {
+            *v = (double)w / num_pow10[lead + nf];
+            if (neg) *v = -*v;
+            rc = 1;
+        } else {
+            const char *t = p;
+            while (t < end && !agg_sep(*t)) t++;
+            rc = agg_slow(s, t, end, v) ? 1 : -1;
+            p = t;
+        }
+    }
+    if (p < end && *p == '\n') {
+        *next = p + 1;
+    } else {
+        const char *nl = p < end ? memchr(p, '\n', end - p) : NULL;
+        *next = nl ? nl + 1 : end;
+    }
+    return rc;
+}
+
+#if defined(__x86_64__)
+/* The common line: [-]digits[.digits]\n within 16 bytes, at most 8 digits
+ * on either side of the point. SSE2 finds the newline and the non-digits
+ * in one compare each, so the line costs no per-byte branches. Returns
+ * the length including the newline, or 0 to leave the line to agg_line().
+ * p must have 32 readable bytes. */
+static inline int agg_line_sse2(const char *p, double *v) {
+    __m128i c = _mm_loadu_si128((const __m128i *)p);
+    unsigned digit = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                                     _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1))));
+    unsigned nl = _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')));
+    if (!nl) return 0;
+    int neg = p[0] == '-', e = __builtin_ctz(nl);
+    unsigned other = ~digit & ((1u << e) - 1) & ~(unsigned)neg;
+    int dot = other ? __builtin_ctz(other) : e;
+    if ((other & (other - 1)) || (dot < e && p[dot] != '.')) return 0;
+    int l1 = dot - neg, l2 = dot < e ? e - dot - 1 : 0;
+    if (l1 > 8 || l2 > 8 || l1 + l2 == 0) return 0;
+    uint64_t a, b;
+    memcpy(&a, p + neg, 8);
+    memcpy(&b, p + dot + 1, 8);
+    uint64_t w = (uint64_t)swar_parse_n(a, l1) * agg_pow10[l2] + swar_parse_n(b, l2);
+    if (w > 1ULL << 53) return 0;
+    double x = (double)w / num_pow10[l2];
+    *v = neg ? -x : x;
+    return e + 1;
+}
+#endif
+
+static void agg_fold(agg_acc *acc, const double *v, int n) {
+    acc->count += n;
+    if (!acc->bins) {
+        acc->vk->reduce(v, n, &acc->sum, &acc->min, &acc->max);
+        return;
+    }
+    double scale = acc->hi > acc->lo ? acc->nbins / (acc->hi - acc->lo) : 0;
+    for (int i = 0; i < n; i++) {
+        double b = (v[i] - acc->lo) * scale;
+        acc->bins[b >= acc->nbins ? acc->nbins - 1 : b > 0 ? (int)b : 0]++;
+    }
+}
+
+static void agg_scan(const char *p, const char *end, agg_acc *acc) {
+    double v[AGG_BLOCK];
+    int n = 0;
+    while (p < end) {
+        int rc;
+#if defined(__x86_64__)
+        if (end - p >= 32 && (rc = agg_line_sse2(p, &v[n])) > 0) {
+            p += rc;
+            if (++n == AGG_BLOCK) {
+                agg_fold(acc, v, n);
+                n = 0;
+            }
+            continue;
+        }
+#endif
+        rc = agg_line(p, end, &v[n], &p);
+        if (rc > 0 && ++n == AGG_BLOCK) {
+            agg_fold(acc, v, n);
+            n = 0;
+        } else if (rc < 0) {
+            acc->bad++;
+        }
+    }
+    agg_fold(acc, v, n);
+}
+
+typedef struct { const char *p, *end; agg_acc acc; } agg_part;
+
+static void *agg_thread(void *arg) {
+    agg_part *pt = arg;
+    agg_scan(pt->p, pt->end, &pt->acc);
+    return NULL;
+}
+
+/* Scans [p, end) split at newlines over up to default_threads() threads,
+ * at least AGG_THREAD_MIN bytes each, and merges the parts into acc */
+static void agg_region(const char *p, const char *end, agg_acc *acc) {
+    long nt = (end - p) / AGG_THREAD_MIN;
+    if (nt > default_threads()) nt = default_threads();
+    if (nt > AGG_MAX_THREADS) nt = AGG_MAX_THREADS;
+    agg_part *parts = nt > 1 ? calloc(nt, sizeof(agg_part)) : NULL;
+    long long *bins = parts && acc->bins ? calloc((size_t)nt * acc->nbins, sizeof(long long)) : NULL;
+    if (!parts || (acc->bins && !bins)) {
+        free(parts);
+        agg_scan(p, end, acc);
+        return;
+    }
+    pthread_t tids[AGG_MAX_THREADS];
+    int started[AGG_MAX_THREADS];
+    for (int i = 0; i < nt; i++) {
+        const char *stop = i == nt - 1 ? end : p + (end - p) / (nt - i);
+        if (stop < end && stop > p) {
+            const char *nl = memchr(stop - 1, '\n', end - stop + 1);
+            stop = nl ? nl + 1 : end;
+        }
+        parts[i] = (agg_part){ p, stop, *acc };
+        parts[i].acc.sum = 0;
+        parts[i].acc.count = parts[i].acc.bad = 0;
+        parts[i].acc.min = HUGE_VAL;
+        parts[i].acc.max = -HUGE_VAL;
+        if (bins) parts[i].acc.bins = bins + (size_t)i * acc->nbins;
+        started[i] = i > 0 && pthread_create(&tids[i], NULL, agg_thread, &parts[i]) == 0;
+        if (i > 0 && !started[i]) agg_thread(&parts[i]);
+        p = stop;
+    }
+    agg_thread(&parts[0]);
+    for (int i = 0; i < nt; i++) {
+        if (started[i]) pthread_join(tids[i], NULL);
+        agg_acc *a = &parts[i].acc;
+        acc->sum += a->sum;
+        acc->count += a->count;
+        acc->bad += a->bad;
+        if (a->min < acc->min) acc->min = a->min;
+        if (a->max > acc->max) acc->max = a->max;
+        for (int b = 0; bins && b < acc->nbins; b++) acc->bins[b] += a->bins[b];
+    }
+    free(bins);
+    free(parts);
+}
+
+typedef struct { char *data; size_t len, maplen; } agg_input;    /* maplen != 0: mapped */
+
+/* The rest of fd in memory: mapped when it is a regular file, read
+ * otherwise */
+static int agg_load(int fd, agg_input *in) {
+    struct stat st;
+    *in = (agg_input){ NULL, 0, 0 };
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        off_t off = lseek(fd, 0, SEEK_CUR);
+        if (off < 0) off = 0;
+        if (st.st_size <= off) return 1;
+        void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            madvise(m, st.st_size, MADV_SEQUENTIAL);
+            *in = (agg_input){ (char *)m + off, st.st_size - off, st.st_size };
+            lseek(fd, 0, SEEK_END);
+            return 1;
+        }
+    }
+    in->data = read_all(fd, &in->len);
+    return in->data != NULL;
+}
+
+static void agg_unload(agg_input *in) {
+    if (in->maplen) munmap(in->data + in->len - in->maplen, in->maplen);
+    else free(in->data);
+}
+
+/* Feeds a pipe or terminal to acc a block of whole lines at a time */
+static int agg_stream(int fd, agg_acc *acc) {
+    size_t cap = AGG_READ, have = 0;
+    char *buf = malloc(cap);
+    if (!buf) return 0;
+    for (;;) {
+        if (have == cap && !grow(&buf, &cap, cap + 1)) { free(buf); return 0; }
+        ssize_t r = read(fd, buf + have, cap - have);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) { free(buf); return 0; }
+        if (r == 0) break;
+        have += r;
+        char *nl = memrchr(buf, '\n', have);
+        if (!nl) continue;
+        agg_scan(buf, nl + 1, acc);
+        have -= nl + 1 - buf;
+        memmove(buf, nl + 1, have);
+    }
+    agg_scan(buf, buf + have, acc);
+    free(buf);
+    return 1;
+}
+
+/* sum | mean | minmax | count | histogram [-n BINS], each [FILE...] */
+int bi_aggregate(char **argv, int in_fd, out_buf *out) {
+    const char *name = argv[0];
+    char *stdin_only[] = { "-", NULL }, a[NUM_FORMAT_MAX], b[NUM_FORMAT_MAX], line[2 * NUM_FORMAT_MAX + 32];
+    agg_acc acc = { .min = HUGE_VAL, .max = -HUGE_VAL, .vk = select_kernels(), .nbins = 10 };
+    int hist = strcmp(name, "histogram") == 0, argi = 1, nfiles = 0, rc = 0, n;
+    if (hist && argv[1] && strcmp(argv[1], "-n") == 0) {
+        acc.nbins = argv[2] ? atoi(argv[2]) : 0;
+        if (acc.nbins < 1 || acc.nbins > AGG_MAX_BINS) {
+            fprintf(stderr, "Usage: histogram [-n BINS] [FILE...] (1 <= BINS <= %d)\n", AGG_MAX_BINS);
+            return 1;
+        }
+        argi = 3;
+    }
+    char **files = argv[argi] ? argv + argi : stdin_only;
+    while (files[nfiles]) nfiles++;
+    agg_input *inputs = calloc(nfiles, sizeof(agg_input));
+    if (!inputs) { perror("malloc"); return 1; }
+
+    /* histogram keeps every input for the second pass */
+    for (int i = 0; i < nfiles; i++) {
+        int fd = strcmp(files[i], "-") == 0 ? in_fd : open(files[i], O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        int ok;
+        if (fd < 0) { fprintf(stderr, "%s: %s: %s\n", name, files[i], strerror(errno)); rc = 1; continue; }
+        if (!hist && (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))) {
+            ok = agg_stream(fd, &acc);
+        } else if ((ok = agg_load(fd, &inputs[i]))) {
+            agg_region(inputs[i].data, inputs[i].data + inputs[i].len, &acc);
+            if (!hist) agg_unload(&inputs[i]);
+        }
+        if (!ok) { fprintf(stderr, "%s: %s: %s\n", name, files[i], strerror(errno)); rc = 1; }
+        if (fd != in_fd) close(fd);
+    }
+    if (hist && acc.count > 0 && (acc.bins = calloc(acc.nbins, sizeof(long long)))) {
+        acc.lo = acc.min;
+        acc.hi = acc.max;
+        acc.count = acc.bad = 0;
+        for (int i = 0; i < nfiles; i++) agg_region(inputs[i].data, inputs[i].data + inputs[i].len, &acc);
+    }
+    for (int i = 0; hist && i < nfiles; i++) if (inputs[i].data) agg_unload(&inputs[i]);
+    free(inputs);
+
+    if (acc.bad > 0) {
+        fprintf(stderr, "%s: skipped %lld lines that are not numbers\n", name, acc.bad);
+        rc = 1;
+    }
+    if (strcmp(name, "count") == 0) {
+        n = snprintf(line, sizeof(line), "%lld\n", acc.count);
+        out_write(out, line, n);
+    } else if (strcmp(name, "sum") == 0) {
+        out_double(out, acc.sum);
+    } else if (acc.count == 0) {
+        fprintf(stderr, "%s: no numbers in input\n", name);
+        rc = 1;
+    } else if (strcmp(name, "mean") == 0) {
+        out_double(out, acc.sum / acc.count);
+    } else if (strcmp(name, "minmax") == 0) {
+        num_format(acc.min, a);
+        num_format(acc.max, b);
+        n = snprintf(line, sizeof(line), "%s %s\n", a, b);
+        out_write(out, line, n);
+    } else if (!acc.bins) {
+        perror("malloc");
+        rc = 1;
+    } else {
+        double width = (acc.hi - acc.lo) / acc.nbins;
+        for (int i = 0; i < acc.nbins; i++) {
+            num_format(acc.lo + width * i, a);
+            num_format(i == acc.nbins - 1 ? acc.hi : acc.lo + width * (i + 1), b);
+            n = snprintf(line, sizeof(line), "%s\t%s\t%lld\n", a, b, acc.bins[i]);
+            out_write(out, line, n);
+        }
+    }
+    free(acc.bins);
+    return rc;
+}
+
+static const builtin builtins[] = {
+    { "bg", bi_bg, 0 }, { "cachestat", bi_cachestat, 0 }, { "cat", bi_cat, BI_PASSTHRU | BI_NOSTATE | BI_NOOPTS },
+    { "cd", bi_cd, 0 }, { "count", bi_aggregate, BI_NOSTATE }, { "echo", bi_echo, BI_NOINPUT | BI_NOSTATE },
+    { "exit", bi_exit, 0 }, { "false", bi_false, BI_NOINPUT | BI_NOSTATE }, { "fg", bi_fg, 0 },
+    { "hash", bi_hash, 0 }, { "histogram", bi_aggregate, BI_NOSTATE }, { "jobs", bi_jobs, 0 },
+    { "mean", bi_aggregate, BI_NOSTATE }, { "minmax", bi_aggregate, BI_NOSTATE },
+    { "parallel", bi_parallel, 0 }, { "pipesize", bi_pipesize, 0 },
+    { "printf", bi_printf, BI_NOINPUT | BI_NOSTATE }, { "pwd", bi_pwd, BI_NOINPUT | BI_NOSTATE },
+    { "stats", bi_stats, BI_NOINPUT }, { "sum", bi_aggregate, BI_NOSTATE },
+    { "true", bi_true, BI_NOINPUT | BI_NOSTATE }, { "wait", bi_wait, 0 },
+};
+#define NUM_BUILTINS ((int)(sizeof(builtins) / sizeof(builtins[0])))
+
+/* Perfect hash over the builtin names: on first use, search for a seed that
+ * puts every name in its own slot, so a lookup is one hash and one strcmp. */
+#define BUILTIN_SLOTS 64
+static signed char builtin_slot[BUILTIN_SLOTS];
+static unsigned builtin_seed;
+
+static void build_builtin_hash(void) {
+    for (unsigned seed = 1; ; seed++) {
+        int i;
+        memset(builtin_slot, -1, sizeof(builtin_slot));
+        for (i = 0; i < NUM_BUILTINS; i++) {
+            unsigned h = name_hash(builtins[i].name, seed) & (BUILTIN_SLOTS - 1);
+            if (builtin_slot[h] >= 0) break;
+            builtin_slot[h] = (signed char)i;
+        }
+        if (i == NUM_BUILTINS) { builtin_seed = seed; return; }
+    }
+}
+
+const builtin *find_builtin(const char *name) {
+    if (!builtin_seed) build_builtin_hash();
+    int i = builtin_slot[name_hash(name, builtin_seed) & (BUILTIN_SLOTS - 1)];
+    return i >= 0 && strcmp(builtins[i].name, name) == 0 ? &builtins[i] : NULL;
+}
+
+/* The builtin that runs args, or NULL when it is an external command: a
+ * BI_NOOPTS builtin given an option ("-" alone is stdin) leaves the line
+ * to the program, e.g. cat -n */
+const builtin *stage_builtin(char **args) {
+    const builtin *bi = find_builtin(args[0]);
+    if (bi && (bi->flags & BI_NOOPTS))
+        for (char **a = args + 1; *a; a++)
+            if ((*a)[0] == '-' && (*a)[1]) return NULL;
+    return bi;
+}
+
+/* Runs bi in the calling thread; -1 fds mean the shell's own stdin/stdout */
+int run_builtin(const builtin *bi, char **argv, int in_fd, int out_fd) {
+    out_buf out;
+    fflush(stdout);
+    if (!out_init(&out, out_fd < 0 ? 1 : out_fd, BUILTIN_OUT_SIZE)) { perror("malloc"); return 1; }
+    int rc = bi->fn(argv, in_fd < 0 ? 0 : in_fd, &out);
+    out_close(&out);
+    return rc;
+}
+
+/* One stage of a parsed pipeline. nfused > 1 marks the first stage of a
+ * fused run that executes stages [i, i + nfused) as a single in-process
+ * stage; the other members of the run get nfused == 0. */
+enum { WORD_VAR = 1, WORD_SUBST = 2 };               /* unquoted $NAME, holds $(...) */
+enum { REDIR_APPEND = 1, REDIR_ERR_APPEND = 2, REDIR_ERR_TO_OUT = 4 };   /* >>, 2>>, 2>&1 */
+
+typedef struct {
+    char **args;                  /* NULL-terminated */
+    char *input_file, *output_file, *error_file;
+    struct here_doc *here;        /* <<, <<< input instead of input_file */
+    int redir;                    /* REDIR_* */
+    const builtin *bi;
+    int nfused;
+    unsigned char *vars;          /* WORD_* flags of each of args; NULL if no word has any */
+} stage_cmd;
+
+int fuse_stages = 1;             /* OSHELL_FUSE=0 turns stage fusion off */
+
+static int fusible(const stage_cmd *st) {
+    if (st->error_file || (st->redir & REDIR_ERR_TO_OUT)) return 0;    /* stderr is the shell's own */
+    return st->bi && ((st->bi->flags & BI_NOINPUT) || ((st->bi->flags & BI_PASSTHRU) && !st->args[1]));
+}
+
+/* Marks runs of adjacent fusible stages; redirects may only sit on the
+ * outer edges of a run. run_fused() skips the stages before the last
+ * BI_NOINPUT one, so a stage that changes the shell (stats -r) can only
+ * end a run. Returns the number of stages left to execute. */
+int fuse_pipeline(stage_cmd *st, int n) {
+    int units = 0;
+    for (int i = 0; i < n; ) {
+        int j = i + 1;
+        if (fuse_stages && fusible(&st[i])) {
+            while (j < n && fusible(&st[j]) && (st[j - 1].bi->flags & BI_NOSTATE) && !st[j - 1].output_file &&
+                   !st[j].input_file && !st[j].here) j++;
+        }
+        st[i].nfused = j - i;
+        for (int k = i + 1; k < j; k++) st[k].nfused = 0;
+        units++;
+        i = j;
+    }
+    return units;
+}
+
+static int write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) return -1;
+        p += w;
+        n -= w;
+    }
+    return 0;
+}
+
+/* Runs a fused run of n stages. Everything before the last stage that
+ * ignores its input cannot affect the output, so execution starts there and
+ * the data moves on to the pass-through stages by pointer. A run of pure
+ * pass-through stages is a single move_data() from in_fd to out_fd. */
+int run_fused(stage_cmd *g, int n, int in_fd, int out_fd) {
+    int start = n - 1, rc = 0;
+    while (start > 0 && !(g[start].bi->flags & BI_NOINPUT)) start--;
+    if (in_fd < 0) in_fd = 0;
+    if (out_fd < 0) out_fd = 1;
+    fflush(stdout);
+    if (!(g[start].bi->flags & BI_NOINPUT)) {
+        if (move_data(in_fd, out_fd) < 0 && errno != EPIPE) { perror("cat"); return 1; }
+        return 0;
+    }
+    out_buf data;
+    if (!out_init(&data, -1, 4096)) { perror("malloc"); return 1; }
+    rc = g[start].bi->fn(g[start].args, -1, &data);
+    /* g[start + 1 .. n) are pass-through: data.buf is already their output */
+    if (start < n - 1) rc = 0;
+    if (write_all(out_fd, data.buf, data.len) < 0 && errno != EPIPE) { perror("write"); rc = 1; }
+    out_close(&data);
+    return rc;
+}
+
+/* Runs a builtin or fused stage in the calling thread */
+int run_inproc(stage_cmd *st, int in_fd, int out_fd) {
+    uint64_t t0 = trace_tick();
+    int rc = st->nfused > 1 ? run_fused(st, st->nfused, in_fd, out_fd)
+                            : run_builtin(st->bi, st->args, in_fd, out_fd);
+    trace_record(TRACE_STAGE, st->args[0], t0, trace_tick(), TRACE_NO_CPU);
+    return rc;
+}
+
+/* Thread-backed pipeline stage. The stage owns duplicates of its fds so the
+ * shell can close its pipe ends as usual; closing the write end on return is
+ * what delivers EOF downstream. */
+typedef struct {
+    stage_cmd *st;
+    int in_fd, out_fd;
+    int status;
+} builtin_stage;
+
+static void *builtin_thread(void *arg) {
+    builtin_stage *bs = arg;
+    bs->status = run_inproc(bs->st, bs->in_fd, bs->out_fd);
+    if (bs->in_fd >= 0) close(bs->in_fd);
+    if (bs->out_fd >= 0) close(bs->out_fd);
+    return NULL;
+}
+
+builtin_stage *start_builtin_thread(stage_cmd *st, int in_fd, int out_fd, pthread_t *tid) {
+    builtin_stage *bs = malloc(sizeof(*bs));
+    if (!bs) return NULL;
+    bs->st = st;
+    bs->in_fd = in_fd >= 0 ? fcntl(in_fd, F_DUPFD_CLOEXEC, 0) : -1;
+    bs->out_fd = out_fd >= 0 ? fcntl(out_fd, F_DUPFD_CLOEXEC, 0) : -1;
+    if (pthread_create(tid, NULL, builtin_thread, bs) != 0) {
+        if (bs->in_fd >= 0) close(bs->in_fd);
+        if (bs->out_fd >= 0) close(bs->out_fd);
+        free(bs);
+        return NULL;
+    }
+    return bs;
+}
+
+/* Fork fallback for background pipelines, which must outlive the command
+ * line. Without an exec, O_CLOEXEC does not help, so every pipe end the
+ * shell holds is closed in the child after the dup2s. */
+pid_t fork_builtin(stage_cmd *st, int in_fd, int out_fd, int err_fd, const int *fds, int nfds) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (size_t i = 0; i < sizeof(shell_signals) / sizeof(shell_signals[0]); i++)
+            signal(shell_signals[i], SIG_DFL);
+        if (in_fd >= 0) dup2(in_fd, 0);
+        if (out_fd >= 0) dup2(out_fd, 1);
+        if (err_fd >= 0) dup2(err_fd, 2);
+        for (int i = 0; i < nfds; i++) close(fds[i]);
+        _exit(run_inproc(st, 0, 1));
+    }
+    return pid;
+}
+
+/* Evaluation daemon: oshell --serve SOCK keeps the evaluator resident on a
+ * Unix stream socket. Requests and replies are frames of a 4-byte length
+ * in network order followed by that many bytes. A request is one
+ * expression; its reply is the value as -e prints it (without the
+ * newline), or "error: " and the message -e would print on stderr, e.g.
+ * "error: Error: div by zero". Clients may pipeline any number of
+ * requests; replies come back in order on the same connection.
+ * Each worker thread runs its own epoll loop. All of them wait on the
+ * listening socket with EPOLLEXCLUSIVE, and a connection stays with the
+ * worker that accepted it, so nothing is handed between threads. */
+#define SERVE_MAX_FRAME (64 * 1024)
+#define SERVE_MAX_PENDING (1 << 20)     /* unsent reply bytes before reading pauses */
+#define SERVE_EVENTS 64
+
+typedef struct {
+    int fd, eof;
+    char *in, *out;
+    size_t in_len, in_cap, out_len, out_off, out_cap;
+} serve_conn;
+
+static void conn_free(serve_conn *c) {
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+/* Appends one reply frame */
+static int conn_reply(serve_conn *c, const char *body, uint32_t len) {
+    uint32_t be = htonl(len);
+    if (c->out_off > 0 && c->out_off == c->out_len) c->out_off = c->out_len = 0;
+    if (!grow(&c->out, &c->out_cap, c->out_len + sizeof(be) + len)) return 0;
+    memcpy(c->out + c->out_len, &be, sizeof(be));
+    memcpy(c->out + c->out_len + sizeof(be), body, len);
+    c->out_len += sizeof(be) + len;
+    return 1;
+}
+
+/* Evaluates every complete frame in the input buffer. Returns 0 if the
+ * peer sent a frame that is too large. */
+static int conn_process(serve_conn *c) {
+    size_t off = 0;
+    char expr[SERVE_MAX_FRAME + 1], reply[256];
+    while (c->in_len - off >= 4 && c->out_len - c->out_off < SERVE_MAX_PENDING) {
+        uint32_t len;
+        memcpy(&len, c->in + off, sizeof(len));
+        len = ntohl(len);
+        if (len > SERVE_MAX_FRAME) return 0;
+        if (c->in_len - off - 4 < len) break;
+        memcpy(expr, c->in + off + 4, len);
+        expr[len] = '\0';
+        off += 4 + len;
+
+        double val;
+        int wide = 0, rc = eval_cached(expr, &val, &wide), n;
+        char *s = rc == 1 ? exact_digits(expr, wide, 1) : NULL;
+        if (s) {
+            int ok = conn_reply(c, s, strlen(s));
+            free(s);
+            if (!ok) return 0;
+            continue;
+        }
+        if (rc == 1) n = num_format(val, reply);
+        else if (rc == 0) {
+            memcpy(reply, "error: ", 7);
+            n = 7 + expr_error_text(expr, reply + 7, sizeof(reply) - 7);
+        }
+        else n = snprintf(reply, sizeof(reply), "error: %s", run_error ? run_error : "evaluation failed");
+        if (n >= (int)sizeof(reply)) n = sizeof(reply) - 1;
+        if (!conn_reply(c, reply, n)) return 0;
+    }
+    memmove(c->in, c->in + off, c->in_len - off);
+    c->in_len -= off;
+    return 1;
+}
+
+/* Returns 0 once the connection should be closed */
+static int conn_flush(serve_conn *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = write(c->fd, c->out + c->out_off, c->out_len - c->out_off);
+        if (n < 0 && errno == EAGAIN) return 1;
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return 0;
+        c->out_off += n;
+    }
+    c->out_off = c->out_len = 0;
+    return 1;
+}
+
+/* Reads and evaluates until the socket is drained, the peer has closed
+ * its end (c->eof) or too many replies are waiting to be sent */
+static int conn_read(serve_conn *c) {
+    while (!c->eof && c->out_len - c->out_off < SERVE_MAX_PENDING) {
+        if (!grow(&c->in, &c->in_cap, c->in_len + 16384)) return 0;
+        ssize_t n = read(c->fd, c->in + c->in_len, c->in_cap - c->in_len);
+        if (n < 0 && errno == EAGAIN) return 1;
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return 0;
+        if (n == 0) c->eof = 1;
+        c->in_len += n;
+        if (!conn_process(c)) return 0;
+    }
+    return 1;
+}
+
+static void *serve_worker(void *arg) {
+    int lfd = *(int *)arg;
+    run_quiet = 1;               /* errors go back in the reply */
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = NULL }, events[SERVE_EVENTS];
+    if (ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &ev) < 0) { perror("epoll"); return NULL; }
+
+    for (;;) {
+        int n = epoll_wait(ep, events, SERVE_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            serve_conn *c = events[i].data.ptr;
+            if (c == NULL) {
+                int fd;
+                while ((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    serve_conn *nc = calloc(1, sizeof(*nc));
+                    struct epoll_event cev = { .events = EPOLLIN | EPOLLRDHUP };
+                    if (!nc) { close(fd); continue; }
+                    nc->fd = fd;
+                    cev.data.ptr = nc;
+                    if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &cev) < 0) conn_free(nc);
+                }
+                continue;
+            }
+            int ok = 1;
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) ok = conn_read(c);
+            /* frames held back by a full reply buffer go once it drains */
+            if (ok) ok = conn_flush(c) && conn_process(c) && conn_flush(c);
+            if (!ok || (c->eof && c->out_off == c->out_len)) {
+                epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+                conn_free(c);
+                continue;
+            }
+            struct epoll_event cev = { .events = c->out_len > c->out_off ? EPOLLOUT : 0 };
+            if (!c->eof && c->out_len - c->out_off < SERVE_MAX_PENDING) cev.events |= EPOLLIN | EPOLLRDHUP;
+            cev.data.ptr = c;
+            epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &cev);
+        }
+        if (n < 0 && errno != EINTR) { perror("epoll_wait"); break; }
+    }
+    close(ep);
+    return NULL;
+}
+
+static int serve_address(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) { errno = ENAMETOOLONG; return -1; }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+/* Runs until killed. Returns only if the socket cannot be set up. */
+int serve(const char *path, int nthreads) {
+    struct sockaddr_un addr;
+    struct stat sb;
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (lfd < 0 || serve_address(path, &addr) < 0) { perror("serve"); return -1; }
+    if (stat(path, &sb) == 0 && S_ISSOCK(sb.st_mode)) unlink(path);    /* stale socket */
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, SOMAXCONN) < 0) {
+        fprintf(stderr, "serve: %s: %s\n", path, strerror(errno));
+        close(lfd);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_t *tids = malloc(nthreads * sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; tids && i < nthreads; i++)
+        if (pthread_create(&tids[started], NULL, serve_worker, &lfd) == 0) started++;
+    if (started == 0) { perror("serve: pthread_create"); close(lfd); free(tids); return -1; }
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+    free(tids);
+    close(lfd);
+    unlink(path);
+    return 0;
+}
+
+/* Client side: one connection, blocking I/O */
+int serve_connect(const char *path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (serve_address(path, &addr) < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+    for (size_t off = 0; off < len; ) {
+        ssize_t n = read(fd, (char *)buf + off, len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        off += n;
+    }
+    return 1;
+}
+
+int serve_send(int fd, const char *expr) {
+    size_t len = strlen(expr);
+    uint32_t be = htonl((uint32_t)len);
+    if (len > SERVE_MAX_FRAME) { errno = EMSGSIZE; return 0; }
+    return write_all(fd, (const char *)&be, sizeof(be)) == 0 && write_all(fd, expr, len) == 0;
+}
+
+/* Reads one reply into buf (NUL-terminated, truncated to cap).
+ * Returns the reply length, or -1 if the connection failed. */
+int serve_recv(int fd, char *buf, size_t cap) {
+    uint32_t len;
+    char skip[256];
+    if (!read_full(fd, &len, sizeof(len))) return -1;
+    len = ntohl(len);
+    size_t keep = len < cap - 1 ? len : cap - 1;
+    if (!read_full(fd, buf, keep)) return -1;
+    buf[keep] = '\0';
+    for (size_t left = len - keep; left > 0; ) {
+        size_t n = left < sizeof(skip) ? left : sizeof(skip);
+        if (!read_full(fd, skip, n)) return -1;
+        left -= n;
+    }
+    return (int)len;
+}
+
+/* A whole reply, NUL-terminated in malloc'd memory; NULL on error */
+char *serve_recv_text(int fd) {
+    uint32_t len;
+    if (!read_full(fd, &len, sizeof(len))) return NULL;
+    len = ntohl(len);
+    char *s = malloc((size_t)len + 1);
+    if (s && !read_full(fd, s, len)) { free(s); return NULL; }
+    if (s) s[len] = '\0';
+    return s;
+}
+
+/* Command line lexer. Words are unquoted in place and NUL-terminated inside
+ * the line itself, so argv entries are slices of the line and nothing is
+ * copied. Quoting: '...' is literal; "..." honours \" \\ \$ and \`; a
+ * backslash outside quotes takes the next byte literally.
+ * A $(...) is kept whole, between two SUBST_BARE (or, inside "...",
+ * SUBST_QUOTED) bytes, for expand_stages() to run when the stage does.
+ * The body of a here-document starts on the line after the operator and
+ * ends before the line that is exactly its delimiter; the lexer steps over
+ * it at that newline and records where it is. */
+enum { TOK_END, TOK_WORD, TOK_PIPE, TOK_AMP, TOK_IN, TOK_OUT, TOK_APPEND,
+       TOK_ERR_OUT, TOK_ERR_APPEND, TOK_ERR_DUP, TOK_HEREDOC, TOK_HERESTR, TOK_ERROR };
+
+#define SUBST_BARE   '\001'
+#define SUBST_QUOTED '\002'
+
+/* Input of a stage from <<DELIM (text is the body in the line) or <<< WORD
+ * (text is the word, expanded and given a newline when the stage runs) */
+typedef struct here_doc {
+    char *delim;
+    char *text;
+    size_t len;
+    int string;                   /* <<< */
+    int flags;                    /* WORD_* of a <<< word */
+} here_doc;
+
+typedef struct {
+    char *p;                      /* next unread byte */
+    char held;                    /* operator overwritten by the NUL ending the previous word */
+    char *word;                   /* text of the last TOK_WORD */
+    int dollar;                   /* ... and it began with an unquoted '$' */
+    int subst;                    /* ... and it holds a $(...) */
+    const char *err;              /* reason for TOK_ERROR */
+    here_doc **here;              /* here-documents seen, in order, grown by parse_pipeline() */
+    int nhere, nbody, here_cap;   /* ... how many have their body, and room */
+    int want_delim;               /* the next word is a delimiter */
+} lexer;
+
+/* Bytes that end or change the scan of a word */
+enum { LEX_PLAIN, LEX_BLANK, LEX_OP, LEX_QUOTE, LEX_END };
+static const unsigned char lex_class[256] = {
+    ['\0'] = LEX_END, [' '] = LEX_BLANK, ['\t'] = LEX_BLANK, ['\n'] = LEX_BLANK,
+    ['\v'] = LEX_BLANK, ['\f'] = LEX_BLANK, ['\r'] = LEX_BLANK,
+    ['|'] = LEX_OP, ['&'] = LEX_OP, ['<'] = LEX_OP, ['>'] = LEX_OP,
+    ['\''] = LEX_QUOTE, ['"'] = LEX_QUOTE, ['\\'] = LEX_QUOTE, ['$'] = LEX_QUOTE,
+};
+
+/* The ')' that closes the '(' at p, skipping quoted text; NULL if none */
+static char *subst_end(const char *p) {
+    int depth = 0;
+    for (; *p; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        } else if (*p == '\'') {
+            if (!(p = strchr(p + 1, '\''))) return NULL;
+        } else if (*p == '"') {
+            for (p++; *p && *p != '"'; p++)
+                if (*p == '\\' && p[1]) p++;
+            if (!*p) return NULL;
+        } else if (*p == '(') {
+            depth++;
+        } else if (*p == ')' && --depth == 0) {
+            return (char *)p;
+        }
+    }
+    return NULL;
+}
+
+/* Moves the $(...) whose '(' is at r to *w as mark, text, mark; returns
+ * the byte after the ')' */
+static char *lex_subst(lexer *lx, char *r, char **w, char mark) {
+    char *e = subst_end(r);
+    if (!e) { lx->err = "unterminated $("; return NULL; }
+    size_t n = e - r - 1;
+    *(*w)++ = mark;
+    memmove(*w, r + 1, n);
+    *w += n;
+    *(*w)++ = mark;
+    lx->subst = 1;
+    return e + 1;
+}
+
+/* Finds the bodies of the here-documents still waiting for one, starting
+ * at r; returns the start of the line after the last delimiter. A body
+ * with no delimiter line runs to the end of the text. */
+static char *lex_bodies(lexer *lx, char *r) {
+    for (; lx->nbody < lx->nhere; lx->nbody++) {
+        here_doc *h = lx->here[lx->nbody];
+        size_t dlen = strlen(h->delim);
+        h->text = r;
+        for (;;) {
+            char *nl = strchr(r, '\n');
+            size_t n = nl ? (size_t)(nl - r) : strlen(r);
+            if (n == dlen && memcmp(r, h->delim, n) == 0) {
+                h->len = r - h->text;
+                r = nl ? nl + 1 : r + n;
+                break;
+            }
+            r += nl ? n + 1 : n;
+            if (!nl) { h->len = r - h->text; break; }
+        }
+    }
+    return r;
+}
+
+static int lex_op(lexer *lx, char c) {
+    switch (c) {
+        case '|': return TOK_PIPE;
+        case '&': return TOK_AMP;
+        case '<':
+            if (lx->p[0] != '<') return TOK_IN;
+            if (lx->p[1] == '<') { lx->p += 2; return TOK_HERESTR; }
+            lx->p++;
+            lx->want_delim = 1;
+            return TOK_HEREDOC;
+        case '>':
+            if (lx->p[0] != '>') return TOK_OUT;
+            lx->p++;
+            return TOK_APPEND;
+        default:  return TOK_END;
+    }
+}
+
+int lex_next(lexer *lx) {
+    if (lx->held) {
+        int t = lex_op(lx, lx->held);
+        lx->held = 0;
+        return t;
+    }
+    char *r = lx->p;
+    while (lex_class[(unsigned char)*r] == LEX_BLANK)
+        r = *r == '\n' && lx->nbody < lx->nhere ? lex_bodies(lx, r + 1) : r + 1;
+    if (*r == '\0') { lx->p = r; return TOK_END; }
+    if (lex_class[(unsigned char)*r] == LEX_OP) { lx->p = r + 1; return lex_op(lx, *r); }
+
+    char *w = r;
+    lx->word = r;
+    lx->dollar = *r == '$';
+    lx->subst = 0;
+    while (lex_class[(unsigned char)*r] == LEX_PLAIN) r++;    /* nothing to move until a quote */
+    /* 2>, 2>>, 2>&1; 1> is > */
+    if (*r == '>' && r == lx->word + 1 && (*lx->word == '1' || *lx->word == '2')) {
+        lx->p = r + 1;
+        if (*lx->word == '1') return lex_op(lx, '>');
+        if (lx->p[0] == '&' && lx->p[1] == '1') { lx->p += 2; return TOK_ERR_DUP; }
+        return lex_op(lx, '>') == TOK_APPEND ? TOK_ERR_APPEND : TOK_ERR_OUT;
+    }
+    w = r;
+    for (;;) {
+        while (lex_class[(unsigned char)*r] == LEX_PLAIN) *w++ = *r++;
+        if (lex_class[(unsigned char)*r] != LEX_QUOTE) break;
+        char c = *r++;
+        if (c == '\\') {
+            if (*r) *w++ = *r++;
+        } else if (c == '$') {
+            if (*r != '(') *w++ = c;
+            else if (!(r = lex_subst(lx, r, &w, SUBST_BARE))) return TOK_ERROR;
+        } else if (c == '\'') {
+            while (*r && *r != '\'') *w++ = *r++;
+            if (!*r) { lx->err = "unterminated '"; return TOK_ERROR; }
+            r++;
+        } else if (c == '"') {
+            while (*r && *r != '"') {
+                if (*r == '$' && r[1] == '(') {
+                    if (!(r = lex_subst(lx, r + 1, &w, SUBST_QUOTED))) return TOK_ERROR;
+                    continue;
+                }
+                if (*r == '\\' && r[1] && strchr("\"\\$`", r[1])) r++;
+                *w++ = *r++;
+            }
+            if (!*r) { lx->err = "unterminated \""; return TOK_ERROR; }
+            r++;
+        }
+    }
+    if (lx->want_delim) {
+        lx->here[lx->nhere - 1]->delim = lx->word;
+        lx->want_delim = 0;
+    }
+    char end = *r;
+    *w = '\0';
+    if (end == '\0') lx->p = r;
+    else if (end == '\n' && lx->nbody < lx->nhere) lx->p = lex_bodies(lx, r + 1);
+    else if (lex_class[(unsigned char)end] == LEX_BLANK) lx->p = r + 1;  /* the blank becomes the NUL */
+    else if (w == r) { lx->held = end; lx->p = r + 1; }         /* the operator does */
+    else lx->p = r;
+    return TOK_WORD;
+}
+
+/* A pipeline parsed once and runnable any number of times: argv arrays and
+ * redirect file names point into the line that was parsed, stages are
+ * already fused, and the fd and pid tables exec_pipeline() fills are
+ * allocated along with it. Everything lives in the arena given to
+ * parse_pipeline(). */
+typedef struct {
+    stage_cmd *stages;
+    int num_commands, num_units;
+    int background, pipe_size;
+    int expand;                   /* some stage has $NAME words */
+    int *pipefds;                 /* 2 per pipe between units */
+    pid_t *pids;
+    char **pid_names;
+    uint64_t *started;            /* trace_tick() at each pid's spawn */
+    pthread_t *tids;
+    builtin_stage **threads;
+} pipeline;
+
+static int parse_fail(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+    return 0;
 }
 
-/* Fast exponentiation (no threads) */
-double parallel_pow(double base, int exp) {
-    double result = 1;
-    while (exp > 0) {
-        if (exp & 1) result *= base;
-        base *= base;
-        exp >>= 1;
+/* Parses line (in place, in one pass) into p. Returns 0 for an empty or
+ * invalid line, after reporting what was wrong with it. */
+int parse_pipeline(char *line, pipeline *p, arena *a) {
+    lexer lx = { .p = line };
+    size_t nstages = 0, stage_cap = 4, nargs = 0, arg_cap = 8;
+    stage_cmd *stages = arena_alloc(a, stage_cap * sizeof(stage_cmd));
+    char **args = arena_alloc(a, arg_cap * sizeof(char *));
+    char *input_file = NULL, *output_file = NULL, *error_file = NULL;
+    here_doc *here = NULL;
+    unsigned char *vars = NULL;
+    int background = 0, expand = 0, redir = 0, t;
+    uint64_t t0 = trace_tick();
+    if (!stages || !args) return parse_fail("out of memory");
+
+    do {
+        t = lex_next(&lx);
+        switch (t) {
+        case TOK_ERROR:
+            return parse_fail(lx.err);
+        case TOK_WORD:
+            if (nargs + 1 == arg_cap) {
+                args = arena_grow(a, args, nargs * sizeof(char *), 2 * arg_cap * sizeof(char *));
+                if (vars && (vars = arena_grow(a, vars, nargs, 2 * arg_cap))) memset(vars + nargs, 0, 2 * arg_cap - nargs);
+                if (!args || (expand && !vars)) return parse_fail("out of memory");
+                arg_cap *= 2;
+            }
+            if ((lx.dollar || lx.subst) && !vars) {
+                if (!(vars = arena_alloc(a, arg_cap))) return parse_fail("out of memory");
+                memset(vars, 0, arg_cap);
+                expand = 1;
+            }
+            if (vars) vars[nargs] = (lx.dollar ? WORD_VAR : 0) | (lx.subst ? WORD_SUBST : 0);
+            args[nargs++] = lx.word;
+            break;
+        case TOK_IN:
+        case TOK_OUT:
+        case TOK_APPEND:
+        case TOK_ERR_OUT:
+        case TOK_ERR_APPEND:
+            if (lex_next(&lx) != TOK_WORD)
+                return parse_fail(t == TOK_IN ? "no input file specified" : "no output file specified");
+            if (t == TOK_IN) {
+                input_file = lx.word;
+                here = NULL;
+            } else if (t == TOK_OUT || t == TOK_APPEND) {
+                output_file = lx.word;
+                redir = (redir & ~REDIR_APPEND) | (t == TOK_APPEND ? REDIR_APPEND : 0);
+            } else {
+                error_file = lx.word;
+                redir = (redir & ~(REDIR_ERR_APPEND | REDIR_ERR_TO_OUT)) | (t == TOK_ERR_APPEND ? REDIR_ERR_APPEND : 0);
+            }
+            break;
+        case TOK_ERR_DUP:
+            error_file = NULL;
+            redir |= REDIR_ERR_TO_OUT;
+            break;
+        case TOK_HEREDOC:
+        case TOK_HERESTR:
+            if (!(here = arena_alloc(a, sizeof(here_doc)))) return parse_fail("out of memory");
+            memset(here, 0, sizeof(*here));
+            if (t == TOK_HEREDOC) {
+                if (lx.nhere == lx.here_cap) {
+                    int cap = lx.here_cap ? 2 * lx.here_cap : 4;
+                    lx.here = arena_grow(a, lx.here, lx.nhere * sizeof(here_doc *), cap * sizeof(here_doc *));
+                    if (!lx.here) return parse_fail("out of memory");
+                    lx.here_cap = cap;
+                }
+                lx.here[lx.nhere++] = here;
+            }
+            if (lex_next(&lx) != TOK_WORD)
+                return parse_fail(t == TOK_HEREDOC ? "no here-document delimiter" : "no here-string");
+            if (t == TOK_HERESTR) {
+                here->text = lx.word;
+                here->len = strlen(lx.word);
+                here->string = 1;
+                here->flags = (lx.dollar ? WORD_VAR : 0) | (lx.subst ? WORD_SUBST : 0);
+            }
+            input_file = NULL;
+            break;
+        case TOK_AMP:
+            background = 1;
+            if ((t = lex_next(&lx)) != TOK_END) return parse_fail("syntax error near '&'");
+            /* fall through */
+        case TOK_PIPE:
+        case TOK_END:
+            if (nargs == 0) {
+                if (t == TOK_END && nstages == 0 && !background && !input_file && !output_file &&
+                    !error_file && !here && !redir) return 0;
+                return parse_fail("empty command");
+            }
+            if (nstages == stage_cap) {
+                stages = arena_grow(a, stages, nstages * sizeof(stage_cmd), 2 * stage_cap * sizeof(stage_cmd));
+                if (!stages) return parse_fail("out of memory");
+                stage_cap *= 2;
+            }
+            args[nargs] = NULL;
+            stages[nstages++] = (stage_cmd){ .args = args, .input_file = input_file, .output_file = output_file,
+                                             .error_file = error_file, .here = here, .redir = redir,
+                                             .bi = stage_builtin(args), .nfused = 1, .vars = vars };
+            if (t == TOK_PIPE) {
+                nargs = 0;
+                arg_cap = 8;
+                input_file = output_file = error_file = NULL;
+                here = NULL;
+                redir = 0;
+                vars = NULL;
+                if (!(args = arena_alloc(a, arg_cap * sizeof(char *)))) return parse_fail("out of memory");
+            }
+            break;
+        }
+    } while (t != TOK_END);
+    for (; lx.nbody < lx.nhere; lx.nbody++) lx.here[lx.nbody]->text = "";   /* no line after the operator */
+
+    /* A leading "pipesize BYTES" sizes the pipes of this pipeline only */
+    p->pipe_size = pipe_size;
+    char **first = stages[0].args, *end;
+    if (strcmp(first[0], "pipesize") == 0 && first[1] && first[2]) {
+        long v = strtol(first[1], &end, 0);
+        if (end != first[1] && *end == '\0' && v >= 0) {
+            p->pipe_size = (int)v;
+            stages[0].args = first + 2;
+            if (stages[0].vars) stages[0].vars += 2;
+            stages[0].bi = stage_builtin(first + 2);
+        }
     }
-    return result;
+
+    /* Fuse adjacent builtin stages; pipes are only needed between the
+     * units that remain */
+    p->stages = stages;
+    p->num_commands = (int)nstages;
+    p->num_units = fuse_pipeline(stages, (int)nstages);
+    p->background = background;
+    p->expand = expand;
+    p->pipefds = arena_alloc(a, 2 * nstages * sizeof(int));
+    p->pids = arena_alloc(a, nstages * sizeof(pid_t));
+    p->pid_names = arena_alloc(a, nstages * sizeof(char *));
+    p->started = arena_alloc(a, nstages * sizeof(uint64_t));
+    p->tids = arena_alloc(a, nstages * sizeof(pthread_t));
+    p->threads = arena_alloc(a, nstages * sizeof(builtin_stage *));
+    if (!p->pipefds || !p->pids || !p->pid_names || !p->started || !p->tids || !p->threads)
+        return parse_fail("out of memory");
+    trace_record(TRACE_PARSE, stages[0].args[0], t0, trace_tick(), TRACE_NO_CPU);
+    return 1;
 }
 
-int parse_math_expression(const char *line, double *a, char *op, double *b) {
-    return sscanf(line, "%lf %c %lf", a, op, b) == 3;
+/* Shell variables, set by let and for. Blocks are compiled against the
+ * names (a name is an expression slot) and read the values when they run,
+ * so slots stay valid while the table grows. */
+typedef struct {
+    char **names;
+    double *values;
+    int n, cap;
+} var_table;
+
+static var_table shell_vars;
+
+int var_find(const char *name, size_t len) {
+    for (int i = 0; i < shell_vars.n; i++)
+        if (strncmp(shell_vars.names[i], name, len) == 0 && shell_vars.names[i][len] == '\0') return i;
+    return -1;
 }
 
-int eval_expr(const char *expr, double *out) {
-    double x, y; char op;
-    if (!parse_math_expression(expr, &x, &op, &y)) return 0;
-    switch (op) {
-        case '+': *out = x + y; break;
-        case '-': *out = x - y; break;
-        case '*': *out = x * y; break;
-        case '/': if (y == 0) { fprintf(stderr, "Error: div by zero\n"); return -1; } *out = x / y; break;
-        case '^': *out = parallel_pow(x, (int)y); break;
-        default: fprintf(stderr, "Unsupported operator: %c\n", op); return -1;
+/* Slot of name, created (as 0) if needed; -1 if out of memory */
+int var_slot(const char *name, size_t len) {
+    int i = var_find(name, len);
+    if (i >= 0) return i;
+    if (shell_vars.n == shell_vars.cap) {
+        int cap = shell_vars.cap ? 2 * shell_vars.cap : 16;
+        char **names = realloc(shell_vars.names, cap * sizeof(char *));
+        if (names) shell_vars.names = names;
+        double *values = realloc(shell_vars.values, cap * sizeof(double));
+        if (values) shell_vars.values = values;
+        if (!names || !values) return -1;
+        shell_vars.cap = cap;
+    }
+    if (!(shell_vars.names[shell_vars.n] = strndup(name, len))) return -1;
+    shell_vars.values[shell_vars.n] = 0;
+    return shell_vars.n++;
+}
+
+/* Text of $NAME: the shell variable, else the environment, else "" */
+static char *var_text(const char *name, arena *a) {
+    int i = var_find(name, strlen(name));
+    if (i < 0) {
+        const char *env = getenv(name);
+        return (char *)(env ? env : "");
+    }
+    char *s = arena_alloc(a, NUM_FORMAT_MAX);
+    if (s) num_format(shell_vars.values[i], s);
+    return s;
+}
+
+static char *subst_output(const char *cmd, arena *a);
+
+/* "$NAME" with a valid NAME */
+static int var_word(const char *w) {
+    if (w[0] != '$' || (!isalpha((unsigned char)w[1]) && w[1] != '_')) return 0;
+    for (int c = 2; w[c]; c++)
+        if (!isalnum((unsigned char)w[c]) && w[c] != '_') return 0;
+    return 1;
+}
+
+/* Output of the $(...) whose text runs from p to the next mark byte */
+static char *subst_text(const char *p, arena *a) {
+    size_t n = strchr(p, p[-1]) - p;
+    char *cmd = arena_alloc(a, n + 1);
+    if (!cmd) return NULL;
+    memcpy(cmd, p, n);
+    cmd[n] = '\0';
+    return subst_output(cmd, a);
+}
+
+/* A word as one string: a $NAME word becomes the variable's value and each
+ * $(...) in it the command's output without its trailing newlines */
+static char *expand_word(const char *w, int flags, arena *a) {
+    if ((flags & WORD_VAR) && var_word(w)) return var_text(w + 1, a);
+    if (!(flags & WORD_SUBST)) return (char *)w;
+    size_t len = 0, cap = strlen(w) + 64;
+    char *s = arena_alloc(a, cap);
+    while (s && *w) {
+        const char *piece = w;
+        size_t n;
+        if (*w == SUBST_BARE || *w == SUBST_QUOTED) {
+            if (!(piece = subst_text(w + 1, a))) return NULL;
+            for (n = strlen(piece); n > 0 && piece[n - 1] == '\n'; n--) ;
+            w = strchr(w + 1, *w) + 1;
+        } else {
+            n = strcspn(w, "\001\002");
+            w += n;
+        }
+        if (len + n + 1 > cap) {
+            size_t ncap = 2 * (len + n + 1);
+            if (!(s = arena_grow(a, s, cap, ncap))) return NULL;
+            cap = ncap;
+        }
+        memcpy(s + len, piece, n);
+        len += n;
+    }
+    if (s) s[len] = '\0';
+    return s;
+}
+
+static int push_arg(char ***args, size_t *n, size_t *cap, char *w, arena *a) {
+    if (*n + 1 >= *cap) {
+        char **grown = arena_grow(a, *args, *cap * sizeof(char *), 2 * *cap * sizeof(char *));
+        if (!grown) return 0;
+        *args = grown;
+        *cap *= 2;
+    }
+    (*args)[(*n)++] = w;
+    return 1;
+}
+
+/* Copy of p's stages with every $NAME word replaced by its value and every
+ * $(...) by its output, in a. A word that is nothing but an unquoted $(...)
+ * becomes one argument per blank-separated field of the output. */
+static stage_cmd *expand_stages(const pipeline *p, arena *a) {
+    stage_cmd *st = arena_alloc(a, p->num_commands * sizeof(stage_cmd));
+    if (!st) return NULL;
+    memcpy(st, p->stages, p->num_commands * sizeof(stage_cmd));
+    for (int i = 0; i < p->num_commands; i++) {
+        if (!st[i].vars) continue;
+        size_t n = 0, cap = 8;
+        char **args = arena_alloc(a, cap * sizeof(char *)), *save;
+        if (!args) return NULL;
+        for (int k = 0; st[i].args[k]; k++) {
+            const char *w = st[i].args[k];
+            size_t len = strlen(w);
+            char *v;
+            if (w[0] == SUBST_BARE && strchr(w + 1, SUBST_BARE) == w + len - 1) {
+                if (!(v = subst_text(w + 1, a))) return NULL;
+                for (char *f = strtok_r(v, " \t\n", &save); f; f = strtok_r(NULL, " \t\n", &save))
+                    if (!push_arg(&args, &n, &cap, f, a)) return NULL;
+                continue;
+            }
+            if (!(v = expand_word(w, st[i].vars[k], a)) || !push_arg(&args, &n, &cap, v, a)) return NULL;
+        }
+        if (n == 0) args[n++] = "";   /* $(...) with no output: nothing to run */
+        args[n] = NULL;
+        st[i].args = args;
+        if (st[i].bi && (st[i].bi->flags & BI_NOOPTS)) st[i].bi = stage_builtin(args);
+    }
+    return st;
+}
+
+/* A here-document or here-string as a readable fd: its text in a memfd,
+ * at offset 0. The caller closes it. */
+static int here_fd(const here_doc *h, arena *a) {
+    const char *text = h->text;
+    size_t len = h->len;
+    if (h->string && !(text = expand_word(h->text, h->flags, a))) return -1;
+    if (h->string) len = strlen(text);
+    int fd = memfd_create("oshell-here", MFD_CLOEXEC);
+    if (fd < 0) return -1;
+    if (write_all(fd, text, len) < 0 || (h->string && write_all(fd, "\n", 1) < 0) || lseek(fd, 0, SEEK_SET) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Runs a parsed pipeline; cmdline names the job */
+void exec_pipeline(pipeline *p, const char *cmdline) {
+    arena scratch = { NULL };    /* $NAME values of this run */
+    stage_cmd *stages = p->expand ? expand_stages(p, &scratch) : p->stages;
+    if (!stages) { perror("malloc"); arena_free(&scratch); exit_status = 1; return; }
+    int num_commands = p->num_commands, num_units = p->num_units, background = p->background;
+    int status = 1, last_tid = -1;     /* of the last unit, which is the pipeline's */
+    uint64_t t0 = trace_tick(), running = 0;
+    fflush(stdout);              /* buffered results go out before the stages write */
+
+    /* 6. Setup pipes between the units. O_CLOEXEC keeps every pipe end out
+     * of the exec'd children. */
+    int num_pipes = num_units - 1;
+    int *pipefds = p->pipefds;   /* each pipe has 2 file descriptors */
+    for(int i = 0; i < num_pipes; i++) {
+        if(pipe2(pipefds + i*2, O_CLOEXEC) < 0) {
+            perror("pipe");
+            exit(EXIT_FAILURE);
+        }
+        set_pipe_size(pipefds[i*2 + 1], p->pipe_size);
+    }
+    
+    /* 7. Command Execution and Process Management */
+    pid_t *pids = p->pids;
+    char **pid_names = p->pid_names;
+    pthread_t *tids = p->tids;
+    builtin_stage **threads = p->threads;
+    int num_pids = 0, num_tids = 0;
+    for(int cmd = 0, unit = 0; cmd < num_commands; cmd += stages[cmd].nfused, unit++) {
+        stage_cmd *st = &stages[cmd];
+        stage_cmd *last = &stages[cmd + st->nfused - 1];
+        char **args = st->args;
+        status = 1;
+        last_tid = -1;
+        
+        /* a. Pipe ends: read from the previous pipe, write to the next */
+        int in_fd = unit > 0 ? pipefds[(unit - 1)*2] : -1;
+        int out_fd = unit < num_units - 1 ? pipefds[unit*2 + 1] : -1;
+        int fd_in = -1, fd_out = -1, err_fd = -1;
+        
+        /* b. Input/Output Redirection, opened here so errors stay in the shell.
+         * 2>&1 sends stderr wherever stdout ends up, whatever the order. */
+        if(st->here != NULL) {
+            if((fd_in = here_fd(st->here, &scratch)) < 0) {
+                perror("here-document");
+                break;
+            }
+            in_fd = fd_in;
+        } else if(st->input_file != NULL) {
+            if((fd_in = open(st->input_file, O_RDONLY | O_CLOEXEC)) < 0) {
+                perror("open input file");
+                break;
+            }
+            in_fd = fd_in;
+        }
+        if(last->output_file != NULL) {
+            int mode = last->redir & REDIR_APPEND ? O_APPEND : O_TRUNC;
+            if((fd_out = open(last->output_file, O_WRONLY | O_CREAT | mode | O_CLOEXEC, 0644)) < 0) {
+                perror("open output file");
+                if(fd_in >= 0) close(fd_in);
+                break;
+            }
+            out_fd = fd_out;
+        }
+        if(st->error_file != NULL) {
+            int mode = st->redir & REDIR_ERR_APPEND ? O_APPEND : O_TRUNC;
+            if((err_fd = open(st->error_file, O_WRONLY | O_CREAT | mode | O_CLOEXEC, 0644)) < 0) {
+                perror("open error file");
+                if(fd_in >= 0) close(fd_in);
+                if(fd_out >= 0) close(fd_out);
+                break;
+            }
+        }
+        int stderr_fd = st->redir & REDIR_ERR_TO_OUT ? (out_fd >= 0 ? out_fd : 1) : err_fd;
+        
+        /* c. Execute the command: builtins first, so they never fork */
+        pid_t pid;
+        uint64_t s0 = trace_tick();
+        if(st->bi == NULL && args[0][0] == '\0') {
+            pid = 0;                 /* a $(...) command word with no output */
+            status = 0;
+        } else if(st->bi != NULL && !background && (num_units == 1 || stderr_fd < 0)) {
+            if(running == 0) {
+                running = s0;
+                trace_record(TRACE_EXEC, args[0], t0, s0, TRACE_NO_CPU);
+            }
+            if(num_units == 1) {
+                /* the only stage running: the shell's own stderr can move */
+                int saved_err = stderr_fd >= 0 ? fcntl(2, F_DUPFD_CLOEXEC, 3) : -1;
+                if(saved_err >= 0) dup2(stderr_fd, 2);
+                status = run_inproc(st, in_fd, out_fd);
+                if(saved_err >= 0) { dup2(saved_err, 2); close(saved_err); }
+            } else if((threads[num_tids] = start_builtin_thread(st, in_fd, out_fd, &tids[num_tids])) != NULL) {
+                last_tid = num_tids++;
+            } else {
+                perror("pthread_create");
+            }
+            pid = 0;
+        } else if(st->bi != NULL) {
+            pid = fork_builtin(st, in_fd, out_fd, stderr_fd, pipefds, 2 * num_pipes);
+        } else {
+            pid = spawn_resolved(args, in_fd, out_fd, stderr_fd);
+        }
+        if(pid == 0) {
+            /* ran in-process */
+        } else if(pid > 0) {
+            uint64_t s1 = trace_tick();
+            if(st->bi == NULL) trace_record(TRACE_SPAWN, args[0], s0, s1, TRACE_NO_CPU);
+            if(running == 0) {
+                running = s1;
+                trace_record(TRACE_EXEC, args[0], t0, s1, TRACE_NO_CPU);
+            }
+            pid_names[num_pids] = args[0];
+            p->started[num_pids] = s0;
+            pids[num_pids++] = pid;
+            status = -1;             /* known once the job is waited for */
+        } else if(errno == ENOENT && !strchr(args[0], '/')) {
+            fprintf(stderr, "%s: command not found\n", args[0]);
+            status = 127;
+        } else {
+            fprintf(stderr, "%s: %s: %s\n", spawn_names[spawn_engine], args[0], strerror(errno));
+            status = 126;
+        }
+        if(fd_in >= 0) close(fd_in);
+        if(fd_out >= 0) close(fd_out);
+        if(err_fd >= 0) close(err_fd);
+        /* Parent process continues to spawn remaining commands */
+    }  /* End of for each command */
+    
+    /* 8. Parent Process Cleanup: Close all pipe file descriptors */
+    for(int i = 0; i < 2 * num_pipes; i++) {
+        close(pipefds[i]);
+    }
+    
+    /* Process Management: the pipeline becomes a job; wait for its
+     * exact pids unless it is running in background */
+    job *j = num_pids > 0 ? job_add(cmdline, pids, pid_names, num_pids, background) : NULL;
+    for(int i = 0; j != NULL && i < num_pids; i++)
+        j->stages[i].started = p->started[i];
+    if(!background) {
+        uint64_t cpu_ns = TRACE_NO_CPU;
+        int stopped = 0;
+        if(j != NULL) {
+            int rc = wait_job(j);
+            stopped = rc < 0;
+            if(status < 0) status = stopped ? 128 + SIGTSTP : rc;
+            for(int i = 0; !stopped && i < last_fg->nstages; i++)   /* j is last_fg now */
+                cpu_ns = (i ? cpu_ns : 0) + rusage_ns(&last_fg->stages[i].ru);
+        } else {
+            int raw = 0;             /* ends as the last pid's */
+            for(int i = 0; i < num_pids; i++)
+                waitpid(pids[i], &raw, 0);
+            if(status < 0) status = WIFEXITED(raw) ? WEXITSTATUS(raw) : 128 + WTERMSIG(raw);
+        }
+        for(int i = 0; i < num_tids; i++) {
+            pthread_join(tids[i], NULL);
+            if(i == last_tid) status = threads[i]->status;
+            free(threads[i]);
+        }
+        if(running != 0 && !stopped) trace_record(TRACE_PIPELINE, stages[0].args[0], t0, trace_tick(), cpu_ns);
+        if(trace_enabled) trace_calibrate(0);   /* so SIGUSR1 finds the scale set */
+    } else {
+        if(j != NULL) printf("[%d] %d Process running in background.\n", j->id, (int)pids[num_pids - 1]);
+        status = 0;
+    }
+    exit_status = status;
+    arena_free(&scratch);
+}
+
+
+/* Statements: a block of text is split into statements at newlines and
+ * unquoted ';', then compiled once into a tree:
+ *   let NAME = EXPR
+ *   for NAME in EXPR..EXPR [;] do ... done      inclusive, step 1 or -1
+ *   if EXPR [CMP EXPR] [;] then ... [else ...] fi
+ *   EXPR                                        prints the value
+ *   command line                                pre-parsed pipeline
+ * CMP is one of < <= > >= == !=; a bare EXPR is true when non-zero. A loop
+ * whose body runs no commands (the pure-math case) executes straight from
+ * the compiled programs and writes its output through one out_buf. */
+enum { ST_EXPR, ST_LET, ST_CMD, ST_FOR, ST_IF };
+enum { CMP_NONE, CMP_LT, CMP_LE, CMP_GT, CMP_GE, CMP_EQ, CMP_NE };
+
+typedef struct stmt {
+    struct stmt *next;
+    int kind;
+    int slot;                     /* ST_LET, ST_FOR: variable */
+    int cmp;                      /* ST_IF */
+    int pure;                     /* ST_FOR: no commands anywhere in the body */
+    const char *text;             /* ST_EXPR: source for exact printing; ST_CMD: job name */
+    expr_prog a, b;               /* value, range bounds or the sides of a comparison */
+    pipeline pl;
+    struct stmt *body, *orelse;
+} stmt;
+
+typedef struct {
+    char **seg;                   /* statements, trimmed and NUL-terminated */
+    int nseg, pos;
+    arena *a;
+    int err;
+} block_parser;
+
+/* Length of keyword w if s starts with it as a whole word, else 0 */
+static size_t keyword(const char *s, const char *w) {
+    size_t n = strlen(w);
+    return strncmp(s, w, n) == 0 && (s[n] == '\0' || isspace((unsigned char)s[n])) ? n : 0;
+}
+
+/* Consumes keyword w at the start of the current statement; what follows
+ * it on the same statement becomes the current statement */
+static int take_keyword(block_parser *bp, const char *w) {
+    size_t n;
+    if (bp->pos >= bp->nseg || !(n = keyword(bp->seg[bp->pos], w))) return 0;
+    char *rest = bp->seg[bp->pos] + n;
+    while (isspace((unsigned char)*rest)) rest++;
+    if (*rest) bp->seg[bp->pos] = rest;
+    else bp->pos++;
+    return 1;
+}
+
+/* Cuts a header at keyword w ("for ... do BODY", "if ... then BODY").
+ * What follows w becomes the current statement. */
+static int split_keyword(block_parser *bp, char *s, const char *w) {
+    size_t k = strlen(w);
+    for (char *p = s + 1; (p = strstr(p, w)) != NULL; p += k) {
+        if (!isspace((unsigned char)p[-1]) || (p[k] && !isspace((unsigned char)p[k]))) continue;
+        p[-1] = '\0';
+        trim_whitespace(s);
+        for (p += k; isspace((unsigned char)*p); p++) ;
+        if (*p) bp->seg[--bp->pos] = p;    /* the header's own slot */
+        return 1;
+    }
+    return 0;
+}
+
+static int block_error(block_parser *bp, const char *msg, const char *near) {
+    if (near) fprintf(stderr, "Error: %s near '%s'\n", msg, near);
+    else fprintf(stderr, "Error: %s\n", msg);
+    bp->err = 1;
+    return 0;
+}
+
+static int compile_vars(const char *src, expr_prog *prog) {
+    return compile_expr_vars(src, prog, (const char *const *)shell_vars.names, shell_vars.n);
+}
+
+/* NAME at *s: its slot, with *s moved past it and any blanks */
+static int take_name(char **s) {
+    char *p = *s;
+    if (!isalpha((unsigned char)*p) && *p != '_') return -1;
+    while (isalnum((unsigned char)*p) || *p == '_') p++;
+    int slot = var_slot(*s, p - *s);
+    while (isspace((unsigned char)*p)) p++;
+    *s = p;
+    return slot;
+}
+
+/* Splits a condition at its comparison operator, outside parentheses */
+static int compile_cond(stmt *st, char *s) {
+    static const struct { const char *op; int cmp; } ops[] = {
+        { "<=", CMP_LE }, { ">=", CMP_GE }, { "==", CMP_EQ }, { "!=", CMP_NE },
+        { "<", CMP_LT }, { ">", CMP_GT },
+    };
+    int depth = 0;
+    for (char *p = s; *p; p++) {
+        if (*p == '(') depth++;
+        else if (*p == ')') depth--;
+        if (depth) continue;
+        for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+            size_t n = strlen(ops[i].op);
+            if (strncmp(p, ops[i].op, n) != 0) continue;
+            *p = '\0';
+            st->cmp = ops[i].cmp;
+            if (!compile_vars(s, &st->a)) return 0;
+            return compile_vars(p + n, &st->b);
+        }
+    }
+    st->cmp = CMP_NONE;
+    return compile_vars(s, &st->a);
+}
+
+static stmt *parse_stmts(block_parser *bp, const char *const *stops);
+
+static int body_pure(const stmt *b) {
+    for (; b; b = b->next)
+        if (b->kind == ST_CMD || ((b->kind == ST_FOR || b->kind == ST_IF) && !b->pure)) return 0;
+    return 1;
+}
+
+static stmt *parse_stmt(block_parser *bp, char *s) {
+    static const char *const for_end[] = { "done", NULL }, *const if_end[] = { "else", "fi", NULL },
+                             *const else_end[] = { "fi", NULL };
+    stmt *st = arena_alloc(bp->a, sizeof(stmt));
+    size_t n;
+    if (!st) { block_error(bp, "out of memory", NULL); return NULL; }
+    memset(st, 0, sizeof(*st));
+
+    if ((n = keyword(s, "let"))) {
+        s += n;
+        while (isspace((unsigned char)*s)) s++;
+        st->kind = ST_LET;
+        if ((st->slot = take_name(&s)) < 0 || *s != '=') { block_error(bp, "usage: let NAME = EXPR", NULL); return NULL; }
+        if (!compile_vars(s + 1, &st->a)) { block_error(bp, "let: invalid expression", s + 1); return NULL; }
+    } else if ((n = keyword(s, "for"))) {
+        s += n;
+        while (isspace((unsigned char)*s)) s++;
+        st->kind = ST_FOR;
+        int has_do = split_keyword(bp, s, "do");
+        char *dots;
+        if ((st->slot = take_name(&s)) < 0 || !(n = keyword(s, "in")) || !(dots = strstr(s + n, ".."))) {
+            block_error(bp, "usage: for NAME in FROM..TO; do ...; done", NULL);
+            return NULL;
+        }
+        *dots = '\0';
+        if (!compile_vars(s + n, &st->a) || !compile_vars(dots + 2, &st->b)) {
+            block_error(bp, "for: invalid range", dots + 2);
+            return NULL;
+        }
+        if (!has_do && !take_keyword(bp, "do")) { block_error(bp, "for: expected 'do'", NULL); return NULL; }
+        st->body = parse_stmts(bp, for_end);
+        if (bp->err) return NULL;
+        if (!take_keyword(bp, "done")) { block_error(bp, "for: expected 'done'", NULL); return NULL; }
+        st->pure = body_pure(st->body);
+    } else if ((n = keyword(s, "if"))) {
+        s += n;
+        st->kind = ST_IF;
+        int has_then = split_keyword(bp, s, "then");
+        if (!compile_cond(st, s)) { block_error(bp, "if: invalid condition", s); return NULL; }
+        if (!has_then && !take_keyword(bp, "then")) { block_error(bp, "if: expected 'then'", NULL); return NULL; }
+        st->body = parse_stmts(bp, if_end);
+        if (!bp->err && take_keyword(bp, "else")) st->orelse = parse_stmts(bp, else_end);
+        if (bp->err) return NULL;
+        if (!take_keyword(bp, "fi")) { block_error(bp, "if: expected 'fi'", NULL); return NULL; }
+        st->pure = body_pure(st->body) && body_pure(st->orelse);
+    } else if (keyword(s, "do") || keyword(s, "done") || keyword(s, "then") || keyword(s, "else") || keyword(s, "fi")) {
+        block_error(bp, "syntax error", s);
+        return NULL;
+    } else if (compile_vars(s, &st->a)) {
+        st->kind = ST_EXPR;
+        st->text = s;
+    } else {
+        size_t len = strlen(s) + 1;
+        char *name = arena_alloc(bp->a, len);
+        st->kind = ST_CMD;
+        st->text = name ? memcpy(name, s, len) : NULL;
+        if (!name || !parse_pipeline(s, &st->pl, bp->a)) { bp->err = 1; return NULL; }
+    }
+    return st;
+}
+
+/* Statements up to (not including) one that starts with a word of stops */
+static stmt *parse_stmts(block_parser *bp, const char *const *stops) {
+    stmt *head = NULL, **tail = &head;
+    while (bp->pos < bp->nseg && !bp->err) {
+        char *s = bp->seg[bp->pos];
+        for (int i = 0; stops && stops[i]; i++)
+            if (keyword(s, stops[i])) return head;
+        bp->pos++;
+        stmt *st = parse_stmt(bp, s);
+        if (!st) return NULL;
+        *tail = st;
+        tail = &st->next;
+    }
+    if (stops && !bp->err) block_error(bp, "unexpected end of block, expected", stops[0]);
+    return head;
+}
+
+/* Whether line[0..n) is the delimiter of the here-document operator "<<"
+ * at op, compared in place with its quotes dropped; *end is set to the
+ * byte after the delimiter */
+static int here_delim(const char *op, const char *line, size_t n, const char **end) {
+    const char *p = op + 2;
+    size_t i = 0;
+    int match = 1;
+    for (; *p == ' ' || *p == '\t'; p++) ;
+    for (char q = 0; *p && (q || !strchr(" \t\n;|&<>", *p)); p++) {
+        if (q ? *p == q : (*p == '\'' || *p == '"')) q = q ? 0 : *p;
+        else if (match) match = i < n && line[i++] == *p;
+    }
+    *end = p;
+    return match && i == n;
+}
+
+/* Calls fn on every statement of text, split at newlines and unquoted ';'.
+ * Statements are trimmed and NUL-terminated in place; empty ones and
+ * '#' comments are skipped. A statement with here-documents takes their
+ * bodies with it, through the last delimiter line. Returns 0 if fn
+ * failed, 2 if a here-document is still open at the end of text, else 1. */
+static int split_stmts(char *text, int (*fn)(char *s, void *ctx), void *ctx) {
+    char *start = text, *p = text, **ops = NULL;    /* the "<<" of the statement */
+    const char *end;
+    int nhere = 0, cap = 0, open = 0, rc = 1;
+    for (;; p++) {
+        if (*p == '\'' && strchr(p + 1, '\'')) p = strchr(p + 1, '\'');
+        else if (*p == '"') { while (p[1] && p[1] != '"') p += p[1] == '\\' && p[2] ? 2 : 1; if (p[1]) p++; }
+        else if (*p == '\\' && p[1]) p++;
+        else if (*p == '$' && p[1] == '(' && subst_end(p + 1)) p = subst_end(p + 1);
+        else if (*p == '<' && p[1] == '<' && p[2] != '<' && (p == text || p[-1] != '<')) {
+            if (nhere == cap) {
+                char **grown = realloc(ops, (cap = cap ? 2 * cap : 8) * sizeof(char *));
+                if (!grown) { rc = 0; break; }
+                ops = grown;
+            }
+            ops[nhere++] = p;
+            here_delim(p, "", 0, &end);
+            p = (char *)end - 1;
+        } else if (*p == ';' || *p == '\n' || *p == '\0') {
+            /* the bodies follow the line: the statement ends after them */
+            int i = 0;
+            for (; i < nhere && *p == '\n'; i++) {
+                char *line = p + 1, *nl;
+                for (;; line = nl + 1) {
+                    nl = strchr(line, '\n');
+                    size_t n = nl ? (size_t)(nl - line) : strlen(line);
+                    if (here_delim(ops[i], line, n, &end)) { p = nl ? nl : line + n; break; }
+                    if (!nl) { p = line + n; open = 1; break; }
+                }
+            }
+            if (i < nhere && *p == '\0') open = 1;     /* bodies still to come */
+            nhere = 0;
+            int last = *p == '\0';
+            *p = '\0';
+            char *s = trim_whitespace(start);
+            if (*s && *s != '#' && !fn(s, ctx)) { rc = 0; break; }
+            if (last) { rc = open ? 2 : 1; break; }
+            start = p + 1;
+        }
+    }
+    free(ops);
+    return rc;
+}
+
+static int add_segment(char *s, void *ctx) {
+    block_parser *bp = ctx;
+    if (bp->nseg % 16 == 0) {
+        char **seg = arena_grow(bp->a, bp->seg, bp->nseg * sizeof(char *), (bp->nseg + 16) * sizeof(char *));
+        if (!seg) return 0;
+        bp->seg = seg;
+    }
+    bp->seg[bp->nseg++] = s;
+    return 1;
+}
+
+/* Compiles text (copied into a first) into a statement list. NULL with
+ * nothing printed for an empty block, NULL after an error message when
+ * it does not compile. */
+stmt *compile_block(const char *text, arena *a) {
+    size_t n = strlen(text) + 1;
+    char *copy = arena_alloc(a, n);
+    block_parser bp = { NULL, 0, 0, a, 0 };
+    if (!copy) return NULL;
+    if (!split_stmts(memcpy(copy, text, n), add_segment, &bp)) { perror("malloc"); return NULL; }
+    stmt *head = parse_stmts(&bp, NULL);
+    return bp.err ? NULL : head;
+}
+
+void free_block(stmt *st) {
+    for (; st; st = st->next) {
+        free_expr(&st->a);
+        free_expr(&st->b);
+        free_block(st->body);
+        free_block(st->orelse);
+    }
+}
+
+static int stmt_depth(char *s, void *ctx) {
+    int *depth = ctx;
+    size_t n;
+    for (;;) {
+        if ((n = keyword(s, "done")) || (n = keyword(s, "fi"))) (*depth)--;
+        else if (!(n = keyword(s, "do")) && !(n = keyword(s, "then")) && !(n = keyword(s, "else"))) break;
+        for (s += n; isspace((unsigned char)*s); s++) ;
+    }
+    if (keyword(s, "for") || keyword(s, "if")) (*depth)++;
+    return 1;
+}
+
+/* for/if blocks text opens and does not close, plus one for a
+ * here-document without its delimiter line; > 0 means more lines are
+ * needed before it can be compiled */
+int block_depth(const char *text) {
+    int depth = 0;
+    char *copy = strdup(text);
+    if (copy && split_stmts(copy, stmt_depth, &depth) == 2) depth++;   /* an open here-document */
+    free(copy);
+    return depth;
+}
+
+static int run_bound(expr_prog *p, double *r) {
+    p->vars = shell_vars.values;
+    return run_expr(p, r);
+}
+
+static void stmt_print(const char *prefix, const stmt *st, double r, out_buf *out) {
+    if (!out) { print_value(prefix, st->text, r, st->a.wide); return; }
+    out_write(out, prefix, strlen(prefix));
+    out_value(out, st->text, r, st->a.wide);
+}
+
+/* Runs a statement list. Output of expressions goes through out when it
+ * is set, through stdio otherwise. */
+void exec_stmts(stmt *st, const char *prefix, out_buf *out) {
+    double x, y;
+    for (; st && !exit_requested; st = st->next) {
+        switch (st->kind) {
+        case ST_EXPR:
+            exit_status = run_bound(&st->a, &x) != 1;
+            if (!exit_status) stmt_print(prefix, st, x, out);
+            break;
+        case ST_LET:
+            exit_status = run_bound(&st->a, &x) != 1;
+            if (!exit_status) shell_vars.values[st->slot] = x;
+            break;
+        case ST_CMD:
+            exec_pipeline(&st->pl, st->text);
+            break;
+        case ST_IF: {
+            int ok = run_bound(&st->a, &x) == 1 && (st->cmp == CMP_NONE || run_bound(&st->b, &y) == 1);
+            if (!ok) break;
+            int yes = st->cmp == CMP_NONE ? x != 0 : st->cmp == CMP_LT ? x < y : st->cmp == CMP_LE ? x <= y :
+                      st->cmp == CMP_GT ? x > y : st->cmp == CMP_GE ? x >= y : st->cmp == CMP_EQ ? x == y : x != y;
+            exec_stmts(yes ? st->body : st->orelse, prefix, out);
+            break;
+        }
+        case ST_FOR: {
+            if (run_bound(&st->a, &x) != 1 || run_bound(&st->b, &y) != 1) break;
+            if (!integral_exp(x) || !integral_exp(y)) {
+                fprintf(stderr, "Error: for: range bounds must be integers\n");
+                break;
+            }
+            long long i = (long long)x, to = (long long)y, step = i <= to ? 1 : -1;
+            out_buf buf, *o = out;
+            if (st->pure && !out) {
+                fflush(stdout);
+                if (out_init(&buf, 1, OUT_BUF_SIZE)) o = &buf;
+            }
+            for (;; i += step) {
+                shell_vars.values[st->slot] = (double)i;
+                exec_stmts(st->body, prefix, o);
+                if (i == to || exit_requested) break;
+            }
+            if (o == &buf) out_close(&buf);
+            break;
+        }
+        }
+    }
+}
+
+/* Command substitution: $(CMD) becomes what CMD writes to stdout. An
+ * expression is evaluated, and a lone builtin that leaves the shell as it
+ * was (BI_NOSTATE) writes into a capture buffer, so neither needs a process
+ * or an fd. Lines made of such builtins, expressions and external commands
+ * run in the shell with stdout moved to a memfd; only the external commands
+ * are spawned. Anything that could change the shell (cd, exit, let, for,
+ * if, other builtins, &) runs in a child oshell, the subshell bash would
+ * use for every $(...). */
+static int subst_inproc(const stmt *st) {
+    for (; st; st = st->next) {
+        if (st->kind == ST_EXPR) continue;
+        if (st->kind != ST_CMD || st->pl.background) return 0;
+        for (int i = 0; i < st->pl.num_commands; i++) {
+            const builtin *bi = st->pl.stages[i].bi;
+            if (bi && !(bi->flags & BI_NOSTATE)) return 0;
+        }
     }
     return 1;
 }
 
+/* Everything written to fd, NUL-terminated, in a */
+static char *read_back(int fd, arena *a) {
+    off_t size = lseek(fd, 0, SEEK_END);
+    char *s = size >= 0 ? arena_alloc(a, size + 1) : NULL;
+    size_t len = 0;
+    while (s && len < (size_t)size) {
+        ssize_t n = pread(fd, s + len, size - len, len);
+        if (n <= 0) break;
+        len += n;
+    }
+    if (s) s[len] = '\0';
+    return s;
+}
+
+static char *subst_output(const char *cmd, arena *a) {
+    expr_prog prog;
+    double v;
+    if (compile_vars(cmd, &prog)) {
+        char *s = arena_alloc(a, NUM_FORMAT_MAX);
+        int rc = run_bound(&prog, &v);
+        free_expr(&prog);
+        if (s && rc == 1) num_format(v, s);
+        else if (s) *s = '\0';
+        return s;
+    }
+    arena tmp = { NULL };
+    stmt *block = compile_block(cmd, &tmp);
+    const stage_cmd *first = block && block->kind == ST_CMD ? block->pl.stages : NULL;
+    char *out = NULL;
+    if (!block) {
+        if ((out = arena_alloc(a, 1))) *out = '\0';
+    } else if (!block->next && first && block->pl.num_commands == 1 && first->bi && subst_inproc(block) &&
+               !first->input_file && !first->output_file && !first->error_file && !first->here && !first->redir) {
+        stage_cmd *st = block->pl.expand ? expand_stages(&block->pl, &tmp) : block->pl.stages;
+        out_buf cap;
+        if (st && out_init(&cap, -1, 256)) {
+            st->bi->fn(st->args, 0, &cap);
+            if ((out = arena_alloc(a, cap.len + 1))) {
+                memcpy(out, cap.buf, cap.len);
+                out[cap.len] = '\0';
+            }
+            out_close(&cap);
+        }
+    } else {
+        int fd = memfd_create("oshell-subst", MFD_CLOEXEC);
+        if (fd >= 0 && subst_inproc(block)) {
+            int saved = (fflush(stdout), fcntl(1, F_DUPFD_CLOEXEC, 3));
+            if (saved >= 0 && dup2(fd, 1) >= 0) {
+                exec_stmts(block, "", NULL);
+                fflush(stdout);
+                dup2(saved, 1);
+            }
+            if (saved >= 0) close(saved);
+        } else if (fd >= 0) {
+            char *argv[] = { "oshell", "-c", (char *)cmd, NULL };
+            pid_t pid = spawn_command("/proc/self/exe", argv, -1, fd, -1);
+            while (pid > 0 && waitpid(pid, NULL, 0) < 0 && errno == EINTR) { }
+        }
+        if (fd >= 0) {
+            out = read_back(fd, a);
+            close(fd);
+        } else {
+            perror("memfd_create");
+        }
+    }
+    free_block(block);
+    arena_free(&tmp);
+    return out;
+}
+
+/* Runs one command line: a math expression, statements or a pipeline */
+void run_line(char *line) {
+    static arena line_arena;    /* reset after every line */
+
+    /* "perf PIPELINE" runs the rest of the line under counters */
+    if (strncmp(line, "perf", 4) == 0 && isspace((unsigned char)line[4])) {
+        perf_counters pc;
+        perf_open(&pc);
+        perf_start(&pc);
+        run_line(trim_whitespace(line + 4));
+        perf_stop(&pc);
+        fflush(stdout);
+        perf_report(&pc, stderr);
+        perf_close(&pc);
+        return;
+    }
+    double r;
+    int wide = 0, rc = eval_cached(line, &r, &wide);
+    if (rc == 1) print_value("Result: ", line, r, wide);
+    if (rc != 0) { exit_status = rc != 1; return; }   /* evaluation errors are already reported */
+    stmt *block = compile_block(line, &line_arena);
+    exec_stmts(block, "Result: ", NULL);
+    free_block(block);
+    arena_reset(&line_arena);
+}
+
+/* Script mode: oshell FILE. The file is mapped and cut into lines in one
+ * pass; nothing is prompted and results are printed like -e, without a
+ * fflush per line. A line that opens a for or if block takes the lines up
+ * to its end with it. Every distinct line or block is compiled once into
+ * a script_cmd, kept in a hash table keyed by its text, so one that comes
+ * back runs its compiled statements directly. */
+#define SCRIPT_HASH_BUCKETS 1024
+
+typedef struct script_cmd {
+    struct script_cmd *next;       /* hash chain */
+    unsigned hash;
+    size_t len;
+    char *src;                     /* the text as written: the key */
+    int perf;                      /* "perf" prefix */
+    stmt *block;                   /* NULL if it did not compile */
+    arena mem;                     /* holds src and block */
+} script_cmd;
+
+typedef struct {
+    script_cmd *buckets[SCRIPT_HASH_BUCKETS];
+    long parsed, reused;
+} script_cache;
+
+static unsigned line_hash(const char *s, size_t n) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+/* The cached compile of text[0..n), compiling it on first sight */
+script_cmd *script_lookup(script_cache *c, const char *text, size_t n) {
+    unsigned h = line_hash(text, n);
+    script_cmd **head = &c->buckets[h % SCRIPT_HASH_BUCKETS];
+    for (script_cmd *sc = *head; sc; sc = sc->next) {
+        if (sc->hash == h && sc->len == n && memcmp(sc->src, text, n) == 0) {
+            c->reused++;
+            return sc;
+        }
+    }
+    script_cmd *sc = calloc(1, sizeof(*sc));
+    if (!sc || !(sc->src = arena_alloc(&sc->mem, n + 1))) { free(sc); return NULL; }
+    sc->hash = h;
+    sc->len = n;
+    memcpy(sc->src, text, n);
+    sc->src[n] = '\0';
+    const char *body = sc->src;
+    while (strncmp(body, "perf", 4) == 0 && isspace((unsigned char)body[4])) {
+        sc->perf = 1;
+        for (body += 4; isspace((unsigned char)*body); body++) ;
+    }
+    sc->block = compile_block(body, &sc->mem);
+    sc->next = *head;
+    *head = sc;
+    c->parsed++;
+    return sc;
+}
+
+void script_free(script_cache *c) {
+    for (int i = 0; i < SCRIPT_HASH_BUCKETS; i++) {
+        for (script_cmd *sc = c->buckets[i], *next; sc; sc = next) {
+            next = sc->next;
+            free_block(sc->block);
+            arena_free(&sc->mem);
+            free(sc);
+        }
+        c->buckets[i] = NULL;
+    }
+}
+
+void script_exec(script_cmd *sc) {
+    perf_counters pc;
+    if (sc->perf) {
+        perf_open(&pc);
+        perf_start(&pc);
+    }
+    exec_stmts(sc->block, "", NULL);
+    if (sc->perf) {
+        perf_stop(&pc);
+        fflush(stdout);
+        perf_report(&pc, stderr);
+        perf_close(&pc);
+    }
+}
+
+/* Depth of the for/if blocks text[0..n) leaves open; cheap for the
+ * lines that cannot open one */
+static int span_depth(const char *text, size_t n) {
+    if (!memmem(text, n, "for", 3) && !memmem(text, n, "if", 2) && !memmem(text, n, "<<", 2)) return 0;
+    char *copy = strndup(text, n);
+    int depth = copy ? block_depth(copy) : 0;
+    free(copy);
+    return depth;
+}
+
+/* Runs every line of path; blank lines and lines starting with '#' are
+ * skipped. Returns -1 if the file could not be read. */
+int run_script(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    const char *map = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : "";
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    script_cache *cache = calloc(1, sizeof(*cache));
+    if (!cache) { perror("malloc"); return -1; }
+    const char *p = map, *end = map + size;
+    while (p < end && !exit_requested) {
+        const char *nl = memchr(p, '\n', end - p), *e = nl ? nl : end;
+        const char *s = p;
+        p = nl ? nl + 1 : end;
+        while (s < e && isspace((unsigned char)*s)) s++;
+        if (s == e || *s == '#') continue;
+        /* a block runs to the line that closes it */
+        while (p < end && span_depth(s, e - s) > 0) {
+            nl = memchr(p, '\n', end - p);
+            e = nl ? nl : end;
+            p = nl ? nl + 1 : end;
+        }
+        while (e > s && isspace((unsigned char)e[-1])) e--;
+        reap_jobs();
+        script_cmd *sc = script_lookup(cache, s, e - s);
+        if (sc) script_exec(sc);
+        else perror("malloc");
+    }
+    fflush(stdout);
+    script_free(cache);
+    free(cache);
+    if (size) munmap((void *)map, size);
+    return 0;
+}
+
+#ifndef OSHELL_NO_MAIN
 int main(int argc, char **argv) {
-    /* Batch mode: evaluate expr N times in one process */
+    /* The one-shot modes come first and set up none of the shell (signals,
+     * spawn engine, trace ring); Codes/startup_benchmark.c tracks their
+     * exec-to-exit cost */
+
+    /* Batch mode: compile expr once, evaluate it N times in one process */
     if (argc == 4 && strcmp(argv[1], "-b") == 0) {
         int reps = atoi(argv[2]); double val;
+        expr_prog prog;
+        if (!compile_expr(argv[3], &prog)) {
+            expr_error(argv[3]);
+            return EXIT_FAILURE;
+        }
         for (int i = 0; i < reps; i++) {
-            if (eval_expr(argv[3], &val) <= 0) return EXIT_FAILURE;
+            if (run_expr(&prog, &val) <= 0) { free_expr(&prog); return EXIT_FAILURE; }
         }
+        free_expr(&prog);
         return EXIT_SUCCESS;
     }
+    /* Daemon mode: oshell --serve SOCK [-j threads] */
+    if ((argc == 3 || argc == 5) && strcmp(argv[1], "--serve") == 0) {
+        int nthreads = argc == 5 && strcmp(argv[3], "-j") == 0 ? atoi(argv[4]) : default_threads();
+        return serve(argv[2], nthreads > 0 ? nthreads : 1) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    /* Client of a daemon: same output as -e, without starting an evaluator */
+    if (argc == 5 && ((strcmp(argv[1], "-e") == 0 && strcmp(argv[3], "--connect") == 0) ||
+                      (strcmp(argv[1], "--connect") == 0 && strcmp(argv[3], "-e") == 0))) {
+        const char *expr = argv[1][1] == 'e' ? argv[2] : argv[4];
+        const char *sock = argv[1][1] == 'e' ? argv[4] : argv[2];
+        char *reply = NULL;
+        int fd = serve_connect(sock);
+        if (fd < 0) { fprintf(stderr, "connect: %s: %s\n", sock, strerror(errno)); return EXIT_FAILURE; }
+        if (!serve_send(fd, expr) || !(reply = serve_recv_text(fd))) {
+            fprintf(stderr, "connect: %s: connection failed\n", sock);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        close(fd);
+        int failed = strncmp(reply, "error: ", 7) == 0;
+        fprintf(failed ? stderr : stdout, "%s\n", reply + (failed ? 7 : 0));   /* as -e prints it */
+        free(reply);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
     /* Single-eval mode */
     if (argc == 3 && strcmp(argv[1], "-e") == 0) {
         double val;
-        if (eval_expr(argv[2], &val) == 1) {
-            printf("%lf\n", val);
+        int wide = 0, rc = eval_expr_wide(argv[2], &val, &wide);
+        if (rc == 1) {
+            print_value("", argv[2], val, wide);
             return EXIT_SUCCESS;
         }
+        if (rc == 0) expr_error(argv[2]);   /* runtime errors are already reported */
         return EXIT_FAILURE;
     }
 
+    /* Column mode: evaluate expr of x over every value of a file */
+    if ((argc == 4 || argc == 5) && strcmp(argv[1], "-v") == 0) {
+        return eval_column(argv[2], argv[3], argc == 5 ? argv[4] : NULL) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /* Streaming mode: oshell -s [-j threads] [file], one expression per line */
+    if (argc >= 2 && strcmp(argv[1], "-s") == 0) {
+        int nthreads = default_threads(), argi = 2, fd = 0;
+        if (argi + 1 < argc && strcmp(argv[argi], "-j") == 0) {
+            nthreads = atoi(argv[argi + 1]) > 0 ? atoi(argv[argi + 1]) : 1;
+            argi += 2;
+        }
+        if (argi < argc && strcmp(argv[argi], "-") != 0 && (fd = open(argv[argi], O_RDONLY)) < 0) {
+            perror("open input file");
+            return EXIT_FAILURE;
+        }
+        long errors = eval_stream(fd, 1, nthreads);
+        if (errors < 0) fprintf(stderr, "Error: streaming evaluation failed\n");
+        else if (errors > 0) fprintf(stderr, "%ld line(s) failed to evaluate\n", errors);
+        return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    select_spawn_engine(getenv("OSHELL_SPAWN"));
+    if (getenv("OSHELL_PIPE_SIZE")) pipe_size = atoi(getenv("OSHELL_PIPE_SIZE"));
+    if (getenv("OSHELL_FUSE")) fuse_stages = atoi(getenv("OSHELL_FUSE")) != 0;
+    signal(SIGPIPE, SIG_IGN);    /* builtin stages get EPIPE instead of killing the shell */
+    install_sigchld_handler();
+    trace_init();
+    install_trace_handlers();
+
+    /* Script mode: oshell FILE, no prompts; ^C and ^Z act on the script */
+    if (argc == 2 && argv[1][0] != '-') {
+        if (run_script(argv[1]) < 0) return 127;
+        return exit_status;
+    }
+    /* Command string: oshell -c TEXT, run the way a script is */
+    if (argc == 3 && strcmp(argv[1], "-c") == 0) {
+        arena a = { NULL };
+        stmt *block = compile_block(argv[2], &a);
+        exec_stmts(block, "", NULL);
+        fflush(stdout);
+        free_block(block);
+        arena_free(&a);
+        return exit_status;
+    }
+
     /* Interactive shell */
     signal(SIGINT, sigint_handler);
-    char line[MAX_LINE_LENGTH];
+    signal(SIGTSTP, SIG_IGN);    /* ^Z stops the foreground job, not the shell */
+    char *line = NULL, *more = NULL;   /* grown by getline, reused for every line */
+    size_t line_cap = 0, more_cap = 0;
     while (1) {
+        reap_jobs();
         printf("OShell> "); fflush(stdout);
-        if (!fgets(line, sizeof(line), stdin)) { printf("\n"); break; }
+        if (getline(&line, &line_cap, stdin) < 0) { printf("\n"); break; }
         line[strcspn(line, "\n")] = '\0';
-        if (strcmp(line, "exit") == 0) { printf("Exiting shell...\n"); break; }
-        double r;
-        if (eval_expr(line, &r) == 1) {
-            printf("Result: %lf\n", r);
-            continue;
-        }
-        /* 2. Command Parsing: Split the input line into command segments by '|' */
-        char *commands[MAX_COMMANDS];
-        int num_commands = 0;
-        char *command_token = strtok(line, "|");
-        while(command_token != NULL && num_commands < MAX_COMMANDS) {
-            commands[num_commands++] = trim_whitespace(command_token);
-            command_token = strtok(NULL, "|");
-        }
-        
-        /* 3. Handling Background Processes:
-         * Check if the last command ends with '&' and remove it.
-         */
-        int background = 0;
-        char *last_cmd = commands[num_commands - 1];
-        char temp_cmd[MAX_LINE_LENGTH];
-        strncpy(temp_cmd, last_cmd, MAX_LINE_LENGTH);
-        temp_cmd[MAX_LINE_LENGTH - 1] = '\0';
-        char *args_temp[MAX_ARGS];
-        tokenize_command(temp_cmd, args_temp);
-        int args_count = 0;
-        while(args_temp[args_count] != NULL)
-            args_count++;
-        if(args_count > 0 && strcmp(args_temp[args_count - 1], "&") == 0) {
-            background = 1;
-            /* Remove '&' from the last command string */
-            char *ampersand = strstr(last_cmd, "&");
-            if(ampersand != NULL) {
-                *ampersand = '\0';
-                last_cmd = trim_whitespace(last_cmd);
-                commands[num_commands - 1] = last_cmd;
-            }
-        }
-        
-        /* 4. Setup pipes if more than one command is present */
-        int num_pipes = num_commands - 1;
-        int pipefds[2 * num_pipes];  /* each pipe has 2 file descriptors */
-        for(int i = 0; i < num_pipes; i++) {
-            if(pipe(pipefds + i*2) < 0) {
-                perror("pipe");
-                exit(EXIT_FAILURE);
-            }
-        }
-        
-        /* 5. Command Execution and Process Management */
-        pid_t pid;
-        int cmd;
-        for(cmd = 0; cmd < num_commands; cmd++) {
-            /* Tokenize the current command into arguments */
-            char *args[MAX_ARGS];
-            tokenize_command(commands[cmd], args);
-            
-            /* Handle Input/Output Redirection:
-             * Scan tokens for '<' or '>' and record the file names.
-             */
-            int in_redirect = -1, out_redirect = -1;
-            char *input_file = NULL;
-            char *output_file = NULL;
-            for(int j = 0; args[j] != NULL; j++) {
-                if(strcmp(args[j], "<") == 0) {
-                    in_redirect = j;
-                    if(args[j+1] != NULL) {
-                        input_file = args[j+1];
-                    } else {
-                        fprintf(stderr, "Error: no input file specified\n");
-                    }
-                }
-                if(strcmp(args[j], ">") == 0) {
-                    out_redirect = j;
-                    if(args[j+1] != NULL) {
-                        output_file = args[j+1];
-                    } else {
-                        fprintf(stderr, "Error: no output file specified\n");
-                    }
-                }
-            }
-            /* Remove redirection tokens from the argument list */
-            if(in_redirect != -1)
-                args[in_redirect] = NULL;
-            if(out_redirect != -1)
-                args[out_redirect] = NULL;
-            
-            pid = fork();
-            if(pid == 0) {
-                /* CHILD PROCESS */
-                
-                /* a. Setup Pipe Redirection if necessary */
-                /* If not the first command, redirect standard input from the previous pipe */
-                if(cmd > 0) {
-                    if(dup2(pipefds[(cmd - 1)*2], 0) < 0) {
-                        perror("dup2");
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                /* If not the last command, redirect standard output to the next pipe */
-                if(cmd < num_commands - 1) {
-                    if(dup2(pipefds[cmd*2 + 1], 1) < 0) {
-                        perror("dup2");
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                /* Close all pipe file descriptors in the child */
-                for(int i = 0; i < 2 * num_pipes; i++) {
-                    close(pipefds[i]);
-                }
-                
-                /* b. Input Redirection */
-                if(input_file != NULL && in_redirect != -1) {
-                    int fd_in = open(input_file, O_RDONLY);
-                    if(fd_in < 0) {
-                        perror("open input file");
-                        exit(EXIT_FAILURE);
-                    }
-                    if(dup2(fd_in, 0) < 0) {
-                        perror("dup2 input");
-                        exit(EXIT_FAILURE);
-                    }
-                    close(fd_in);
-                }
-                /* c. Output Redirection */
-                if(output_file != NULL && out_redirect != -1) {
-                    int fd_out = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-                    if(fd_out < 0) {
-                        perror("open output file");
-                        exit(EXIT_FAILURE);
-                    }
-                    if(dup2(fd_out, 1) < 0) {
-                        perror("dup2 output");
-                        exit(EXIT_FAILURE);
-                    }
-                    close(fd_out);
-                }
-                
-                /* d. Execute the command */
-                if(execvp(args[0], args) < 0) {
-                    perror("execvp");
-                    exit(EXIT_FAILURE);
-                }
-            } else if(pid < 0) {
-                perror("fork");
+        /* An open for/if block continues on the following lines */
+        while (block_depth(line) > 0) {
+            printf("> "); fflush(stdout);
+            if (getline(&more, &more_cap, stdin) < 0) break;
+            size_t n = strlen(line), m = strcspn(more, "\n");
+            if (n + m + 2 > line_cap) {
+                char *grown = realloc(line, n + m + 2);
+                if (!grown) break;
+                line = grown;
+                line_cap = n + m + 2;
             }
-            /* Parent process continues to fork remaining commands */
-        }  /* End of for each command */
-        
-        /* 6. Parent Process Cleanup: Close all pipe file descriptors */
-        for(int i = 0; i < 2 * num_pipes; i++) {
-            close(pipefds[i]);
+            line[n] = '\n';
+            memcpy(line + n + 1, more, m);
+            line[n + m + 1] = '\0';
         }
-        
-        /* Process Management: Wait for all child processes unless running in background */
-        if(!background) {
-            for(int i = 0; i < num_commands; i++) {
-                wait(NULL);
-            }
-        } else {
-            printf("Process running in background.\n");
+        run_line(line);
+        if(exit_requested) {
+            printf("Exiting shell...\n");
+            break;
         }
     }  /* End of while loop */
     
-    return 0;
-}
\ No newline at end of file
+    free(line);
+    free(more);
+    return exit_status;
+}
+#endif /* OSHELL_NO_MAIN */
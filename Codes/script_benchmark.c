@@ -0,0 +1,121 @@
+/* Script execution: the same generated script run as `oshell FILE`, piped
+ * to interactive oshell on stdin (prompt and fflush per line, no parse
+ * cache), and as a bash script. The script repeats a block of math,
+ * builtins and a builtin pipeline, so every line after the first block
+ * comes out of the parse cache; -x adds a line that spawns /bin/true.
+ * Build: gcc -O2 script_benchmark.c -o script_benchmark
+ * Usage: script_benchmark [-n SAMPLES] [-r REPEATS] [-x] <oshell>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+/* oshell line, bash line */
+static const char *const block[][2] = {
+    { "2^20", "echo $((2**20))" },
+    { "(3+4)*5-6/2", "echo $(((3+4)*5-6/2))" },
+    { "echo hello world", "echo hello world" },
+    { "true", "true" },
+    { "pwd", "pwd" },
+    { "echo a b c | cat | cat", "echo a b c | cat | cat" },
+};
+#define BLOCK_LINES (int)(sizeof(block) / sizeof(block[0]))
+
+static long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Writes the block `repeats` times; column 0 for oshell, 1 for bash */
+int write_script(char *path, int column, int repeats, int external) {
+    int fd = mkstemp(path);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, "w");
+    if (!fp) return 0;
+    for (int r = 0; r < repeats; r++) {
+        for (int i = 0; i < BLOCK_LINES; i++) fprintf(fp, "%s\n", block[i][column]);
+        if (external) fputs("/bin/true\n", fp);
+    }
+    fputs("exit\n", fp);
+    return fclose(fp) == 0;
+}
+
+/* One run with stdout on /dev/null; input is fed to stdin if set */
+long run_once(char **argv, const char *input) {
+    posix_spawn_file_actions_t fa;
+    pid_t pid;
+    int status = 0;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 0, input ? input : "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+    long t0 = now_ns();
+    int rc = posix_spawn(&pid, argv[0], &fa, NULL, argv, environ);
+    if (rc == 0) waitpid(pid, &status, 0);
+    long t = now_ns() - t0;
+    posix_spawn_file_actions_destroy(&fa);
+    return rc == 0 && WIFEXITED(status) ? t : -1;
+}
+
+void bench(const char *desc, char **argv, const char *input, int samples, int lines) {
+    long v[samples];
+    for (int i = 0; i < samples; i++) {
+        if ((v[i] = run_once(argv, input)) < 0) {
+            fprintf(stderr, "%s: failed to run %s\n", desc, argv[0]);
+            return;
+        }
+    }
+    qsort(v, samples, sizeof(long), cmp_long);
+    printf("%-22s %10.2f %10.2f %12.2f\n", desc, v[0] / 1e6, v[samples / 2] / 1e6,
+           (double)v[samples / 2] / lines / 1e3);
+}
+
+int main(int argc, char **argv) {
+    int samples = 10, repeats = 2000, external = 0, opt;
+    while ((opt = getopt(argc, argv, "n:r:x")) != -1) {
+        switch (opt) {
+            case 'n': samples = atoi(optarg); break;
+            case 'r': repeats = atoi(optarg); break;
+            case 'x': external = 1; break;
+            default: goto usage;
+        }
+    }
+    if (optind >= argc || samples < 1 || repeats < 1) {
+usage:
+        fprintf(stderr, "Usage: %s [-n SAMPLES] [-r REPEATS] [-x] <oshell>\n"
+                "Example: %s -r 5000 ./oshell\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    char *oshell = argv[optind];
+    char osh[] = "/tmp/oshell_script_XXXXXX", sh[] = "/tmp/oshell_script_bash_XXXXXX";
+    if (!write_script(osh, 0, repeats, external) || !write_script(sh, 1, repeats, external)) {
+        perror("script");
+        return EXIT_FAILURE;
+    }
+    int lines = repeats * (BLOCK_LINES + external) + 1;
+
+    printf("%d lines (%d distinct)\n\n", lines, BLOCK_LINES + external + 1);
+    printf("%-22s %10s %10s %12s\n", "", "min ms", "median ms", "us/line");
+    char *script_argv[] = { oshell, osh, NULL };
+    char *stdin_argv[] = { oshell, NULL };
+    char *bash_argv[] = { "/bin/bash", sh, NULL };
+    bench("oshell FILE", script_argv, NULL, samples, lines);
+    bench("oshell < FILE", stdin_argv, osh, samples, lines);
+    bench("bash FILE", bash_argv, NULL, samples, lines);
+
+    unlink(osh);
+    unlink(sh);
+    return 0;
+}
@@ -0,0 +1,141 @@
+/* Requests/s and latency percentiles of the evaluation daemon against
+ * starting a process per evaluation:
+ *   fork-per-eval      posix_spawn `oshell -e EXPR` for every request
+ *   client-per-eval    posix_spawn `oshell -e EXPR --connect SOCK`
+ *   connection         one connection, one request in flight
+ *   pipelined xC/D     C connections on C threads, D requests in flight each
+ * Build: gcc -O2 serve_benchmark.c -o serve_benchmark -pthread -lm
+ * Usage: serve_benchmark <oshell> [requests] [expr]
+ */
+#define OSHELL_NO_MAIN
+#include "project.c"
+#include <math.h>
+
+#define REQUESTS 2000
+#define SOCK_PATH "/tmp/oshell_serve_bench.sock"
+
+extern char **environ;
+
+static long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* v holds per-request latencies; total is the wall time for all of them */
+void report(const char *desc, long *v, int n, long total) {
+    qsort(v, n, sizeof(long), cmp_long);
+    printf("%-20s %12.0f %10.2f %10.2f %10.2f\n", desc, n / (total / 1e9),
+           v[n / 2] / 1e3, v[(int)ceil(0.99 * n) - 1] / 1e3, v[n - 1] / 1e3);
+    fflush(stdout);
+}
+
+static pid_t spawn_quiet(char **argv) {
+    posix_spawn_file_actions_t fa;
+    pid_t pid;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+    int rc = posix_spawn(&pid, argv[0], &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    return rc == 0 ? pid : -1;
+}
+
+void bench_spawn(const char *desc, char **argv, long *v, int n) {
+    long start = now_ns();
+    for (int i = 0; i < n; i++) {
+        long t0 = now_ns();
+        pid_t pid = spawn_quiet(argv);
+        if (pid > 0) waitpid(pid, NULL, 0);
+        v[i] = now_ns() - t0;
+    }
+    report(desc, v, n, now_ns() - start);
+}
+
+typedef struct {
+    const char *expr;
+    int depth, batches;
+    long *v;                     /* one latency per request */
+    int ok;
+} client_job;
+
+/* Sends depth requests back to back, then reads the depth replies; every
+ * request in the batch is charged the batch's round trip */
+static void *client_thread(void *arg) {
+    client_job *j = arg;
+    char reply[64];
+    int fd = serve_connect(SOCK_PATH);
+    j->ok = fd >= 0;
+    for (int b = 0; j->ok && b < j->batches; b++) {
+        long t0 = now_ns();
+        for (int i = 0; j->ok && i < j->depth; i++) j->ok = serve_send(fd, j->expr);
+        for (int i = 0; j->ok && i < j->depth; i++) j->ok = serve_recv(fd, reply, sizeof(reply)) > 0;
+        long t = now_ns() - t0;
+        for (int i = 0; i < j->depth; i++) j->v[b * j->depth + i] = t;
+    }
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+void bench_clients(const char *expr, int nclients, int depth, long *v, int n) {
+    pthread_t tids[64];
+    client_job jobs[64];
+    char desc[64];
+    int batches = n / nclients / depth, ok = 1;
+    if (batches < 1) batches = 1;
+    long start = now_ns();
+    for (int c = 0; c < nclients; c++) {
+        jobs[c] = (client_job){ expr, depth, batches, v + (long)c * batches * depth, 0 };
+        pthread_create(&tids[c], NULL, client_thread, &jobs[c]);
+    }
+    for (int c = 0; c < nclients; c++) {
+        pthread_join(tids[c], NULL);
+        ok &= jobs[c].ok;
+    }
+    long total = now_ns() - start;
+    if (depth == 1 && nclients == 1) snprintf(desc, sizeof(desc), "connection");
+    else snprintf(desc, sizeof(desc), "pipelined x%d/%d", nclients, depth);
+    if (!ok) { fprintf(stderr, "%s: daemon request failed\n", desc); return; }
+    report(desc, v, nclients * batches * depth, total);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <oshell> [requests] [expr]\nExample: %s ./oshell 2000 '2^20'\n",
+                argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    char *oshell = argv[1];
+    int n = argc > 2 ? atoi(argv[2]) : REQUESTS;
+    char *expr = argc > 3 ? argv[3] : "1+1";
+    long *v = malloc(((size_t)n + 64 * 64) * sizeof(long));
+    if (n < 1 || !v) return EXIT_FAILURE;
+
+    char *serve_argv[] = { oshell, "--serve", SOCK_PATH, NULL };
+    pid_t daemon = spawn_quiet(serve_argv);
+    int fd = -1;
+    for (int i = 0; daemon > 0 && i < 200 && (fd = serve_connect(SOCK_PATH)) < 0; i++) usleep(10000);
+    if (fd < 0) { fprintf(stderr, "daemon did not come up on %s\n", SOCK_PATH); return EXIT_FAILURE; }
+    close(fd);
+
+    printf("%d requests of '%s'\n\n", n, expr);
+    printf("%-20s %12s %10s %10s %10s\n", "", "req/s", "p50 us", "p99 us", "max us");
+    char *fork_argv[] = { oshell, "-e", expr, NULL };
+    char *client_argv[] = { oshell, "-e", expr, "--connect", SOCK_PATH, NULL };
+    bench_spawn("fork-per-eval", fork_argv, v, n);
+    bench_spawn("client-per-eval", client_argv, v, n);
+    bench_clients(expr, 1, 1, v, n);
+    bench_clients(expr, 1, 16, v, n);
+    bench_clients(expr, 4, 16, v, n);
+    bench_clients(expr, 16, 64, v, n);
+
+    kill(daemon, SIGTERM);
+    waitpid(daemon, NULL, 0);
+    unlink(SOCK_PATH);
+    free(v);
+    return 0;
+}
@@ -0,0 +1,161 @@
+/* Startup cost of one-shot invocations: `oshell -e EXPR` for each build
+ * variant given (e.g. dynamic, -static and -static-pie), from spawn to
+ * reaped exit, with /bin/true as the floor.
+ *   exec-to-exit  min/median/p99 wall time of posix_spawn + waitpid
+ *   faults        minor and major page faults of the child (wait4 rusage)
+ *   mapped        pages mapped and pages resident when the process exits,
+ *                 read from /proc while it is held at its exit by ptrace
+ * Build: gcc -O2 startup_benchmark.c -o startup_benchmark
+ * Usage: startup_benchmark [-n SAMPLES] [-e EXPR] <oshell>...
+ * Example: startup_benchmark ./oshell ./oshell-static ./oshell-static-pie
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define SAMPLES 500
+#define WARMUP 20
+
+extern char **environ;
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* One run with stdout on /dev/null; returns the wall time in ns and the
+ * child's page faults, or -1 if it could not be run */
+long run_once(char **argv, int devnull, long *minflt, long *majflt) {
+    posix_spawn_file_actions_t fa;
+    struct timespec t1, t2;
+    struct rusage ru;
+    pid_t pid;
+    int status = 0;
+
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, devnull, 1);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    int rc = posix_spawn(&pid, argv[0], &fa, NULL, argv, environ);
+    if (rc == 0) wait4(pid, &status, 0, &ru);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    posix_spawn_file_actions_destroy(&fa);
+    if (rc != 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    *minflt = ru.ru_minflt;
+    *majflt = ru.ru_majflt;
+    return diff_nsec(t1, t2);
+}
+
+/* Pages in the VMAs of /proc/PID/maps and the Rss of smaps_rollup */
+static void count_pages(pid_t pid, long *mapped, long *resident) {
+    char path[64], line[512];
+    long page = sysconf(_SC_PAGESIZE);
+    FILE *fp;
+    *mapped = *resident = -1;
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    if ((fp = fopen(path, "r"))) {
+        unsigned long lo, hi;
+        for (*mapped = 0; fgets(line, sizeof(line), fp);)
+            if (sscanf(line, "%lx-%lx", &lo, &hi) == 2) *mapped += (hi - lo) / page;
+        fclose(fp);
+    }
+    snprintf(path, sizeof(path), "/proc/%d/smaps_rollup", (int)pid);
+    if ((fp = fopen(path, "r"))) {
+        long kb;
+        while (fgets(line, sizeof(line), fp))
+            if (sscanf(line, "Rss: %ld kB", &kb) == 1) *resident = kb * 1024 / page;
+        fclose(fp);
+    }
+}
+
+/* Runs argv under ptrace and stops it at its exit, where its mappings are
+ * still intact, to count them. -1 for both if ptrace is not allowed. */
+void exit_pages(char **argv, int devnull, long *mapped, long *resident) {
+    int status;
+    *mapped = *resident = -1;
+    pid_t pid = fork();
+    if (pid < 0) return;
+    if (pid == 0) {
+        dup2(devnull, 1);
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) < 0) _exit(126);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    /* the first stop is the SIGTRAP of the exec */
+    if (waitpid(pid, &status, 0) == pid && WIFSTOPPED(status) &&
+        ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)(long)(PTRACE_O_TRACEEXIT | PTRACE_O_EXITKILL)) == 0) {
+        ptrace(PTRACE_CONT, pid, NULL, NULL);
+        while (waitpid(pid, &status, 0) == pid && WIFSTOPPED(status)) {
+            if (status >> 8 == (SIGTRAP | PTRACE_EVENT_EXIT << 8)) count_pages(pid, mapped, resident);
+            ptrace(PTRACE_CONT, pid, NULL, (void *)(long)(status >> 8 == SIGTRAP ? 0 : WSTOPSIG(status)));
+        }
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+}
+
+void bench(char **argv, int samples, int devnull, long *v) {
+    double minflt = 0, majflt = 0;
+    long mn, mj, mapped, resident;
+    int n = 0;
+    for (int i = 0; i < WARMUP; i++) run_once(argv, devnull, &mn, &mj);
+    for (int i = 0; i < samples; i++) {
+        long ns = run_once(argv, devnull, &mn, &mj);
+        if (ns < 0) continue;
+        v[n++] = ns;
+        minflt += mn;
+        majflt += mj;
+    }
+    if (n == 0) { printf("%-28s failed to run\n", argv[0]); return; }
+    qsort(v, n, sizeof(long), cmp_long);
+    exit_pages(argv, devnull, &mapped, &resident);
+    printf("%-28s %9.1f %9.1f %9.1f %8.1f %6.1f %8ld %8ld\n", argv[0], v[0] / 1e3, v[n / 2] / 1e3,
+           v[(long)n * 99 / 100 < n ? (long)n * 99 / 100 : n - 1] / 1e3, minflt / n, majflt / n, mapped, resident);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    int samples = SAMPLES, opt;
+    char *expr = "1+1";
+    while ((opt = getopt(argc, argv, "n:e:")) != -1) {
+        switch (opt) {
+            case 'n': samples = atoi(optarg); break;
+            case 'e': expr = optarg; break;
+            default: goto usage;
+        }
+    }
+    if (optind >= argc || samples < 1) {
+usage:
+        fprintf(stderr, "Usage: %s [-n SAMPLES] [-e EXPR] <oshell>...\n"
+                "Example: %s ./oshell ./oshell-static ./oshell-static-pie\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    int devnull = open("/dev/null", O_RDWR | O_CLOEXEC);
+    long *v = malloc(samples * sizeof(long));
+    if (devnull < 0 || !v) { perror("startup_benchmark"); return EXIT_FAILURE; }
+
+    printf("%d samples of `-e %s`; times in us, faults per run, pages at exit\n\n", samples, expr);
+    printf("%-28s %9s %9s %9s %8s %6s %8s %8s\n", "", "min", "median", "p99", "minflt", "majflt",
+           "mapped", "resident");
+    char *floor_argv[] = { "/bin/true", NULL };
+    bench(floor_argv, samples, devnull, v);
+    for (int i = optind; i < argc; i++) {
+        char *osh_argv[] = { argv[i], "-e", expr, NULL };
+        bench(osh_argv, samples, devnull, v);
+    }
+    free(v);
+    close(devnull);
+    return 0;
+}
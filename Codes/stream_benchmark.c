@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LINES 1000000
+#define STREAM_CMD_FMT      "%s -s -j %d %s > /dev/null"
+#define INTERACTIVE_CMD_FMT "%s < %s > /dev/null"
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+/* Writes `lines` random multi-operator expressions, one per line */
+int make_input(const char *path, long lines) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return 0;
+    srand(42);
+    for (long i = 0; i < lines; i++)
+        fprintf(fp, "%d*(%d+%d)^2-%d/%d\n", rand() % 99 + 1, rand() % 99 + 1,
+                rand() % 99 + 1, rand() % 99 + 1, rand() % 99 + 1);
+    return fclose(fp) == 0;
+}
+
+void run_test(const char *desc, const char *cmd, long lines) {
+    struct timespec t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    int ret = system(cmd);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    double s = diff_nsec(t1, t2) / 1e9;
+    printf("%-24s: %8.3f s  %12.0f lines/s%s\n", desc, s, lines / s, ret ? "  (non-zero exit)" : "");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <oshell> [lines] [max_threads]\n"
+                "Example: %s ./oshell 1000000 8\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *oshell = argv[1];
+    long lines = argc > 2 ? atol(argv[2]) : LINES;
+    int max_threads = argc > 3 ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    char path[] = "/tmp/oshell_stream_XXXXXX";
+    char cmd[512], desc[64];
+
+    int fd = mkstemp(path);
+    if (fd < 0 || !make_input(path, lines)) {
+        perror("input file");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    printf("Streaming %ld expressions (%d cores online)\n\n", lines, (int)sysconf(_SC_NPROCESSORS_ONLN));
+
+    snprintf(cmd, sizeof(cmd), INTERACTIVE_CMD_FMT, oshell, path);
+    run_test("interactive stdin", cmd, lines);
+    for (int t = 1; t <= max_threads; t *= 2) {
+        snprintf(cmd, sizeof(cmd), STREAM_CMD_FMT, oshell, t, path);
+        snprintf(desc, sizeof(desc), "stream, %d thread(s)", t);
+        run_test(desc, cmd, lines);
+    }
+    unlink(path);
+    return 0;
+}
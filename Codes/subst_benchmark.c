@@ -0,0 +1,84 @@
+/* Cost of one command substitution and one here-document in OShell
+ * against bash, which forks a subshell for every $(...) and writes
+ * here-documents to a temporary file or pipe. Each target runs a loop of
+ * N iterations in a single process; the loop without the substitution is
+ * timed too and subtracted, so the figures are per substitution.
+ *   builtin    $(echo x)           oshell captures in-process
+ *   math       $(2^10)             oshell evaluates, bash needs $((2**10))
+ *   external   $(/bin/true)        both spawn; oshell without the subshell
+ *   heredoc    cat <<EOF ... EOF   memfd and builtin cat against bash's
+ *                                  here-document and /bin/cat
+ * Build: gcc -O2 subst_benchmark.c -o subst_benchmark -pthread
+ * Usage: subst_benchmark <oshell> [iterations]
+ */
+#define OSHELL_NO_MAIN
+#include "project.c"
+
+#define ITERATIONS 2000
+
+extern char **environ;
+
+static long diff_nsec(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+}
+
+/* Wall time of argv with stdout on /dev/null, best of three, or -1 */
+long run_best(char **argv) {
+    long best = -1;
+    for (int rep = 0; rep < 3; rep++) {
+        posix_spawn_file_actions_t fa;
+        struct timespec t1, t2;
+        pid_t pid;
+        int status = 0;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        int rc = posix_spawnp(&pid, argv[0], &fa, NULL, argv, environ);
+        if (rc == 0) waitpid(pid, &status, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        posix_spawn_file_actions_destroy(&fa);
+        if (rc != 0 || !WIFEXITED(status) || WEXITSTATUS(status) == 127) return -1;
+        long ns = diff_nsec(t1, t2);
+        if (best < 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+/* ns per iteration of body over the empty loop; shell is "oshell" or "bash" */
+double per_iteration(const char *shell, const char *body, int n) {
+    char loop[512], empty[512];
+    if (strcmp(shell, "bash") == 0) {
+        snprintf(loop, sizeof(loop), "for ((i=0;i<%d;i++)); do %s\ndone", n, body);
+        snprintf(empty, sizeof(empty), "for ((i=0;i<%d;i++)); do echo x\ndone", n);
+    } else {
+        snprintf(loop, sizeof(loop), "for i in 1..%d; do %s\ndone", n, body);
+        snprintf(empty, sizeof(empty), "for i in 1..%d; do echo x\ndone", n);
+    }
+    char *argv[] = { (char *)shell, "-c", loop, NULL }, *base[] = { (char *)shell, "-c", empty, NULL };
+    long t = run_best(argv), t0 = run_best(base);
+    return t < 0 || t0 < 0 ? -1 : (double)(t - t0) / n;
+}
+
+void report(const char *desc, double osh, double bash) {
+    if (osh < 0 || bash < 0) { printf("%-10s %12s\n", desc, "failed"); return; }
+    printf("%-10s %12.2f %12.2f %9.1fx\n", desc, osh / 1e3, bash / 1e3, osh > 0 ? bash / osh : 0);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <oshell> [iterations]\nExample: %s ./oshell 2000\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *oshell = argv[1];
+    int n = argc > 2 ? atoi(argv[2]) : ITERATIONS;
+    if (n < 1) n = ITERATIONS;
+
+    printf("%d iterations, time per substitution over the bare loop\n\n", n);
+    printf("%-10s %12s %12s %10s\n", "", "oshell us", "bash us", "speedup");
+    report("builtin", per_iteration(oshell, "echo $(echo x)", n), per_iteration("bash", "echo $(echo x)", n));
+    report("math", per_iteration(oshell, "echo $(2^10)", n), per_iteration("bash", "echo $((2**10))", n));
+    report("external", per_iteration(oshell, "echo $(/bin/true)", n), per_iteration("bash", "echo $(/bin/true)", n));
+    report("heredoc", per_iteration(oshell, "cat <<EOF\nx\nEOF", n), per_iteration("bash", "cat <<EOF\nx\nEOF", n));
+    return 0;
+}
@@ -0,0 +1,95 @@
+/* Cost of a trace event: trace_now() alone, trace_record() alone, and the
+ * events of one external command as exec_pipeline() records them (parse,
+ * spawn, exec, stage, pipeline: 5 events from 7 clock reads), single
+ * threaded, with several threads recording into the ring at once, and with
+ * recording off. The budget is 50 ns per event.
+ * Build: gcc -O2 trace_benchmark.c -o trace_benchmark -pthread
+ * Usage: trace_benchmark [events] [threads]
+ */
+#define OSHELL_NO_MAIN
+#include "project.c"
+
+#define EVENTS 10000000
+#define BUDGET_NS 50.0
+
+static long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static const char *const names[4] = { "ls", "/usr/bin/grep", "sort", "a-rather-long-command-name" };
+
+enum { MODE_CLOCK, MODE_RECORD, MODE_COMMAND };
+
+typedef struct { long events; int mode; } worker_job;
+
+static void *worker(void *arg) {
+    worker_job *w = arg;
+    volatile uint64_t sink = 0;
+    if (w->mode == MODE_CLOCK) {
+        for (long i = 0; i < w->events; i++) sink += trace_now();
+    } else if (w->mode == MODE_RECORD) {
+        for (long i = 0; i < w->events; i++)
+            trace_record(TRACE_STAGE, names[i & 3], (uint64_t)i, (uint64_t)i + 100, (uint64_t)i);
+    } else {
+        for (long i = 0; i < w->events; i += 5) {
+            const char *name = names[(i / 5) & 3];
+            uint64_t p0 = trace_now();
+            trace_record(TRACE_PARSE, name, p0, trace_now(), TRACE_NO_CPU);
+            uint64_t t0 = trace_now(), s0 = trace_now(), s1 = trace_now();
+            trace_record(TRACE_SPAWN, name, s0, s1, TRACE_NO_CPU);
+            trace_record(TRACE_EXEC, name, t0, s1, TRACE_NO_CPU);
+            trace_record(TRACE_STAGE, name, s0, trace_now(), 1000);
+            trace_record(TRACE_PIPELINE, name, t0, trace_now(), 1000);
+        }
+    }
+    (void)sink;
+    return NULL;
+}
+
+/* Returns ns per event over all threads' events */
+double run(long events, int threads, int mode) {
+    pthread_t tids[64];
+    worker_job w = { events / threads, mode };
+    long t0 = now_ns();
+    for (int t = 0; t < threads; t++) pthread_create(&tids[t], NULL, worker, &w);
+    for (int t = 0; t < threads; t++) pthread_join(tids[t], NULL);
+    return (double)(now_ns() - t0) / (w.events * threads);
+}
+
+void report(const char *desc, double ns) {
+    printf("%-36s %8.1f ns/event  %s\n", desc, ns, ns <= BUDGET_NS ? "ok" : "over budget");
+}
+
+int main(int argc, char **argv) {
+    long events = argc > 1 ? atol(argv[1]) : EVENTS;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    char desc[64];
+    if (events < 1) events = EVENTS;
+    if (threads < 1 || threads > 64) threads = 4;
+
+    trace_init();
+    printf("%ld events into a %d-slot ring, budget %.0f ns/event\n\n", events, TRACE_RING, BUDGET_NS);
+    run(events / 10, 1, MODE_RECORD);       /* fault the ring in */
+    printf("%-36s %8.1f ns/read\n", "trace_now", run(events, 1, MODE_CLOCK));
+    report("trace_record", run(events, 1, MODE_RECORD));
+    report("external command events", run(events, 1, MODE_COMMAND));
+    snprintf(desc, sizeof(desc), "same, %d threads", threads);
+    report(desc, run(events, threads, MODE_COMMAND));
+    trace_enabled = 0;
+    report("same, recording off", run(events, 1, MODE_COMMAND));
+    trace_enabled = 1;
+
+    /* A slot is lost only when its writer is preempted for a whole lap of
+     * the ring; every other slot must read back */
+    uint64_t lo, head = trace_window(&lo);
+    long lost = 0;
+    for (uint64_t i = lo; i < head; i++) {
+        trace_event e;
+        if (!trace_read(i, &e)) lost++;
+    }
+    printf("\n%ld of %llu ring slots lost to writers overtaken by a lap\n",
+           lost, (unsigned long long)(head - lo));
+    return 0;
+}